@@ -0,0 +1,399 @@
+#define _DEFAULT_SOURCE
+#include "archive.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <float.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define ARCHIVE_MAGIC "GAARCHIV"
+#define ARCHIVE_VERSION (1)
+#define ARCHIVE_MIN_CAPACITY (1024)
+
+/* First bytes of the file, identifying it and the layout of its records.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t reserved[3];
+} ArchiveHeader;
+
+/* Record of the file, with a checksum of the other fields to skip a record
+ * torn by a crash.
+ */
+typedef struct {
+    Genotype genotype;
+    double fitness;
+    uint64_t dataset;
+    uint32_t settings;
+    uint32_t checksum;
+} ArchiveRecord;
+
+/* Slot of the open addressing table indexing the records.
+ */
+typedef struct {
+    ArchiveRecord record;
+    int used;
+} ArchiveSlot;
+
+/* Valid archived genotype ranked by its fitness when seeding.
+ */
+typedef struct {
+    double fitness;
+    unsigned long slot;
+} ArchiveRank;
+
+struct Archive {
+    int fd;
+    const char *path;
+    /* Table of every record, whatever its key, its capacity a power of two.
+     */
+    ArchiveSlot *slots;
+    unsigned long capacity;
+    unsigned long length;
+    /* Records inserted but not yet appended to the file.
+     */
+    ArchiveRecord *pending;
+    unsigned long n_pending;
+    unsigned long pending_capacity;
+    /* Bytes of the file read into the table or appended from it.
+     */
+    off_t size;
+    unsigned long loaded;
+    unsigned long appended;
+    atomic_ulong lookups;
+    atomic_ulong reused;
+    pthread_rwlock_t lock;
+};
+
+/* FNV-1a hash of `size` bytes, continuing from `hash`.
+ */
+static uint64_t fnv1a(const void *const data, const size_t size, uint64_t hash) {
+    const unsigned char *const bytes = (const unsigned char *) data;
+
+    for(size_t iter = 0; iter < size; iter++) {
+        hash = (hash ^ bytes[iter]) * 0x100000001B3UL;
+    }
+    return hash;
+}
+
+static uint32_t record_checksum(const ArchiveRecord *const record) {
+    const uint64_t hash = fnv1a(record, offsetof(ArchiveRecord, checksum), 0xCBF29CE484222325UL);
+
+    return (uint32_t) (hash ^ (hash >> 32));
+}
+
+/* Slot of the table for `record`, either holding the same genotype and key or
+ * empty.
+ */
+static ArchiveSlot *find_slot(const ArchiveSlot *const slots, const unsigned long capacity, const ArchiveRecord *const record) {
+    uint64_t hash = record->genotype.word[0] ^ (record->genotype.word[1] * 0x9E3779B97F4A7C15UL) ^ record->dataset ^ record->settings;
+    hash = (hash ^ (hash >> 31)) * 0xBF58476D1CE4E5B9UL;
+    hash ^= hash >> 29;
+
+    for(unsigned long index = hash & (capacity - 1);; index = (index + 1) & (capacity - 1)) {
+        const ArchiveSlot *const slot = slots + index;
+        if(!slot->used || (memcmp(&(slot->record.genotype), &(record->genotype), sizeof(Genotype)) == 0
+                    && slot->record.dataset == record->dataset && slot->record.settings == record->settings)) {
+            return (ArchiveSlot *) slot;
+        }
+    }
+}
+
+/* Add `record` to the table, growing it to keep it at most half full, and
+ * return whether it was new.
+ */
+static int table_insert(Archive *const archive, const ArchiveRecord *const record) {
+    if(2 * (archive->length + 1) > archive->capacity) {
+        const unsigned long capacity = 2 * archive->capacity;
+        ArchiveSlot *const slots = (ArchiveSlot *) calloc(capacity, sizeof(ArchiveSlot));
+
+        for(unsigned long iter = 0; iter < archive->capacity; iter++) {
+            if(archive->slots[iter].used) {
+                *find_slot(slots, capacity, &(archive->slots[iter].record)) = archive->slots[iter];
+            }
+        }
+        free(archive->slots);
+        archive->slots = slots;
+        archive->capacity = capacity;
+    }
+
+    ArchiveSlot *const slot = find_slot(archive->slots, archive->capacity, record);
+    const int inserted = !slot->used;
+    archive->length += inserted;
+    slot->record = *record;
+    slot->used = 1;
+
+    return inserted;
+}
+
+/* Insert into the table the records appended to the file, `size` bytes
+ * long, since it was last read, with the file locked exclusively, cutting a
+ * record torn by a crash so that appends stay aligned.
+ */
+static int load_appended(Archive *const archive, const off_t size) {
+    const unsigned long n_records = (size - sizeof(ArchiveHeader)) / sizeof(ArchiveRecord);
+    const off_t end = sizeof(ArchiveHeader) + n_records * sizeof(ArchiveRecord);
+
+    if(end > archive->size) {
+        void *const map = mmap(NULL, end, PROT_READ, MAP_SHARED, archive->fd, 0);
+        if(map == MAP_FAILED) {
+            return -1;
+        }
+
+        const ArchiveRecord *const records = (const ArchiveRecord *) ((const char *) map + sizeof(ArchiveHeader));
+        for(unsigned long iter = (archive->size - sizeof(ArchiveHeader)) / sizeof(ArchiveRecord); iter < n_records; iter++) {
+            if(records[iter].checksum == record_checksum(records + iter)) {
+                archive->loaded += table_insert(archive, records + iter);
+            }
+        }
+        munmap(map, end);
+    }
+    archive->size = end;
+
+    return end == size ? 0 : ftruncate(archive->fd, end);
+}
+
+/* Load the records of the file, with the file locked exclusively, after
+ * checking its header, or write the header of an empty one.
+ */
+static int load_records(Archive *const archive) {
+    struct stat st;
+    if(fstat(archive->fd, &st) != 0) {
+        return -1;
+    }
+
+    ArchiveHeader header = { .version = ARCHIVE_VERSION, .record_size = sizeof(ArchiveRecord), .reserved = { 0 } };
+    archive->size = sizeof(header);
+    if(st.st_size == 0) {
+        memcpy(header.magic, ARCHIVE_MAGIC, sizeof(header.magic));
+        return write(archive->fd, &header, sizeof(header)) == (ssize_t) sizeof(header) ? 0 : -1;
+    }
+
+    if((size_t) st.st_size < sizeof(header) || pread(archive->fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header)
+            || memcmp(header.magic, ARCHIVE_MAGIC, sizeof(header.magic)) != 0 || header.version != ARCHIVE_VERSION
+            || header.record_size != sizeof(ArchiveRecord)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return load_appended(archive, st.st_size);
+}
+
+Archive *archive_open(const char *const path) {
+    const int fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if(fd < 0) {
+        perror(path);
+        return NULL;
+    }
+
+    Archive *const archive = (Archive *) malloc(sizeof(Archive));
+    *archive = (Archive) {
+        .fd = fd,
+        .path = path,
+        .slots = (ArchiveSlot *) calloc(ARCHIVE_MIN_CAPACITY, sizeof(ArchiveSlot)),
+        .capacity = ARCHIVE_MIN_CAPACITY,
+        .length = 0,
+        .pending = NULL,
+        .n_pending = 0,
+        .pending_capacity = 0,
+        .size = 0,
+        .loaded = 0,
+        .appended = 0,
+    };
+    atomic_init(&(archive->lookups), 0);
+    atomic_init(&(archive->reused), 0);
+    pthread_rwlock_init(&(archive->lock), NULL);
+
+    flock(fd, LOCK_EX);
+    const int err = load_records(archive);
+    flock(fd, LOCK_UN);
+
+    if(err != 0) {
+        perror(path);
+        archive_close(archive);
+        return NULL;
+    }
+
+    return archive;
+}
+
+void archive_close(Archive *const archive) {
+    archive_flush(archive);
+    close(archive->fd);
+    pthread_rwlock_destroy(&(archive->lock));
+    free(archive->slots);
+    free(archive->pending);
+    free(archive);
+}
+
+ArchiveKey archive_key(const Dataset *const data, const Encoding encoding, const IntegratorMethod method, const StepController controller, const int event_location) {
+    uint64_t hash = fnv1a(&(data->length), sizeof(data->length), 0xCBF29CE484222325UL);
+    hash = fnv1a(data->y, sizeof(double) * data->length, hash);
+    hash = fnv1a(data->w, sizeof(double) * data->length, hash);
+
+    /* Genotypes decode differently under another schema */
+    const uint64_t schema = genotype_schema_hash();
+    if(schema != 0) {
+        hash = fnv1a(&schema, sizeof(schema), hash);
+    }
+
+    /* Integrations locating events set a bit of their own, keeping the keys
+     * of the default ones */
+    return (ArchiveKey) {
+        .dataset = hash,
+        .settings = (uint32_t) encoding | ((uint32_t) method << 8) | ((uint32_t) FIDELITY_HIGH << 16) | ((uint32_t) (event_location != 0) << 20)
+            | ((uint32_t) controller << 24),
+    };
+}
+
+int archive_lookup(Archive *const archive, const ArchiveKey *const key, const Genotype *const g, double *const fitness) {
+    const ArchiveRecord record = { .genotype = *g, .dataset = key->dataset, .settings = key->settings };
+
+    pthread_rwlock_rdlock(&(archive->lock));
+    const ArchiveSlot *const slot = find_slot(archive->slots, archive->capacity, &record);
+    const int found = slot->used;
+    if(found) {
+        *fitness = slot->record.fitness;
+    }
+    pthread_rwlock_unlock(&(archive->lock));
+
+    atomic_fetch_add_explicit(&(archive->lookups), 1, memory_order_relaxed);
+    if(found) {
+        atomic_fetch_add_explicit(&(archive->reused), 1, memory_order_relaxed);
+    }
+    return found;
+}
+
+void archive_counts(Archive *const archive, unsigned long *const lookups, unsigned long *const reused) {
+    *lookups = atomic_load_explicit(&(archive->lookups), memory_order_relaxed);
+    *reused = atomic_load_explicit(&(archive->reused), memory_order_relaxed);
+}
+
+void archive_insert(Archive *const archive, const ArchiveKey *const key, const Genotype *const g, const double fitness) {
+    ArchiveRecord record = {
+        .genotype = *g,
+        .fitness = fitness,
+        .dataset = key->dataset,
+        .settings = key->settings,
+    };
+    record.checksum = record_checksum(&record);
+
+    pthread_rwlock_wrlock(&(archive->lock));
+    if(table_insert(archive, &record)) {
+        if(archive->n_pending == archive->pending_capacity) {
+            archive->pending_capacity = archive->pending_capacity > 0 ? 2 * archive->pending_capacity : ARCHIVE_MIN_CAPACITY;
+            archive->pending = (ArchiveRecord *) realloc(archive->pending, sizeof(ArchiveRecord) * archive->pending_capacity);
+        }
+        archive->pending[archive->n_pending++] = record;
+    }
+    pthread_rwlock_unlock(&(archive->lock));
+}
+
+int archive_flush(Archive *const archive) {
+    int err = 0;
+    struct stat st;
+
+    /* Read what other processes appended and append in full under the lock,
+     * so that their records never interleave with a partial write, and cut a
+     * failed write back to its last whole record */
+    pthread_rwlock_wrlock(&(archive->lock));
+    flock(archive->fd, LOCK_EX);
+    if(fstat(archive->fd, &st) != 0 || load_appended(archive, st.st_size) != 0) {
+        perror(archive->path);
+        err = -1;
+    } else if(archive->n_pending > 0) {
+        const char *data = (const char *) archive->pending;
+        size_t left = sizeof(ArchiveRecord) * archive->n_pending;
+
+        while(left > 0) {
+            const ssize_t written = write(archive->fd, data, left);
+            if(written < 0) {
+                if(errno == EINTR) {
+                    continue;
+                }
+                perror(archive->path);
+                err = -1;
+                break;
+            }
+            data += written;
+            left -= written;
+        }
+
+        const unsigned long n_written = (sizeof(ArchiveRecord) * archive->n_pending - left) / sizeof(ArchiveRecord);
+        archive->size += n_written * sizeof(ArchiveRecord);
+        if(left > 0 && ftruncate(archive->fd, archive->size) != 0) {
+            perror(archive->path);
+        }
+        archive->appended += n_written;
+        archive->n_pending = 0;
+    }
+    flock(archive->fd, LOCK_UN);
+    pthread_rwlock_unlock(&(archive->lock));
+
+    return err;
+}
+
+static int compare_ranks(const void *a, const void *b) {
+    const double x = ((const ArchiveRank *) a)->fitness;
+    const double y = ((const ArchiveRank *) b)->fitness;
+
+    return (x > y) - (x < y);
+}
+
+static unsigned hamming_distance(const Genotype *const a, const Genotype *const b) {
+    unsigned distance = 0;
+    for(unsigned word = 0; word < GENOTYPE_WORDS; word++) {
+        distance += __builtin_popcountll(a->word[word] ^ b->word[word]);
+    }
+    return distance;
+}
+
+unsigned archive_best(Archive *const archive, const ArchiveKey *const key, Genotype *const genotypes, double *const fitness, const unsigned n) {
+    pthread_rwlock_rdlock(&(archive->lock));
+
+    unsigned long n_ranked = 0;
+    ArchiveRank *const ranking = (ArchiveRank *) malloc(sizeof(ArchiveRank) * (archive->length + 1));
+    for(unsigned long iter = 0; iter < archive->capacity; iter++) {
+        const ArchiveRecord *const record = &(archive->slots[iter].record);
+        if(archive->slots[iter].used && record->dataset == key->dataset && record->settings == key->settings && record->fitness != DBL_MAX) {
+            ranking[n_ranked++] = (ArchiveRank) { .fitness = record->fitness, .slot = iter };
+        }
+    }
+    qsort(ranking, n_ranked, sizeof(ArchiveRank), compare_ranks);
+
+    /* Greedily keep the best genotypes far enough from those already kept */
+    unsigned found = 0;
+    for(unsigned long iter = 0; iter < n_ranked && found < n; iter++) {
+        const ArchiveRecord *const record = &(archive->slots[ranking[iter].slot].record);
+
+        unsigned kept = 0;
+        while(kept < found && hamming_distance(genotypes + kept, &(record->genotype)) >= ARCHIVE_SEED_DISTANCE) {
+            kept++;
+        }
+        if(kept == found) {
+            genotypes[found] = record->genotype;
+            fitness[found] = record->fitness;
+            found++;
+        }
+    }
+
+    pthread_rwlock_unlock(&(archive->lock));
+    free(ranking);
+    return found;
+}
+
+void archive_report(Archive *const archive, FILE *const output) {
+    pthread_rwlock_rdlock(&(archive->lock));
+    fprintf(output, "Archive: %lu records loaded, %lu fitness values reused, %lu records appended\n",
+            archive->loaded, atomic_load(&(archive->reused)), archive->appended + archive->n_pending);
+    pthread_rwlock_unlock(&(archive->lock));
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "equations.h"
+#include "genotype.h"
+#include "integrator.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/* Minimum Hamming distance between the genotypes `archive_best` returns, so
+ * that a warm start is not seeded with copies of a single converged run.
+ */
+#define ARCHIVE_SEED_DISTANCE (8)
+
+/* What an archived fitness value depends on besides the genotype: a hash of
+ * the observations and of the schema of the genotype unless the built-in
+ * one, and the encoding and integrator decoding and integrating the genotype.
+ */
+typedef struct {
+    uint64_t dataset;
+    uint32_t settings;
+} ArchiveKey;
+
+/* Persistent archive of evaluated genotypes.
+ *
+ * The file is a header followed by fixed size records, only ever appended to
+ * under an exclusive `flock`, so that several processes can share it. Its
+ * records are loaded into a table, looked up and extended in memory and safe
+ * to use from several threads, when the archive is opened and then at every
+ * flush, which reads the records appended by other processes since.
+ */
+typedef struct Archive Archive;
+
+/* Open or create the archive at `path`, returning `NULL` after printing the
+ * reason if it cannot be used.
+ */
+Archive *archive_open(const char *const path);
+
+/* Append the pending records and release the archive.
+ */
+void archive_close(Archive *const archive);
+
+/* Key of the fitness of genotypes decoded with `encoding` and integrated by
+ * `method` on `data` at full accuracy, with the steps of `controller` and
+ * locating the crossings of `x = delta` if `event_location`.
+ */
+ArchiveKey archive_key(const Dataset *const data, const Encoding encoding, const IntegratorMethod method, const StepController controller, const int event_location);
+
+/* Look the genotype `g` up, storing its archived fitness in `fitness` and
+ * returning `1` if found, `0` otherwise.
+ */
+int archive_lookup(Archive *const archive, const ArchiveKey *const key, const Genotype *const g, double *const fitness);
+
+/* Store the lookups made so far and how many of them found the fitness.
+ */
+void archive_counts(Archive *const archive, unsigned long *const lookups, unsigned long *const reused);
+
+/* Record the fitness of a genotype, unless already archived, to be appended
+ * to the file by the next `archive_flush`.
+ */
+void archive_insert(Archive *const archive, const ArchiveKey *const key, const Genotype *const g, const double fitness);
+
+/* Load the records other processes appended to the file since the last
+ * flush, and append those inserted since, returning `0` on success.
+ *
+ * A failed append is cut back to its last whole record.
+ */
+int archive_flush(Archive *const archive);
+
+/* Store in `genotypes` up to `n` of the best valid archived genotypes, at
+ * least `ARCHIVE_SEED_DISTANCE` bits apart from each other, and their fitness
+ * in `fitness`, returning how many were found.
+ */
+unsigned archive_best(Archive *const archive, const ArchiveKey *const key, Genotype *const genotypes, double *const fitness, const unsigned n);
+
+/* Print the records loaded, the fitness values reused and the records
+ * appended so far.
+ */
+void archive_report(Archive *const archive, FILE *const output);
@@ -0,0 +1,213 @@
+#define _POSIX_C_SOURCE 200809L
+#include "batch.h"
+#include "equations.h"
+#include "genetic-algorithm.h"
+#include "genotype.h"
+#include "multiplexer.h"
+#include "scheduler.h"
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Minimum number of evaluations per thread in the batch of a generation, so
+ * that the dynamic schedule can balance runs of different speed.
+ */
+#define BATCH_TASKS_PER_THREAD (64)
+
+/* Maximum length of the name of a series.
+ */
+#define SERIES_NAME_LENGTH (64)
+
+typedef struct {
+    char name[SERIES_NAME_LENGTH];
+    Dataset dataset;
+} Series;
+
+/* Run of a series in the active window.
+ */
+typedef struct {
+    GeneticAlgorithm ga;
+    GeneticAlgorithmConfig config;
+    unsigned series;
+    double start;
+} BatchRun;
+
+/* Parse the line `line` of a series file into `series`, returning an error
+ * message or `NULL` on success.
+ */
+static const char *parse_series(char *const line, Series *const series) {
+    char *save;
+    const char *const name = strtok_r(line, " \t\r\n", &save);
+    char *const y = strtok_r(NULL, " \t\r\n", &save);
+    char *const w = strtok_r(NULL, " \t\r\n", &save);
+
+    if(y == NULL) {
+        return "expected a name and observations";
+    }
+    if(strtok_r(NULL, " \t\r\n", &save) != NULL) {
+        return "unexpected field after the weights";
+    }
+    snprintf(series->name, SERIES_NAME_LENGTH, "%s", name);
+
+    series->dataset.length = dataset_parse_list(y, series->dataset.y);
+    if(series->dataset.length < 2 || series->dataset.length > DATASET_MAX_LENGTH) {
+        return "needs between 2 and 64 observations";
+    }
+
+    const unsigned n_weights = w != NULL ? dataset_parse_list(w, series->dataset.w) : 0;
+    if(w != NULL && n_weights != series->dataset.length) {
+        return "weights and observations differ in length";
+    }
+    for(unsigned iter = n_weights; iter < series->dataset.length; iter++) {
+        series->dataset.w[iter] = 1.0;
+    }
+
+    return NULL;
+}
+
+/* Read the series file `path`, returning the array of its series and storing
+ * their number in `n_series`, or `NULL` on error.
+ */
+static Series *read_series(const char *const path, unsigned *const n_series) {
+    FILE *file = fopen(path, "r");
+    if(file == NULL) {
+        perror(path);
+        return NULL;
+    }
+
+    Series *series = NULL;
+    unsigned capacity = 0;
+    char *line = NULL;
+    size_t size = 0;
+    unsigned number = 0;
+
+    *n_series = 0;
+    while(getline(&line, &size, file) != -1) {
+        number++;
+        const size_t skip = strspn(line, " \t\r\n");
+        if(line[skip] == '\0' || line[skip] == '#') {
+            continue;
+        }
+
+        if(*n_series == capacity) {
+            capacity = capacity == 0 ? 64 : 2 * capacity;
+            series = (Series *) realloc(series, sizeof(Series) * capacity);
+        }
+
+        const char *const error = parse_series(line, series + *n_series);
+        if(error != NULL) {
+            fprintf(stderr, "%s:%u: %s\n", path, number, error);
+            free(series);
+            series = NULL;
+            break;
+        }
+        (*n_series)++;
+    }
+
+    free(line);
+    fclose(file);
+    return series;
+}
+
+/* Write the record of the finished `run` to `output`.
+ */
+static void write_record(FILE *const output, const Series *const series, const BatchRun *const run) {
+    const GeneticAlgorithm *const ga = &(run->ga);
+    const Phenotype p = genoype_to_phenotype(ga->best.genotype, ga->config.encoding);
+
+    fprintf(output, "%s\t%lf\t%lf\t%lf\t%lf\t%lf\t%lf\t%u\t%lu\t%.3lf\n",
+            series->name, ga->best.fitness, p.phi, p.lambda, p.mu, p.sigma, p.delta,
+            ga->generation, genetic_algorithm_evaluations(ga),
+            omp_get_wtime() - run->start);
+    fflush(output);
+}
+
+int run_batch(const char *const path, FILE *const output, const GeneticAlgorithmConfig *const config, const long seed, const Scheduler *const scheduler) {
+    unsigned n_series;
+    Series *series = read_series(path, &n_series);
+    if(series == NULL) {
+        return 1;
+    }
+
+    /* A run per thread breeding in parallel, or more to fill the batch */
+    const unsigned min_tasks = BATCH_TASKS_PER_THREAD * scheduler->n_threads;
+    unsigned capacity = min_tasks / config->n_individuals + 1;
+    capacity = capacity > scheduler->n_threads ? capacity : scheduler->n_threads;
+    capacity = capacity < n_series ? capacity : n_series;
+
+    BatchRun *runs = (BatchRun *) malloc(sizeof(BatchRun) * capacity);
+    GeneticAlgorithm **gas = (GeneticAlgorithm **) malloc(sizeof(GeneticAlgorithm *) * capacity);
+    const GeneticAlgorithmConfig **configs = (const GeneticAlgorithmConfig **) malloc(sizeof(GeneticAlgorithmConfig *) * capacity);
+    long *seeds = (long *) malloc(sizeof(long) * capacity);
+
+    Multiplexer multiplexer;
+    multiplexer_init(&multiplexer);
+
+    fprintf(output, "series\tfitness\tphi\tlambda\tmu\tsigma\tdelta\tgenerations\tevaluations\tseconds\n");
+
+    const double start = omp_get_wtime();
+    unsigned n_active = 0;
+    unsigned next = 0;
+    int err = 0;
+    while(n_active > 0 || next < n_series) {
+        /* Admit series until every thread breeds one and the batch fills
+         * every thread */
+        const unsigned first = n_active;
+        while(next < n_series && n_active < capacity && (n_active < scheduler->n_threads || n_active * config->n_individuals < min_tasks)) {
+            BatchRun *const run = runs + n_active;
+
+            run->config = *config;
+            run->config.dataset = &(series[next].dataset);
+            run->series = next;
+            run->start = omp_get_wtime();
+            configs[n_active] = &(run->config);
+            seeds[n_active] = seed + 7919L * next;
+            n_active++;
+            next++;
+        }
+        for(unsigned iter = 0; iter < n_active; iter++) {
+            gas[iter] = &(runs[iter].ga);
+        }
+        if(multiplexer_init_runs(scheduler, gas + first, configs + first, seeds + first, n_active - first) != 0) {
+            fprintf(stderr, "Could not allocate the runs of the batch\n");
+            for(unsigned iter = 0; iter < first; iter++) {
+                genetic_algorithm_free(gas[iter]);
+            }
+            err = 1;
+            break;
+        }
+
+        multiplexer_step(&multiplexer, scheduler, gas, n_active);
+
+        /* Retire the finished series, keeping the window contiguous */
+        for(unsigned iter = 0; iter < n_active;) {
+            BatchRun *const run = runs + iter;
+            if(run->ga.generation < config->n_generations) {
+                iter++;
+                continue;
+            }
+
+            write_record(output, series + run->series, run);
+            genetic_algorithm_free(&(run->ga));
+
+            n_active--;
+            if(iter != n_active) {
+                *run = runs[n_active];
+            }
+        }
+    }
+
+    if(err == 0) {
+        const double elapsed = omp_get_wtime() - start;
+        fprintf(stderr, "%u series in %.3lf s, %.1lf series/hour\n", n_series, elapsed, elapsed > 0.0 ? 3600.0 * n_series / elapsed : 0.0);
+    }
+
+    multiplexer_free(&multiplexer);
+    free(seeds);
+    free(configs);
+    free(gas);
+    free(runs);
+    free(series);
+    return err;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "genetic-algorithm.h"
+#include "scheduler.h"
+#include <stdio.h>
+
+/* Fit the model to every series listed in the file `path`, writing one
+ * tab-separated record per series to `output` as soon as its run finishes.
+ *
+ * Every line of the file holds the name of a series, its comma separated
+ * observations and optionally their comma separated weights, all of them 1 by
+ * default. Empty lines and lines starting with `#` are ignored.
+ *
+ * The series run with `config` and seeds derived from `seed`, and are
+ * scheduled with two levels of parallelism: a window of them advances in
+ * lockstep on `scheduler`, breeding in parallel and evaluating their children
+ * as one batch, and it admits new series whenever finished ones leave it
+ * until the batch gives every thread enough tasks.
+ *
+ * Returns `0` on success, and `1` if the file cannot be read or the runs
+ * cannot be allocated.
+ */
+int run_batch(const char *const path, FILE *const output, const GeneticAlgorithmConfig *const config, const long seed, const Scheduler *const scheduler);
@@ -0,0 +1,215 @@
+#include "bootstrap.h"
+#include "equations.h"
+#include "genetic-algorithm.h"
+#include "genotype.h"
+#include "multiplexer.h"
+#include "randombits.h"
+#include "real-coded.h"
+#include "scheduler.h"
+#include "selection.h"
+#include <float.h>
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char *const parameter_names[N_PARAMETERS] = { "phi", "lambda", "mu", "sigma", "delta" };
+
+static int compare_doubles(const void *a, const void *b) {
+    const double x = *(const double *) a;
+    const double y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+/* Linearly interpolated `q`-quantile of the sorted array `values`.
+ */
+static double quantile(const double *const values, const unsigned length, const double q) {
+    const double position = q * (length - 1);
+    const unsigned below = (unsigned) position;
+    const unsigned above = below + 1 < length ? below + 1 : below;
+    const double fraction = position - below;
+
+    return values[below] + fraction * (values[above] - values[below]);
+}
+
+/* Fill `replicate` with a replicate of the dataset of `config`, fitted by `p`
+ * as integrated under `config`, drawn from `rng`.
+ */
+static void resample_dataset(const GeneticAlgorithmConfig *const config, const Phenotype *const p, const Resampling resampling, Random *const rng, Dataset *const replicate) {
+    const Dataset *const data = config->dataset;
+    const unsigned n = data->length - 1;
+    *replicate = *data;
+
+    if(resampling == RESAMPLING_CASES) {
+        /* The fitness is the largest weighted error, which repeating an
+         * observation leaves unchanged, so it only matters whether it was
+         * drawn */
+        unsigned char drawn[DATASET_MAX_LENGTH] = { 0 };
+        for(unsigned iter = 0; iter < n; iter++) {
+            drawn[1 + select_random_index(n, rng)] = 1;
+        }
+        for(unsigned iter = 1; iter <= n; iter++) {
+            replicate->w[iter] = drawn[iter] ? data->w[iter] : 0.0;
+        }
+        return;
+    }
+
+    double x[DATASET_MAX_LENGTH] = { data->y[0] };
+    model_prediction(x[0], x, data->length, p, config->integrator, config->controller, config->event_location, FIDELITY_HIGH, NULL);
+    for(unsigned iter = 1; iter <= n; iter++) {
+        const unsigned pick = 1 + select_random_index(n, rng);
+        replicate->y[iter] = x[iter] + (data->y[pick] - x[pick]);
+    }
+}
+
+/* Write the percentile intervals of the parameter estimates `estimates` of
+ * `n` replicates, and their correlations, to `output`.
+ */
+static void summarise_bootstrap(const double (*const estimates)[N_PARAMETERS], const unsigned n, const Phenotype *const fit, const double confidence, FILE *const output) {
+    double mean[N_PARAMETERS] = { 0.0 };
+    double deviation[N_PARAMETERS] = { 0.0 };
+    double *values = (double *) malloc(sizeof(double) * n);
+
+    fprintf(output, "\nparameter\testimate\tmean\tstd\tlower\tupper\n");
+    for(unsigned param = 0; param < N_PARAMETERS; param++) {
+        for(unsigned iter = 0; iter < n; iter++) {
+            values[iter] = estimates[iter][param];
+            mean[param] += values[iter] / n;
+        }
+        for(unsigned iter = 0; iter < n; iter++) {
+            deviation[param] += (values[iter] - mean[param]) * (values[iter] - mean[param]);
+        }
+        deviation[param] = n > 1 ? sqrt(deviation[param] / (n - 1)) : 0.0;
+
+        qsort(values, n, sizeof(double), compare_doubles);
+        fprintf(output, "%s\t%lf\t%lf\t%lf\t%lf\t%lf\n", parameter_names[param], phenotype_parameter_value(fit, param),
+                mean[param], deviation[param], quantile(values, n, 0.5 * (1.0 - confidence)), quantile(values, n, 0.5 * (1.0 + confidence)));
+    }
+    free(values);
+
+    fprintf(output, "\ncorrelation");
+    for(unsigned param = 0; param < N_PARAMETERS; param++) {
+        fprintf(output, "\t%s", parameter_names[param]);
+    }
+    fprintf(output, "\n");
+    for(unsigned row = 0; row < N_PARAMETERS; row++) {
+        fprintf(output, "%s", parameter_names[row]);
+        for(unsigned column = 0; column < N_PARAMETERS; column++) {
+            double covariance = 0.0;
+            for(unsigned iter = 0; iter < n; iter++) {
+                covariance += (estimates[iter][row] - mean[row]) * (estimates[iter][column] - mean[column]);
+            }
+            const double scale = deviation[row] * deviation[column] * (n - 1);
+            fprintf(output, "\t%.3lf", scale > 0.0 ? covariance / scale : NAN);
+        }
+        fprintf(output, "\n");
+    }
+}
+
+int run_bootstrap(const BootstrapConfig *const bootstrap, const GeneticAlgorithmConfig *const config, const long seed, const Scheduler *const scheduler, FILE *const output) {
+    const unsigned n_replicates = bootstrap->n_replicates;
+    const double start = omp_get_wtime();
+
+    Multiplexer multiplexer;
+    multiplexer_init(&multiplexer);
+
+    /* Fit the original observations */
+    GeneticAlgorithm fit;
+    GeneticAlgorithm *fit_pointer = &fit;
+    if(multiplexer_init_runs(scheduler, &fit_pointer, &config, &seed, 1) != 0) {
+        fprintf(stderr, "Could not allocate the fit\n");
+        multiplexer_free(&multiplexer);
+        return 1;
+    }
+    for(unsigned generation = 0; generation < config->n_generations; generation++) {
+        multiplexer_step(&multiplexer, scheduler, &fit_pointer, 1);
+    }
+    const Phenotype p = genoype_to_phenotype(fit.best.genotype, config->encoding);
+    const double fit_time = omp_get_wtime() - start;
+
+    /* Start every replicate from the final population of the fit */
+    Dataset *datasets = (Dataset *) malloc(sizeof(Dataset) * n_replicates);
+    GeneticAlgorithmConfig *configs = (GeneticAlgorithmConfig *) malloc(sizeof(GeneticAlgorithmConfig) * n_replicates);
+    GeneticAlgorithm *gas = (GeneticAlgorithm *) malloc(sizeof(GeneticAlgorithm) * n_replicates);
+    GeneticAlgorithm **pointers = (GeneticAlgorithm **) malloc(sizeof(GeneticAlgorithm *) * n_replicates);
+    double (*estimates)[N_PARAMETERS] = (double (*)[N_PARAMETERS]) malloc(sizeof(double) * N_PARAMETERS * n_replicates);
+    Random rng;
+    random_seed(&rng, seed + 104729L);
+
+    unsigned n_allocated = 0;
+    if(datasets != NULL && configs != NULL && gas != NULL && pointers != NULL && estimates != NULL) {
+        for(; n_allocated < n_replicates; n_allocated++) {
+            resample_dataset(config, &p, bootstrap->resampling, &rng, datasets + n_allocated);
+            configs[n_allocated] = *config;
+            configs[n_allocated].dataset = datasets + n_allocated;
+            configs[n_allocated].n_generations = bootstrap->n_generations;
+            configs[n_allocated].warm_start = 0.0;
+            /* Replicates are throwaway datasets, not worth archiving */
+            configs[n_allocated].archive = NULL;
+
+            if(genetic_algorithm_alloc(gas + n_allocated, configs + n_allocated, seed + 7919L * (n_allocated + 1)) != 0) {
+                break;
+            }
+            for(unsigned iter = 0; iter < fit.n_individuals; iter++) {
+                gas[n_allocated].individuals[iter].genotype = fit.individuals[iter].genotype;
+                gas[n_allocated].individuals[iter].fidelity = FIDELITY_HIGH;
+            }
+            pointers[n_allocated] = gas + n_allocated;
+        }
+    }
+
+    if(n_allocated < n_replicates) {
+        fprintf(stderr, "Could not allocate the replicates\n");
+        for(unsigned replicate = 0; replicate < n_allocated; replicate++) {
+            genetic_algorithm_free(gas + replicate);
+        }
+        multiplexer_free(&multiplexer);
+        genetic_algorithm_free(&fit);
+        free(estimates);
+        free(pointers);
+        free(gas);
+        free(configs);
+        free(datasets);
+        return 1;
+    }
+    multiplexer_evaluate_runs(&multiplexer, scheduler, pointers, n_replicates);
+    for(unsigned generation = 0; generation < bootstrap->n_generations; generation++) {
+        multiplexer_step(&multiplexer, scheduler, pointers, n_replicates);
+    }
+    multiplexer_free(&multiplexer);
+
+    fprintf(output, "replicate\tfitness\tphi\tlambda\tmu\tsigma\tdelta\n");
+    fprintf(output, "fit\t%lf\t%lf\t%lf\t%lf\t%lf\t%lf\n", fit.best.fitness, p.phi, p.lambda, p.mu, p.sigma, p.delta);
+
+    unsigned n_valid = 0;
+    for(unsigned replicate = 0; replicate < n_replicates; replicate++) {
+        const Individual *const best = &(gas[replicate].best);
+        const Phenotype q = genoype_to_phenotype(best->genotype, config->encoding);
+
+        fprintf(output, "%u\t%lf\t%lf\t%lf\t%lf\t%lf\t%lf\n", replicate, best->fitness, q.phi, q.lambda, q.mu, q.sigma, q.delta);
+        if(best->fitness != DBL_MAX) {
+            for(unsigned param = 0; param < N_PARAMETERS; param++) {
+                estimates[n_valid][param] = phenotype_parameter_value(&q, param);
+            }
+            n_valid++;
+        }
+        genetic_algorithm_free(gas + replicate);
+    }
+
+    if(n_valid > 0) {
+        summarise_bootstrap((const double (*)[N_PARAMETERS]) estimates, n_valid, &p, bootstrap->confidence, output);
+    }
+
+    const double elapsed = omp_get_wtime() - start;
+    fprintf(stderr, "Fit in %.3lf s, %u replicates of %u generations in %.3lf s, %u of them valid\n",
+            fit_time, n_replicates, bootstrap->n_generations, elapsed - fit_time, n_valid);
+
+    genetic_algorithm_free(&fit);
+    free(estimates);
+    free(pointers);
+    free(gas);
+    free(configs);
+    free(datasets);
+    return 0;
+}
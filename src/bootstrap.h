@@ -0,0 +1,41 @@
+#pragma once
+#include "genetic-algorithm.h"
+#include "scheduler.h"
+#include <stdio.h>
+
+/* Way of generating the observations of a bootstrap replicate, always keeping
+ * the first one, the initial condition of the model.
+ */
+typedef enum {
+    /* Draw the observations with replacement, keeping the weight of those
+     * drawn at least once and zeroing the others.
+     */
+    RESAMPLING_CASES,
+    /* Add to the predictions of the fit its residuals drawn with replacement.
+     */
+    RESAMPLING_RESIDUALS,
+} Resampling;
+
+typedef struct {
+    unsigned n_replicates;
+    /* Generations of every replicate, started from the final population of
+     * the fit of the original observations.
+     */
+    unsigned n_generations;
+    Resampling resampling;
+    /* Coverage of the percentile intervals.
+     */
+    double confidence;
+} BootstrapConfig;
+
+/* Fit the model to `config->dataset` and then to `bootstrap->n_replicates`
+ * replicates of it, writing to `output` the estimates of every replicate,
+ * percentile intervals of the parameters and their correlations.
+ *
+ * The replicates advance in lockstep on `scheduler`, evaluating the children
+ * of all of them as one batch, each one warm-started from the final
+ * population of the original fit re-evaluated on its own observations.
+ *
+ * Returns `0` on success, and `1` if the runs cannot be allocated.
+ */
+int run_bootstrap(const BootstrapConfig *const bootstrap, const GeneticAlgorithmConfig *const config, const long seed, const Scheduler *const scheduler, FILE *const output);
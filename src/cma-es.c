@@ -0,0 +1,428 @@
+#include "cma-es.h"
+#include "equations.h"
+#include "genetic-algorithm.h"
+#include "genotype.h"
+#include "initialization.h"
+#include "metrics.h"
+#include "perf-counters.h"
+#include "randombits.h"
+#include "real-coded.h"
+#include "report.h"
+#include "scheduler.h"
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N N_PARAMETERS
+
+/* Default population size for the dimension of the problem.
+ */
+#define DEFAULT_LAMBDA (4 + (unsigned) (3.0 * log(N)))
+
+static const double pi = 3.14159265358979323846;
+
+/* Initial normalised step size, a third of the search ranges.
+ */
+static const double initial_sigma = 0.3;
+
+/* Thresholds of convergence: step size relative to the unit cube, relative
+ * spread of the fitness of a generation, and condition of the covariance.
+ */
+static const double tol_x = 1.0e-12;
+static const double tol_fun = 1.0e-12;
+static const double max_condition = 1.0e14;
+
+/* Samples of a generation, evaluated by the scheduler.
+ */
+typedef struct {
+    RealIndividual *samples;
+    const GeneticAlgorithmConfig *config;
+} SampleBatch;
+
+/* Sample of the standard normal distribution through the Box-Muller
+ * transform.
+ */
+static double gaussian(Random *const rng) {
+    double u;
+    do {
+        u = uniform(rng);
+    } while(u <= 0.0);
+
+    return sqrt(-2.0 * log(u)) * cos(2.0 * pi * uniform(rng));
+}
+
+/* Reflect `x` into `[0, 1]`.
+ */
+static inline double reflect(const double x) {
+    const double t = fmod(fabs(x), 2.0);
+
+    return t <= 1.0 ? t : 2.0 - t;
+}
+
+/* Eigendecomposition of the symmetric matrix `A` with the cyclic Jacobi
+ * method, storing the eigenvectors in the columns of `V` and the eigenvalues
+ * in `d`.
+ */
+static void jacobi_eigen(const double A[N][N], double V[N][N], double d[N]) {
+    double a[N][N];
+
+    for(unsigned i = 0; i < N; i++) {
+        for(unsigned j = 0; j < N; j++) {
+            a[i][j] = A[i][j];
+            V[i][j] = i == j;
+        }
+    }
+
+    for(unsigned sweep = 0; sweep < 50; sweep++) {
+        double off = 0.0;
+        for(unsigned i = 0; i < N; i++) {
+            for(unsigned j = i + 1; j < N; j++) {
+                off += a[i][j] * a[i][j];
+            }
+        }
+        if(off < 1e-30) {
+            break;
+        }
+
+        for(unsigned p = 0; p < N; p++) {
+            for(unsigned q = p + 1; q < N; q++) {
+                if(a[p][q] == 0.0) {
+                    continue;
+                }
+
+                const double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+                const double t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+                const double c = 1.0 / sqrt(t * t + 1.0);
+                const double s = t * c;
+
+                for(unsigned k = 0; k < N; k++) {
+                    const double akp = a[k][p];
+                    const double akq = a[k][q];
+                    a[k][p] = c * akp - s * akq;
+                    a[k][q] = s * akp + c * akq;
+                }
+                for(unsigned k = 0; k < N; k++) {
+                    const double apk = a[p][k];
+                    const double aqk = a[q][k];
+                    a[p][k] = c * apk - s * aqk;
+                    a[q][k] = s * apk + c * aqk;
+                }
+                for(unsigned k = 0; k < N; k++) {
+                    const double vkp = V[k][p];
+                    const double vkq = V[k][q];
+                    V[k][p] = c * vkp - s * vkq;
+                    V[k][q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+
+    for(unsigned i = 0; i < N; i++) {
+        d[i] = a[i][i];
+    }
+}
+
+/* Refresh the eigendecomposition of the covariance matrix.
+ */
+static void update_eigen(CMAES *const es) {
+    double eigenvalues[N];
+
+    for(unsigned i = 0; i < N; i++) {
+        for(unsigned j = 0; j < i; j++) {
+            es->C[j][i] = es->C[i][j];
+        }
+    }
+    jacobi_eigen((const double (*)[N]) es->C, es->B, eigenvalues);
+
+    for(unsigned i = 0; i < N; i++) {
+        es->D[i] = sqrt(fmax(eigenvalues[i], DBL_MIN));
+    }
+    es->eigen_generation = es->generation;
+}
+
+void cma_es_init(CMAES *const es, const unsigned lambda, const double *const mean, const double sigma) {
+    es->lambda = lambda;
+    es->mu = lambda / 2;
+    es->weights = (double *) malloc(sizeof(double) * es->mu);
+
+    double sum = 0.0;
+    double sum_squares = 0.0;
+    for(unsigned i = 0; i < es->mu; i++) {
+        es->weights[i] = log(es->mu + 0.5) - log(i + 1.0);
+        sum += es->weights[i];
+    }
+    for(unsigned i = 0; i < es->mu; i++) {
+        es->weights[i] /= sum;
+        sum_squares += es->weights[i] * es->weights[i];
+    }
+    es->mueff = 1.0 / sum_squares;
+
+    es->cc = (4.0 + es->mueff / N) / (N + 4.0 + 2.0 * es->mueff / N);
+    es->cs = (es->mueff + 2.0) / (N + es->mueff + 5.0);
+    es->c1 = 2.0 / ((N + 1.3) * (N + 1.3) + es->mueff);
+    es->cmu = fmin(1.0 - es->c1, 2.0 * (es->mueff - 2.0 + 1.0 / es->mueff) / ((N + 2.0) * (N + 2.0) + es->mueff));
+    es->damps = 1.0 + 2.0 * fmax(0.0, sqrt((es->mueff - 1.0) / (N + 1.0)) - 1.0) + es->cs;
+    es->chi_n = sqrt(N) * (1.0 - 1.0 / (4.0 * N) + 1.0 / (21.0 * N * N));
+
+    const double interval = 1.0 / ((es->c1 + es->cmu) * N * 10.0);
+    es->eigen_interval = interval > 1.0 ? (unsigned) interval : 1;
+    es->eigen_generation = 0;
+
+    es->sigma = sigma;
+    for(unsigned i = 0; i < N; i++) {
+        es->mean[i] = mean[i];
+        es->pc[i] = 0.0;
+        es->ps[i] = 0.0;
+        es->D[i] = 1.0;
+        for(unsigned j = 0; j < N; j++) {
+            es->C[i][j] = i == j;
+            es->B[i][j] = i == j;
+        }
+    }
+
+    es->x = (double (*)[N]) malloc(sizeof(double) * N * lambda);
+    es->samples = (RealIndividual *) malloc(sizeof(RealIndividual) * lambda);
+    es->ranking = (SampleRank *) malloc(sizeof(SampleRank) * lambda);
+    es->generation = 0;
+    es->best_fitness = DBL_MAX;
+    es->best_generation = 0;
+    es->fitness_range = DBL_MAX;
+}
+
+void cma_es_free(CMAES *const es) {
+    free(es->weights);
+    free(es->x);
+    free(es->samples);
+    free(es->ranking);
+    es->weights = NULL;
+    es->x = NULL;
+    es->samples = NULL;
+    es->ranking = NULL;
+}
+
+void cma_es_sample(CMAES *const es, Random *const rng) {
+    for(unsigned k = 0; k < es->lambda; k++) {
+        double z[N];
+        for(unsigned i = 0; i < N; i++) {
+            z[i] = es->D[i] * gaussian(rng);
+        }
+
+        for(unsigned i = 0; i < N; i++) {
+            double y = 0.0;
+            for(unsigned j = 0; j < N; j++) {
+                y += es->B[i][j] * z[j];
+            }
+            es->x[k][i] = es->mean[i] + es->sigma * y;
+
+            const double range = genotype_layout[i].upper - genotype_layout[i].lower;
+            *phenotype_parameter(&(es->samples[k].phenotype), i) = genotype_layout[i].lower + range * reflect(es->x[k][i]);
+        }
+    }
+}
+
+static int compare_individuals(const void *a, const void *b) {
+    const double x = ((const Individual *) a)->fitness;
+    const double y = ((const Individual *) b)->fitness;
+
+    return (x > y) - (x < y);
+}
+
+static int compare_samples(const void *a, const void *b) {
+    const double x = ((const SampleRank *) a)->fitness;
+    const double y = ((const SampleRank *) b)->fitness;
+
+    return (x > y) - (x < y);
+}
+
+void cma_es_update(CMAES *const es) {
+    for(unsigned k = 0; k < es->lambda; k++) {
+        es->ranking[k] = (SampleRank) { .fitness = es->samples[k].fitness, .index = k };
+    }
+    qsort(es->ranking, es->lambda, sizeof(SampleRank), compare_samples);
+
+    const double best = es->samples[es->ranking[0].index].fitness;
+    const double worst = es->samples[es->ranking[es->lambda - 1].index].fitness;
+    es->fitness_range = worst == DBL_MAX ? DBL_MAX : (worst - best) / fmax(fabs(best), DBL_MIN);
+    if(best < es->best_fitness) {
+        es->best_fitness = best;
+        es->best_generation = es->generation;
+    }
+
+    /* Recombination of the mean, and the step `y_w` it took */
+    double old_mean[N];
+    double y_w[N];
+    for(unsigned i = 0; i < N; i++) {
+        old_mean[i] = es->mean[i];
+        es->mean[i] = 0.0;
+        for(unsigned k = 0; k < es->mu; k++) {
+            es->mean[i] += es->weights[k] * es->x[es->ranking[k].index][i];
+        }
+        y_w[i] = (es->mean[i] - old_mean[i]) / es->sigma;
+    }
+
+    /* Cumulation of the step size path, with C^(-1/2) = B D^(-1) B^T */
+    double bt_y[N];
+    for(unsigned i = 0; i < N; i++) {
+        bt_y[i] = 0.0;
+        for(unsigned j = 0; j < N; j++) {
+            bt_y[i] += es->B[j][i] * y_w[j];
+        }
+        bt_y[i] /= es->D[i];
+    }
+    const double cs_factor = sqrt(es->cs * (2.0 - es->cs) * es->mueff);
+    double ps_norm = 0.0;
+    for(unsigned i = 0; i < N; i++) {
+        double c_y = 0.0;
+        for(unsigned j = 0; j < N; j++) {
+            c_y += es->B[i][j] * bt_y[j];
+        }
+        es->ps[i] = (1.0 - es->cs) * es->ps[i] + cs_factor * c_y;
+        ps_norm += es->ps[i] * es->ps[i];
+    }
+    ps_norm = sqrt(ps_norm);
+
+    /* Cumulation of the covariance path, stalled while the step size grows */
+    const double decay = 1.0 - pow(1.0 - es->cs, 2.0 * (es->generation + 1));
+    const int hsig = ps_norm / sqrt(decay) / es->chi_n < 1.4 + 2.0 / (N + 1.0);
+    const double cc_factor = sqrt(es->cc * (2.0 - es->cc) * es->mueff);
+    for(unsigned i = 0; i < N; i++) {
+        es->pc[i] = (1.0 - es->cc) * es->pc[i] + hsig * cc_factor * y_w[i];
+    }
+
+    /* Rank-one and rank-mu updates of the covariance matrix (lower half) */
+    const double old_weight = 1.0 - es->c1 - es->cmu + (1 - hsig) * es->c1 * es->cc * (2.0 - es->cc);
+    for(unsigned i = 0; i < N; i++) {
+        for(unsigned j = 0; j <= i; j++) {
+            double rank_mu = 0.0;
+            for(unsigned k = 0; k < es->mu; k++) {
+                const double *const x = es->x[es->ranking[k].index];
+                rank_mu += es->weights[k] * (x[i] - old_mean[i]) * (x[j] - old_mean[j]);
+            }
+            es->C[i][j] = old_weight * es->C[i][j] + es->c1 * es->pc[i] * es->pc[j]
+                + es->cmu * rank_mu / (es->sigma * es->sigma);
+        }
+    }
+
+    es->sigma *= exp((es->cs / es->damps) * (ps_norm / es->chi_n - 1.0));
+    es->generation++;
+
+    if(es->generation - es->eigen_generation >= es->eigen_interval) {
+        update_eigen(es);
+    }
+}
+
+int cma_es_should_restart(const CMAES *const es) {
+    double d_min = es->D[0];
+    double d_max = es->D[0];
+    for(unsigned i = 1; i < N; i++) {
+        d_min = fmin(d_min, es->D[i]);
+        d_max = fmax(d_max, es->D[i]);
+    }
+
+    const unsigned patience = 10 + (unsigned) ceil(30.0 * N / es->lambda);
+
+    return es->sigma * d_max < tol_x
+        || es->fitness_range < tol_fun
+        || (d_max / d_min) * (d_max / d_min) > max_condition
+        || es->generation - es->best_generation > patience;
+}
+
+/* Scheduler task evaluating the `index`-th sample of a generation.
+ */
+static void evaluate_task(const unsigned index, void *const data) {
+    const SampleBatch *const batch = (SampleBatch *) data;
+    RealIndividual *const sample = batch->samples + index;
+
+    perf_begin(REGION_FITNESS);
+    sample->fitness = get_phenotype_fitness(sample->phenotype, batch->config->dataset, batch->config->integrator, batch->config->controller, batch->config->event_location, FIDELITY_HIGH);
+    perf_end(REGION_FITNESS);
+}
+
+RealIndividual run_cma_es(const GeneticAlgorithmConfig *const config, const RestartStrategy restarts, const long seed, const Scheduler *const scheduler) {
+    const unsigned long budget = (unsigned long) config->n_individuals * config->n_generations;
+    const unsigned default_lambda = DEFAULT_LAMBDA;
+    unsigned long evaluations = 0;
+    unsigned long evaluations_large = 0;
+    unsigned long evaluations_small = 0;
+    unsigned large_lambda = default_lambda;
+    unsigned n_restarts = 0;
+    unsigned generation = 0;
+    Random rng;
+    RealIndividual best = { .fitness = DBL_MAX };
+
+    random_seed(&rng, seed);
+
+    Individual *starts = (Individual *) malloc(sizeof(Individual) * config->n_individuals);
+    const unsigned long drawn = starts != NULL ? initialize_population(starts, config->n_individuals, config, &rng, scheduler) : 0;
+    if(drawn == 0) {
+        fprintf(stderr, "Could not allocate the starting points\n");
+        free(starts);
+        return best;
+    }
+    evaluations += drawn;
+    qsort(starts, config->n_individuals, sizeof(Individual), compare_individuals);
+    best.phenotype = genoype_to_phenotype(starts[0].genotype, config->encoding);
+    best.fitness = starts[0].fitness;
+
+    while(evaluations < budget) {
+        /* Pick the population size and step size of the next run */
+        unsigned lambda = large_lambda;
+        double sigma = initial_sigma;
+        int small = 0;
+        if(restarts == RESTART_BIPOP && n_restarts > 0 && evaluations_small < evaluations_large) {
+            const double u = uniform(&rng);
+            lambda = (unsigned) (default_lambda * pow(0.5 * large_lambda / default_lambda, u * u));
+            lambda = lambda > default_lambda ? lambda : default_lambda;
+            sigma = initial_sigma * pow(10.0, -2.0 * uniform(&rng));
+            small = 1;
+        }
+
+        const Phenotype origin = genoype_to_phenotype(starts[n_restarts % config->n_individuals].genotype, config->encoding);
+        double mean[N];
+        for(unsigned i = 0; i < N; i++) {
+            mean[i] = (phenotype_parameter_value(&origin, i) - genotype_layout[i].lower) / (genotype_layout[i].upper - genotype_layout[i].lower);
+        }
+
+        CMAES es;
+        cma_es_init(&es, lambda, mean, sigma);
+        SampleBatch batch = { .samples = es.samples, .config = config };
+        const unsigned long start = evaluations;
+
+        while(evaluations < budget && !cma_es_should_restart(&es)) {
+            cma_es_sample(&es, &rng);
+            scheduler_run(scheduler, es.lambda, evaluate_task, &batch);
+            evaluations += es.lambda;
+            cma_es_update(&es);
+
+            if(es.samples[es.ranking[0].index].fitness < best.fitness) {
+                best = es.samples[es.ranking[0].index];
+            }
+            if(generation % 100 == 0) {
+                report_progress(generation, best.fitness, &(best.phenotype));
+            }
+            metrics_update(generation, best.fitness, &(best.phenotype));
+            generation++;
+        }
+
+        if(small) {
+            evaluations_small += evaluations - start;
+        } else {
+            evaluations_large += evaluations - start;
+            large_lambda *= 2;
+        }
+        cma_es_free(&es);
+        if(restarts == RESTART_NONE) {
+            break;
+        }
+        if(evaluations < budget) {
+            n_restarts++;
+            printf("Restart %u after %lu evaluations of a run with population %u, best fitness %lf\n",
+                    n_restarts, evaluations, lambda, best.fitness);
+        }
+    }
+
+    printf("Evaluations: %lu, restarts: %u, best fitness %lf\n", evaluations, n_restarts, best.fitness);
+    free(starts);
+    return best;
+}
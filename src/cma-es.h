@@ -0,0 +1,109 @@
+#pragma once
+#include "genetic-algorithm.h"
+#include "randombits.h"
+#include "real-coded.h"
+#include "scheduler.h"
+
+/* Restart strategy of CMA-ES once a run stagnates or converges.
+ */
+typedef enum {
+    /* A single run, stopping when it converges or the budget runs out.
+     */
+    RESTART_NONE,
+    /* Double the population size at every restart (IPOP).
+     */
+    RESTART_IPOP,
+    /* Alternate a regime of doubling population sizes with one of small
+     * populations and step sizes, keeping their evaluations balanced (BIPOP).
+     */
+    RESTART_BIPOP,
+} RestartStrategy;
+
+/* Sample ranked by its fitness.
+ */
+typedef struct {
+    double fitness;
+    unsigned index;
+} SampleRank;
+
+/* State of a run of the covariance matrix adaptation evolution strategy.
+ *
+ * The run searches the phenotype space normalised to the unit cube, whose
+ * bounds are enforced by reflecting samples into it before evaluation, and
+ * shares the evaluation and reporting of the other engines.
+ */
+typedef struct {
+    unsigned lambda;
+    unsigned mu;
+    /* Recombination weights of the `mu` best samples.
+     */
+    double *weights;
+    double mueff;
+    double cc;
+    double cs;
+    double c1;
+    double cmu;
+    double damps;
+    double chi_n;
+    double sigma;
+    double mean[N_PARAMETERS];
+    double pc[N_PARAMETERS];
+    double ps[N_PARAMETERS];
+    double C[N_PARAMETERS][N_PARAMETERS];
+    /* Eigendecomposition `C = B diag(D^2) B^T`, refreshed every
+     * `eigen_interval` generations since its cost is amortised.
+     */
+    double B[N_PARAMETERS][N_PARAMETERS];
+    double D[N_PARAMETERS];
+    unsigned eigen_interval;
+    unsigned eigen_generation;
+    /* Unrepaired samples of the generation in normalised space, and their
+     * repaired phenotypes and fitness.
+     */
+    double (*x)[N_PARAMETERS];
+    RealIndividual *samples;
+    /* Samples from best to worst after an update.
+     */
+    SampleRank *ranking;
+    unsigned generation;
+    /* Best fitness of the run and the generation it was found at, to detect
+     * stagnation.
+     */
+    double best_fitness;
+    unsigned best_generation;
+    /* Spread of the fitness of the last generation.
+     */
+    double fitness_range;
+} CMAES;
+
+/* Start a run with `lambda` samples per generation, centred at `mean` in the
+ * normalised space with the step size `sigma`.
+ */
+void cma_es_init(CMAES *const es, const unsigned lambda, const double *const mean, const double sigma);
+
+/* Release the samples of the run.
+ */
+void cma_es_free(CMAES *const es);
+
+/* Draw the samples of the next generation.
+ */
+void cma_es_sample(CMAES *const es, Random *const rng);
+
+/* Update the distribution from the evaluated samples.
+ */
+void cma_es_update(CMAES *const es);
+
+/* Whether the run converged or stagnated and should be restarted.
+ */
+int cma_es_should_restart(const CMAES *const es);
+
+/* Main function to run CMA-ES with `restarts` until it performs
+ * `config->n_individuals * config->n_generations` evaluations, the budget of
+ * the genetic algorithm with the same configuration.
+ *
+ * An initial population of `config->n_individuals` is drawn as the genetic
+ * algorithm would, and every run starts from the next best of its
+ * individuals, since the region of good fits is too small for a few random
+ * starting points to find it.
+ */
+RealIndividual run_cma_es(const GeneticAlgorithmConfig *const config, const RestartStrategy restarts, const long seed, const Scheduler *const scheduler);
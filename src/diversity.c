@@ -0,0 +1,170 @@
+#include "diversity.h"
+#include "equations.h"
+#include "genotype.h"
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct DiversityScratch {
+    /* Open addressing table of the genotypes, with twice the slots of the
+     * population rounded up to a power of two, and whether each is used.
+     */
+    Genotype *table;
+    unsigned char *used;
+    unsigned capacity;
+};
+
+DiversityScratch *diversity_scratch_alloc(const unsigned n_individuals) {
+    DiversityScratch *const scratch = (DiversityScratch *) malloc(sizeof(DiversityScratch));
+    if(scratch == NULL) {
+        return NULL;
+    }
+
+    scratch->capacity = 1;
+    while(scratch->capacity < 2 * n_individuals) {
+        scratch->capacity <<= 1;
+    }
+    scratch->table = (Genotype *) malloc(sizeof(Genotype) * scratch->capacity);
+    scratch->used = (unsigned char *) malloc(sizeof(unsigned char) * scratch->capacity);
+    if(scratch->table == NULL || scratch->used == NULL) {
+        diversity_scratch_free(scratch);
+        return NULL;
+    }
+
+    return scratch;
+}
+
+void diversity_scratch_free(DiversityScratch *const scratch) {
+    if(scratch != NULL) {
+        free(scratch->table);
+        free(scratch->used);
+        free(scratch);
+    }
+}
+
+/* Genotype of the `index`-th individual of a strided population.
+ */
+static inline const Genotype *genotype_at(const Genotype *const genotypes, const size_t stride, const unsigned index) {
+    return (const Genotype *) ((const char *) genotypes + stride * index);
+}
+
+/* Step of a xorshift64* generator, used to draw the sampled pairs.
+ */
+static inline uint64_t xorshift(uint64_t *const state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+static inline unsigned hamming_distance(const Genotype *const a, const Genotype *const b) {
+    unsigned distance = 0;
+
+    for(unsigned iter = 0; iter < GENOTYPE_WORDS; iter++) {
+        distance += __builtin_popcountll(a->word[iter] ^ b->word[iter]);
+    }
+
+    return distance;
+}
+
+static double sampled_hamming(const Genotype *const genotypes, const size_t stride, const unsigned n_individuals, const unsigned long seed) {
+    uint64_t state = seed | 1;
+    unsigned long total = 0;
+
+    for(unsigned iter = 0; iter < DIVERSITY_SAMPLES; iter++) {
+        const unsigned i = xorshift(&state) % n_individuals;
+        const unsigned j = xorshift(&state) % n_individuals;
+
+        total += hamming_distance(genotype_at(genotypes, stride, i), genotype_at(genotypes, stride, j));
+    }
+
+    return (double) total / ((double) DIVERSITY_SAMPLES * genotype_bits);
+}
+
+static void allele_frequencies(const Genotype *const genotypes, const size_t stride, const unsigned n_individuals, Diversity *const diversity) {
+    unsigned counts[GENOTYPE_MAX_BITS] = { 0 };
+
+    for(unsigned individual = 0; individual < n_individuals; individual++) {
+        const Genotype *const g = genotype_at(genotypes, stride, individual);
+        unsigned bit = 0;
+
+        for(unsigned word = 0; word < GENOTYPE_WORDS; word++) {
+            const unsigned length = __builtin_popcountll(genotype_used_bits[word]);
+
+            for(unsigned iter = 0; iter < length; iter++) {
+                counts[bit++] += (g->word[word] >> iter) & 1;
+            }
+        }
+    }
+
+    diversity->fixed_bits = 0;
+    for(unsigned bit = 0; bit < genotype_bits; bit++) {
+        diversity->allele_frequency[bit] = (double) counts[bit] / n_individuals;
+        diversity->fixed_bits += counts[bit] == 0 || counts[bit] == n_individuals;
+    }
+}
+
+/* Count the distinct genotypes with an open addressing hash set.
+ */
+static unsigned unique_genotypes(const Genotype *const genotypes, const size_t stride, const unsigned n_individuals, DiversityScratch *const scratch) {
+    const unsigned capacity = scratch->capacity;
+    Genotype *const table = scratch->table;
+    unsigned char *const used = scratch->used;
+    unsigned unique = 0;
+
+    memset(used, 0, sizeof(unsigned char) * capacity);
+
+    for(unsigned individual = 0; individual < n_individuals; individual++) {
+        const Genotype *const g = genotype_at(genotypes, stride, individual);
+        unsigned slot = ((g->word[0] * 0x9E3779B97F4A7C15ULL) ^ (g->word[1] * 0xC2B2AE3D27D4EB4FULL)) >> 32;
+
+        for(slot &= capacity - 1; used[slot]; slot = (slot + 1) & (capacity - 1)) {
+            if(memcmp(table + slot, g, sizeof(Genotype)) == 0) {
+                break;
+            }
+        }
+
+        if(!used[slot]) {
+            used[slot] = 1;
+            table[slot] = *g;
+            unique++;
+        }
+    }
+
+    return unique;
+}
+
+static void phenotype_spread(const Genotype *const genotypes, const size_t stride, const unsigned n_individuals, const Encoding encoding, Phenotype *const spread) {
+    Phenotype mean = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+    Phenotype m2 = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+
+    for(unsigned individual = 0; individual < n_individuals; individual++) {
+        const Phenotype p = genoype_to_phenotype(*genotype_at(genotypes, stride, individual), encoding);
+        const double count = individual + 1;
+        double delta;
+
+        delta = p.phi - mean.phi; mean.phi += delta / count; m2.phi += delta * (p.phi - mean.phi);
+        delta = p.lambda - mean.lambda; mean.lambda += delta / count; m2.lambda += delta * (p.lambda - mean.lambda);
+        delta = p.mu - mean.mu; mean.mu += delta / count; m2.mu += delta * (p.mu - mean.mu);
+        delta = p.sigma - mean.sigma; mean.sigma += delta / count; m2.sigma += delta * (p.sigma - mean.sigma);
+        delta = p.delta - mean.delta; mean.delta += delta / count; m2.delta += delta * (p.delta - mean.delta);
+    }
+
+    *spread = (Phenotype) {
+        .phi = sqrt(m2.phi / n_individuals),
+        .lambda = sqrt(m2.lambda / n_individuals),
+        .mu = sqrt(m2.mu / n_individuals),
+        .sigma = sqrt(m2.sigma / n_individuals),
+        .delta = sqrt(m2.delta / n_individuals),
+    };
+}
+
+void measure_diversity(const Genotype *const genotypes, const size_t stride, const unsigned n_individuals, const Encoding encoding, const unsigned long seed, DiversityScratch *const scratch, Diversity *const diversity) {
+    diversity->mean_hamming = sampled_hamming(genotypes, stride, n_individuals, seed);
+    allele_frequencies(genotypes, stride, n_individuals, diversity);
+    diversity->unique = unique_genotypes(genotypes, stride, n_individuals, scratch);
+    phenotype_spread(genotypes, stride, n_individuals, encoding, &(diversity->spread));
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "equations.h"
+#include "genotype.h"
+#include <stddef.h>
+
+/* Number of random pairs of individuals used to estimate the mean pairwise
+ * Hamming distance of a population.
+ */
+#define DIVERSITY_SAMPLES 1024
+
+/* Diversity metrics of a population, to detect premature convergence.
+ */
+typedef struct {
+    /* Estimate of the mean Hamming distance between two individuals, relative
+     * to `genotype_bits`, so that `0` means a converged population and `0.5`
+     * a random one.
+     */
+    double mean_hamming;
+    /* Frequency of ones of each bit of the genotype, numbering the used bits
+     * of both words consecutively.
+     */
+    double allele_frequency[GENOTYPE_MAX_BITS];
+    /* Number of bits whose allele frequency is `0` or `1`.
+     */
+    unsigned fixed_bits;
+    /* Number of distinct genotypes.
+     */
+    unsigned unique;
+    /* Standard deviation of each parameter of the decoded phenotypes.
+     */
+    Phenotype spread;
+} Diversity;
+
+/* Hash set counting the distinct genotypes of a population, kept by the run
+ * from one measurement to the next.
+ */
+typedef struct DiversityScratch DiversityScratch;
+
+/* Allocate the scratch space to measure a population of `n_individuals`,
+ * returning `NULL` if memory runs out.
+ */
+DiversityScratch *diversity_scratch_alloc(const unsigned n_individuals);
+
+void diversity_scratch_free(DiversityScratch *const scratch);
+
+/* Measure the diversity of a population of `n_individuals` genotypes, at most
+ * those `scratch` was allocated for.
+ *
+ * As for the selection, the genotype of the first individual is at `genotypes`
+ * and the following ones every `stride` bytes. The pairs used to sample the
+ * Hamming distance are drawn from `seed`, not from the stream of the run, so
+ * that measuring does not alter the course of the algorithm.
+ */
+void measure_diversity(const Genotype *const genotypes, const size_t stride, const unsigned n_individuals, const Encoding encoding, const unsigned long seed, DiversityScratch *const scratch, Diversity *const diversity);
@@ -0,0 +1,171 @@
+#include "ensemble.h"
+#include "genetic-algorithm.h"
+#include "multiplexer.h"
+#include "report.h"
+#include "scheduler.h"
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static int compare_doubles(const void *a, const void *b) {
+    const double x = *(const double *) a;
+    const double y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+/* Linearly interpolated `q`-quantile of the sorted array `values`.
+ */
+static double quantile(const double *const values, const unsigned length, const double q) {
+    if(length == 0) {
+        return NAN;
+    }
+
+    const double position = q * (length - 1);
+    const unsigned below = (unsigned) position;
+    const unsigned above = below + 1 < length ? below + 1 : below;
+    const double fraction = position - below;
+
+    return values[below] + fraction * (values[above] - values[below]);
+}
+
+/* Fill `summary` from the results in `runs`.
+ */
+static void summarise_ensemble(const unsigned n_runs, const EnsembleRun *const runs, EnsembleSummary *const summary) {
+    double *values = (double *) malloc(sizeof(double) * n_runs);
+
+    for(unsigned iter = 0; iter < n_runs; iter++) {
+        values[iter] = runs[iter].best.fitness;
+    }
+    qsort(values, n_runs, sizeof(double), compare_doubles);
+    summary->median = quantile(values, n_runs, 0.5);
+    summary->q1 = quantile(values, n_runs, 0.25);
+    summary->q3 = quantile(values, n_runs, 0.75);
+
+    unsigned n_reached = 0;
+    for(unsigned iter = 0; iter < n_runs; iter++) {
+        if(runs[iter].reached) {
+            values[n_reached++] = runs[iter].generation;
+        }
+    }
+    summary->n_reached = n_reached;
+    qsort(values, n_reached, sizeof(double), compare_doubles);
+    summary->median_generation = quantile(values, n_reached, 0.5);
+
+    n_reached = 0;
+    for(unsigned iter = 0; iter < n_runs; iter++) {
+        if(runs[iter].reached) {
+            values[n_reached++] = runs[iter].evaluations;
+        }
+    }
+    qsort(values, n_reached, sizeof(double), compare_doubles);
+    summary->median_evaluations = quantile(values, n_reached, 0.5);
+
+    n_reached = 0;
+    for(unsigned iter = 0; iter < n_runs; iter++) {
+        if(runs[iter].reached) {
+            values[n_reached++] = runs[iter].time;
+        }
+    }
+    qsort(values, n_reached, sizeof(double), compare_doubles);
+    summary->median_time = quantile(values, n_reached, 0.5);
+
+    free(values);
+}
+
+/* Record the time to target of the runs that reached it this generation.
+ */
+static void check_target(const unsigned n_runs, const GeneticAlgorithm *const gas, const double target, const double start, EnsembleRun *const runs) {
+    for(unsigned run = 0; run < n_runs; run++) {
+        if(!runs[run].reached && gas[run].best.fitness <= target) {
+            runs[run].reached = 1;
+            runs[run].generation = gas[run].generation;
+            runs[run].evaluations = genetic_algorithm_evaluations(gas + run);
+            runs[run].time = omp_get_wtime() - start;
+        }
+    }
+}
+
+int run_ensemble(const unsigned n_runs, const GeneticAlgorithmConfig *const config, const double target, const long seed, const Scheduler *const scheduler, EnsembleRun *const runs, EnsembleSummary *const summary) {
+    const double start = omp_get_wtime();
+    GeneticAlgorithm *gas = (GeneticAlgorithm *) malloc(sizeof(GeneticAlgorithm) * n_runs);
+    GeneticAlgorithm **pointers = (GeneticAlgorithm **) malloc(sizeof(GeneticAlgorithm *) * n_runs);
+    const GeneticAlgorithmConfig **configs = (const GeneticAlgorithmConfig **) malloc(sizeof(GeneticAlgorithmConfig *) * n_runs);
+    long *seeds = (long *) malloc(sizeof(long) * n_runs);
+
+    for(unsigned run = 0; run < n_runs; run++) {
+        runs[run] = (EnsembleRun) {
+            .seed = seed + 7919L * run,
+            .reached = 0,
+        };
+        pointers[run] = gas + run;
+        configs[run] = config;
+        seeds[run] = runs[run].seed;
+    }
+    if(multiplexer_init_runs(scheduler, pointers, configs, seeds, n_runs) != 0) {
+        fprintf(stderr, "Could not allocate the runs\n");
+        free(seeds);
+        free(configs);
+        free(pointers);
+        free(gas);
+        return 1;
+    }
+    check_target(n_runs, gas, target, start, runs);
+
+    Multiplexer multiplexer;
+    multiplexer_init(&multiplexer);
+    for(unsigned generation = 0; generation < config->n_generations; generation++) {
+        multiplexer_step(&multiplexer, scheduler, pointers, n_runs);
+        check_target(n_runs, gas, target, start, runs);
+
+        if(generation % 100 == 0) {
+            printf("Generation %u\n", generation);
+        }
+    }
+    multiplexer_free(&multiplexer);
+
+    summary->screening = (ScreeningStats) { .evaluations = { 0 }, .audited = 0, .misranked = 0 };
+    for(unsigned run = 0; run < n_runs; run++) {
+        runs[run].best = gas[run].best;
+        for(unsigned fidelity = 0; fidelity < FIDELITIES; fidelity++) {
+            summary->screening.evaluations[fidelity] += gas[run].screening.evaluations[fidelity];
+        }
+        summary->screening.audited += gas[run].screening.audited;
+        summary->screening.misranked += gas[run].screening.misranked;
+        genetic_algorithm_free(gas + run);
+    }
+    summarise_ensemble(n_runs, runs, summary);
+
+    free(seeds);
+    free(configs);
+    free(pointers);
+    free(gas);
+    return 0;
+}
+
+void print_ensemble(const unsigned n_runs, const GeneticAlgorithmConfig *const config, const EnsembleRun *const runs, const EnsembleSummary *const summary) {
+    printf("run\tseed\tfitness\tphi\tlambda\tmu\tsigma\tdelta\tgeneration\tevaluations\ttime\n");
+    for(unsigned run = 0; run < n_runs; run++) {
+        const Phenotype p = genoype_to_phenotype(runs[run].best.genotype, config->encoding);
+
+        printf("%u\t%ld\t%lf\t%f\t%f\t%f\t%f\t%f", run, runs[run].seed, runs[run].best.fitness,
+                p.phi, p.lambda, p.mu, p.sigma, p.delta);
+        if(runs[run].reached) {
+            printf("\t%u\t%lu\t%f\n", runs[run].generation, runs[run].evaluations, runs[run].time);
+        } else {
+            printf("\t-\t-\t-\n");
+        }
+    }
+
+    printf("Best fitness median: %lf\n", summary->median);
+    printf("Best fitness IQR: %lf (%lf - %lf)\n", summary->q3 - summary->q1, summary->q1, summary->q3);
+    printf("Runs reaching target: %u of %u\n", summary->n_reached, n_runs);
+    if(summary->n_reached > 0) {
+        printf("Median time to target: %f generations, %f evaluations, %f s\n",
+                summary->median_generation, summary->median_evaluations, summary->median_time);
+    }
+    if(config->screening > 0.0) {
+        report_screening(stdout, &(summary->screening));
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "genetic-algorithm.h"
+#include "scheduler.h"
+
+/* Outcome of a single run of an ensemble.
+ */
+typedef struct {
+    long seed;
+    Individual best;
+    /* Generation, integrations of the model and wall time (in seconds) at which
+     * the best fitness first reached the target, or `reached = 0` if it never
+     * did.
+     */
+    unsigned char reached;
+    unsigned generation;
+    unsigned long evaluations;
+    double time;
+} EnsembleRun;
+
+/* Aggregate statistics of the best fitness of all runs, and of the time to
+ * target of the runs that reached it.
+ */
+typedef struct {
+    double median;
+    double q1;
+    double q3;
+    unsigned n_reached;
+    double median_generation;
+    double median_evaluations;
+    double median_time;
+    /* Screening of the children of all runs together.
+     */
+    ScreeningStats screening;
+} EnsembleSummary;
+
+/* Run `n_runs` independent instances of the genetic algorithm inside the
+ * process, each with its own stream seeded from `seed`.
+ *
+ * The instances advance in lockstep: each generation every run breeds its
+ * children, and then the children of all runs are evaluated as one batch on
+ * `scheduler`, so that no core idles while the slowest run of the generation
+ * finishes its own evaluations.
+ *
+ * Returns `0` on success, and `1` if the runs cannot be allocated.
+ */
+int run_ensemble(const unsigned n_runs, const GeneticAlgorithmConfig *const config, const double target, const long seed, const Scheduler *const scheduler, EnsembleRun *const runs, EnsembleSummary *const summary);
+
+/* Print the results of every run and the aggregate statistics.
+ */
+void print_ensemble(const unsigned n_runs, const GeneticAlgorithmConfig *const config, const EnsembleRun *const runs, const EnsembleSummary *const summary);
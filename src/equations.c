@@ -1,15 +1,20 @@
-#include "RKF78.h"
+#define _POSIX_C_SOURCE 200809L
 #include "equations.h"
+#include "integrator.h"
 #include <float.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
 
 /* Elliot sigmoid Θ-scaled, σ-strengthened, and δ-displaced.
  */
-static double sigmoid(const double x, const double sigma, const double delta);
+static inline double sigmoid(const double x, const double sigma, const double delta);
 
 /* Directed Elliot sigmoid.
  */
-static double sigmoid_dir(const double x, const double mu, const double sigma, const double delta);
+static inline double sigmoid_dir(const double x, const double mu, const double sigma, const double delta);
 
 /* Dispersal by social coping.
  *
@@ -17,16 +22,21 @@ static double sigmoid_dir(const double x, const double mu, const double sigma, c
  * birds generically increases when the population numbers at the patch
  * diminish.
  */
-static double model_dispersal(const double x, const double mu, const double sigma, const double delta);
+static inline double model_dispersal(const double x, const double mu, const double sigma, const double delta);
 
-/* Model to fit to the second epoch to check the hypothesis that the migration
- * of Andouins occurs with social copying.
+/* Adaptation of model_equation function to fit the signature required by the
+ * integrators.
  */
-double model_equation(const double x, const Phenotype *const p);
+void model_ode(double t, double x, double *result, void *p);
 
-/* Adaptation of model_equation function to fit the signature required by RKF78.
+/* Derivative of `model_equation` with respect to `x`, with the signature of
+ * `model_ode`, for the implicit integrators.
  */
-void model_ode(double t, double x, double *result, void *p);
+static void model_jacobian(double t, double x, double *result, void *p);
+
+/* Switching function of `model_dispersal`, which changes branch at `x = delta`.
+ */
+static double model_switching(double t, double x, void *p);
 
 /* Intrinsic growth rate over the carrying capacity (1/year*birds).
  *
@@ -36,32 +46,98 @@ void model_ode(double t, double x, double *result, void *p);
  */
 static const double beta = 0.000024382635446;
 
-/* Scale of the sigmoid function.
+static const double theta = MODEL_THETA;
+
+/* Settings of the integrators for each fidelity.
+ */
+static const struct {
+    double tolerance;
+    double step_min;
+    double step_max;
+} integrator_settings[FIDELITIES] = {
+    [FIDELITY_LOW] = { .tolerance = 1.0e-4, .step_min = 1.0e-2, .step_max = 2.5e-1 },
+    [FIDELITY_HIGH] = { .tolerance = 1.0e-8, .step_min = 1.0e-3, .step_max = 1.0e-2 },
+};
+
+/* Shortest step of the PI and PID controllers, relative to the interval
+ * between observations, the longest one.
+ */
+static const double step_min_fraction = 1.0e-4;
+
+/* Evaluations of the ODE and steps performed by each thread.
+ */
+int ode_counting_enabled = 0;
+static _Thread_local unsigned long ode_evaluations = 0;
+static _Thread_local IntegrationStats integration_stats = { .predictions = 0, .accepted = 0, .rejected = 0, .events = 0 };
+
+/* Steps performed by a thread, written by it alone and summed by any.
  *
- * It is related with the order of magnitude of the carrying capacity K.
+ * The counters outlive their thread, and the next thread to start takes them
+ * over and adds to them, so that the totals neither lose the steps of exited
+ * threads nor grow a list entry per thread ever started.
  */
-static const double theta = 1000.0;
+typedef struct ThreadSteps {
+    atomic_ulong predictions;
+    atomic_ulong accepted;
+    atomic_ulong rejected;
+    atomic_ulong events;
+    /* Whether a running thread owns the counters, under `steps_lock`.
+     */
+    int in_use;
+    struct ThreadSteps *next;
+} ThreadSteps;
 
-static double sigmoid(const double x, const double sigma, const double delta) {
+static ThreadSteps *thread_steps = NULL;
+static pthread_mutex_t steps_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t steps_once = PTHREAD_ONCE_INIT;
+static pthread_key_t steps_key;
+static _Thread_local ThreadSteps *own_steps = NULL;
+
+static inline double sigmoid(const double x, const double sigma, const double delta) {
     const double numerator = sigma * (x - delta);
     const double denominator = theta + sigma * fabs(x - delta);
 
     return numerator / denominator;
 }
 
-static double sigmoid_dir(const double x, const double mu, const double sigma, const double delta) {
+static inline double sigmoid_dir(const double x, const double mu, const double sigma, const double delta) {
     const double dir = mu * ((theta + sigma * delta) / (2 * theta + sigma * delta)) * (1 - x / delta) + x / delta;
 
     return dir * sigmoid(x, sigma, delta);
 }
 
-static double model_dispersal(const double x, const double mu, const double sigma, const double delta) {
+static inline double model_dispersal(const double x, const double mu, const double sigma, const double delta) {
     const double numerator = 1 - (x > delta ? sigmoid(x, sigma, delta) : sigmoid_dir(x, mu, sigma, delta));
     const double denominator = 1 - sigmoid_dir(0, mu, sigma, delta);
 
     return numerator / denominator;
 }
 
+double get_sigmoid(const double x, const double sigma, const double delta) {
+    return sigmoid(x, sigma, delta);
+}
+
+double get_dispersal(const double x, const double mu, const double sigma, const double delta) {
+    return model_dispersal(x, mu, sigma, delta);
+}
+
+/* Derivative of `sigmoid` with respect to `x`.
+ */
+static double sigmoid_derivative(const double x, const double sigma, const double delta) {
+    const double denominator = theta + sigma * fabs(x - delta);
+
+    return sigma * theta / (denominator * denominator);
+}
+
+/* Derivative of `sigmoid_dir` with respect to `x`.
+ */
+static double sigmoid_dir_derivative(const double x, const double mu, const double sigma, const double delta) {
+    const double scale = mu * ((theta + sigma * delta) / (2 * theta + sigma * delta));
+    const double dir = scale * (1 - x / delta) + x / delta;
+
+    return (1 - scale) / delta * sigmoid(x, sigma, delta) + dir * sigmoid_derivative(x, sigma, delta);
+}
+
 double model_equation(const double x, const Phenotype *const p) {
     const double base = (p->phi * x) - (beta * x * x);
 
@@ -69,59 +145,211 @@ double model_equation(const double x, const Phenotype *const p) {
 }
 
 void model_ode(double __attribute__((unused)) t, double x, double *result, void *p) {
+    if(ode_counting_enabled) {
+        ode_evaluations++;
+    }
     *result = model_equation(x, p);
 }
 
-int model_prediction(const double x0, double *const x, const unsigned length, const Phenotype *const p) {
+static void model_jacobian(double __attribute__((unused)) t, double x, double *result, void *params) {
+    const Phenotype *const p = (const Phenotype *) params;
+    const double slope = x > p->delta ? sigmoid_derivative(x, p->sigma, p->delta) : sigmoid_dir_derivative(x, p->mu, p->sigma, p->delta);
+    const double denominator = 1 - sigmoid_dir(0, p->mu, p->sigma, p->delta);
+
+    if(ode_counting_enabled) {
+        ode_evaluations++;
+    }
+    *result = p->phi - 2 * beta * x + p->lambda * slope / denominator;
+}
+
+static double model_switching(double __attribute__((unused)) t, double x, void *p) {
+    return x - ((const Phenotype *) p)->delta;
+}
+
+unsigned long get_ode_evaluations(void) {
+    return ode_evaluations;
+}
+
+IntegrationStats get_integration_stats(void) {
+    return integration_stats;
+}
+
+IntegrationStats get_total_integration_stats(void) {
+    IntegrationStats total = { .predictions = 0, .accepted = 0, .rejected = 0, .events = 0 };
+
+    pthread_mutex_lock(&steps_lock);
+    for(const ThreadSteps *steps = thread_steps; steps != NULL; steps = steps->next) {
+        total.predictions += atomic_load_explicit(&(steps->predictions), memory_order_relaxed);
+        total.accepted += atomic_load_explicit(&(steps->accepted), memory_order_relaxed);
+        total.rejected += atomic_load_explicit(&(steps->rejected), memory_order_relaxed);
+        total.events += atomic_load_explicit(&(steps->events), memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&steps_lock);
+
+    return total;
+}
+
+/* Hand the counters of an exiting thread over to the next one.
+ */
+static void release_steps(void *const steps) {
+    pthread_mutex_lock(&steps_lock);
+    ((ThreadSteps *) steps)->in_use = 0;
+    pthread_mutex_unlock(&steps_lock);
+}
+
+static void create_steps_key(void) {
+    pthread_key_create(&steps_key, release_steps);
+}
+
+/* Counters of the calling thread, those of an exited thread if any or new
+ * ones, or `NULL` if memory runs out.
+ */
+static ThreadSteps *acquire_steps(void) {
+    pthread_once(&steps_once, create_steps_key);
+
+    pthread_mutex_lock(&steps_lock);
+    ThreadSteps *steps = thread_steps;
+    while(steps != NULL && steps->in_use) {
+        steps = steps->next;
+    }
+    if(steps == NULL && (steps = (ThreadSteps *) calloc(1, sizeof(ThreadSteps))) != NULL) {
+        steps->next = thread_steps;
+        thread_steps = steps;
+    }
+    if(steps != NULL) {
+        steps->in_use = 1;
+        pthread_setspecific(steps_key, steps);
+    }
+    pthread_mutex_unlock(&steps_lock);
+
+    return steps;
+}
+
+/* Add `n` to a counter of the calling thread, which no other thread writes,
+ * with a plain load and store instead of a locked read-modify-write.
+ */
+static inline void add_steps(atomic_ulong *const counter, const unsigned long n) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+/* Add the steps of `integrator` to the statistics of the thread and of the
+ * process, and store them in `stats` unless `NULL`.
+ */
+static void count_steps(const Integrator *const integrator, IntegrationStats *const stats) {
+    integration_stats.predictions++;
+    integration_stats.accepted += integrator->accepted;
+    integration_stats.rejected += integrator->rejected;
+    integration_stats.events += integrator->events;
+
+    if(own_steps != NULL || (own_steps = acquire_steps()) != NULL) {
+        add_steps(&(own_steps->predictions), 1);
+        add_steps(&(own_steps->accepted), integrator->accepted);
+        add_steps(&(own_steps->rejected), integrator->rejected);
+        add_steps(&(own_steps->events), integrator->events);
+    }
+
+    if(stats != NULL) {
+        *stats = (IntegrationStats) {
+            .predictions = 1,
+            .accepted = integrator->accepted,
+            .rejected = integrator->rejected,
+            .events = integrator->events,
+        };
+    }
+}
+
+/* First step of an integration from `x0` with steps in `[step_min,
+ * step_max]`: a hundredth of the time the field takes to change `x0` by its
+ * own size, or by one bird near extinction.
+ */
+static double initial_step(const double x0, const Phenotype *const p, const double step_min, const double step_max) {
+    double f0;
+    model_ode(0.0, x0, &f0, (void *) p);
+
+    return fmin(fmax(0.01 * fmax(fabs(x0), 1.0) / fmax(fabs(f0), DBL_MIN), step_min), step_max);
+}
+
+int model_prediction(const double x0, double *const x, const unsigned length, const Phenotype *const p, const IntegratorMethod method, const StepController controller, const int event_location, const Fidelity fidelity, IntegrationStats *const stats) {
     double t = 0.0;
     double y = x0;
-    double step = 1.0e-2;
-    double error;
-    const double step_min = 1.0e-3;
-    const double step_max = 1.0e-2;
-    const double tolerance = 1.0e-8;
+    double step_min = integrator_settings[fidelity].step_min;
+    double step_max = integrator_settings[fidelity].step_max;
+    double step = step_max;
+    Integrator integrator;
+
+    /* The elementary controller keeps the step bounds RKF78 was tuned with
+     * for each fidelity. The others take steps of up to the interval between
+     * observations, one year, starting from one estimated from the time scale
+     * of the initial condition, so that only the tolerance limits them */
+    if(controller != CONTROLLER_ELEMENTARY) {
+        step_max = 1.0;
+        step_min = step_min_fraction * step_max;
+        step = initial_step(x0, p, step_min, step_max);
+    }
+
+    integrator_init(&integrator, method, integrator_settings[fidelity].tolerance, step_min, step_max);
+    integrator_set_controller(&integrator, controller);
+    integrator_set_jacobian(&integrator, model_jacobian);
+    if(event_location) {
+        integrator_add_switch(&integrator, model_switching);
+    }
 
+    int result = 0;
     unsigned iter = 1;
-    for(double t_end = 1; t_end < length; t_end++) {
-        while(t + step < t_end) {
-            int result = RKF78(&t, &y, &step, &error, step_min, step_max, tolerance, (void *) p, model_ode);
-            if(result != 0) {
-                return result;
+    for(double t_end = 1; t_end < length && result == 0; t_end++) {
+        /* Steps cut at a crossing may stop short of the end of the year */
+        while(result == 0 && t_end - t > 1.0e-9) {
+            if(t + step > t_end) {
+                step = t_end - t;
             }
-            if(!isnormal(y)) {
-                return 1;
+            result = integrator_step(&integrator, &t, &y, &step, model_ode, (void *) p);
+            if(result == 0 && !isnormal(y)) {
+                result = 1;
             }
         }
-        step = t_end - t;
-
-        int result = RKF78(&t, &y, &step, &error, step_min, step_max, tolerance, (void *) p, model_ode);
-        if(result != 0) {
-            return result;
-        }
-        if(!isnormal(y)) {
-            return 1;
-        }
+        t = t_end;
 
         x[iter] = y;
         iter++;
     }
     x[0] = x0;
+    count_steps(&integrator, stats);
+
+    return result;
+}
+
+const Dataset default_dataset = {
+    .length = 12,
+    .y = { 15329.0, 14177.0, 13031.0, 9762.0, 11271.0, 8688.0, 7571.0, 6983.0, 4778.0, 2067.0, 1586.0, 793.0 },
+    .w = {     1.0,     1.0,     1.0,    0.0,     1.0,    1.0,    1.0,    1.0,    3.0,    3.0,    3.0,   8.0 },
+};
+
+unsigned dataset_parse_list(char *const list, double *const values) {
+    unsigned length = 0;
+    char *save;
+
+    for(char *token = strtok_r(list, ",", &save); token != NULL; token = strtok_r(NULL, ",", &save)) {
+        if(length == DATASET_MAX_LENGTH) {
+            return DATASET_MAX_LENGTH + 1;
+        }
+        values[length++] = strtod(token, NULL);
+    }
 
-    return 0;
+    return length;
 }
 
-double get_phenotype_fitness(const Phenotype p) {
-    double x[12] = { 15329.0 };
-    int err = model_prediction(x[0], x, 12, &p);
+double get_phenotype_fitness(const Phenotype p, const Dataset *const data, const IntegratorMethod method, const StepController controller, const int event_location, const Fidelity fidelity) {
+    double x[DATASET_MAX_LENGTH] = { data->y[0] };
+    int err = model_prediction(x[0], x, data->length, &p, method, controller, event_location, fidelity, NULL);
     if(err != 0) {
         return DBL_MAX;
     }
 
     // double fitness = 0.0;
     double fitness = DBL_MAX_EXP;
-    const double y[12] = { 15329.0, 14177.0, 13031.0, 9762.0, 11271.0, 8688.0, 7571.0, 6983.0, 4778.0, 2067.0, 1586.0, 793.0 };
-    const double w[12] = {     1.0,     1.0,     1.0,    0.0,     1.0,    1.0,    1.0,    1.0,    3.0,    3.0,    3.0,   8.0 };
-    for(unsigned char iter = 1; iter < 12; iter++) {
+    const double *const y = data->y;
+    const double *const w = data->w;
+    for(unsigned char iter = 1; iter < data->length; iter++) {
         const double tmp = w[iter] * (y[iter] - x[iter]) * (y[iter] - x[iter]);
         // fitness += tmp;
         if(tmp > fitness) {
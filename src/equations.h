@@ -1,4 +1,5 @@
 #pragma once
+#include "integrator.h"
 
 /* Contains the parameters for the model with equation
  *
@@ -43,14 +44,114 @@ typedef struct {
     double delta;
 } Phenotype;
 
+/* Accuracy of the integration of the model.
+ */
+typedef enum {
+    /* Loose tolerance and long steps, cheap enough to screen candidates.
+     */
+    FIDELITY_LOW,
+    /* Reference accuracy, the one of every reported fitness.
+     */
+    FIDELITY_HIGH,
+    FIDELITIES,
+} Fidelity;
+
+/* Maximum number of observations of a dataset.
+ */
+#define DATASET_MAX_LENGTH 64
+
+/* Yearly observations of a colony to fit the model to, and the weight of the
+ * error of each of them.
+ *
+ * The first observation is the initial condition of the predictions.
+ */
+typedef struct {
+    unsigned length;
+    double y[DATASET_MAX_LENGTH];
+    double w[DATASET_MAX_LENGTH];
+} Dataset;
+
+/* Second epoch of the colony, used when no other dataset is given.
+ */
+extern const Dataset default_dataset;
+
+/* Parse the comma separated list of numbers `list` into `values`, returning
+ * its length, or `DATASET_MAX_LENGTH + 1` if it does not fit.
+ */
+unsigned dataset_parse_list(char *const list, double *const values);
+
+/* Steps of integrations of the model.
+ */
+typedef struct {
+    /* Predictions integrated, one per fitness evaluation.
+     */
+    unsigned long predictions;
+    unsigned long accepted;
+    unsigned long rejected;
+    /* Crossings of the switching surface `x = delta` of the dispersal.
+     */
+    unsigned long events;
+} IntegrationStats;
+
+/* Scale of the sigmoid function.
+ *
+ * It is related with the order of magnitude of the carrying capacity K.
+ */
+#define MODEL_THETA (1000.0)
+
+/* Elliot sigmoid of the dispersal at `x`, Θ-scaled, σ-strengthened, and
+ * δ-displaced, as evaluated by `model_equation`.
+ */
+double get_sigmoid(const double x, const double sigma, const double delta);
+
+/* Dispersal function Ψ(x, μ, σ, δ) of the model, as evaluated by
+ * `model_equation`.
+ */
+double get_dispersal(const double x, const double mu, const double sigma, const double delta);
+
+/* Model to fit to the second epoch to check the hypothesis that the migration
+ * of Andouins occurs with social copying.
+ *
+ * Declared SIMD when compiled with OpenMP, so that loops over many
+ * populations evaluate it in the lanes of vector registers.
+ */
+#ifdef _OPENMP
+#pragma omp declare simd uniform(p) notinbranch
+#endif
+double model_equation(const double x, const Phenotype *const p);
+
 /* Computes the predictions of the model with starting condition x0 and
- * parameters p, and stores the result of length length in *x.
+ * parameters p, integrated by `method` with the accuracy of `fidelity` and the
+ * steps of `controller`, cut at the crossings of `x = delta` if
+ * `event_location`, and stores the result of length length in *x, and the
+ * steps it took in `*stats` unless `NULL`.
  *
  * This function will output 0 if it encounters no errors (nans returned by
- * RKF78), and otherwise return the error code given by RKF78.
+ * the integrator), and otherwise return the error code given by it.
+ */
+int model_prediction(const double x0, double *const x, const unsigned length, const Phenotype *const p, const IntegratorMethod method, const StepController controller, const int event_location, const Fidelity fidelity, IntegrationStats *const stats);
+
+/* Calculate fitness of a phenotype through the weighted squared error of its
+ * predictions of `data`, integrated as `model_prediction` does.
+ */
+double get_phenotype_fitness(const Phenotype p, const Dataset *const data, const IntegratorMethod method, const StepController controller, const int event_location, const Fidelity fidelity);
+
+/* Whether evaluations of the ODE are counted, set before integrating by the
+ * modes that report them.
+ *
+ * Disabled counting costs a single predictable branch per evaluation.
+ */
+extern int ode_counting_enabled;
+
+/* Number of evaluations of the ODE performed so far by the calling thread, if
+ * counted.
+ */
+unsigned long get_ode_evaluations(void);
+
+/* Steps of the integrations performed so far by the calling thread.
  */
-int model_prediction(const double x0, double *const x, const unsigned length, const Phenotype *const p);
+IntegrationStats get_integration_stats(void);
 
-/* Calculate fitness of a phenotype through the sum of the squared error.
+/* Steps of the integrations performed so far by every thread.
  */
-double get_phenotype_fitness(const Phenotype p);
+IntegrationStats get_total_integration_stats(void);
@@ -1,130 +1,448 @@
 #include "genetic-algorithm.h"
+#include "archive.h"
 #include "equations.h"
+#include "genetics.h"
 #include "genotype.h"
+#include "initialization.h"
+#include "metrics.h"
+#include "perf-counters.h"
 #include "randombits.h"
+#include "report.h"
+#include "scheduler.h"
+#include "selection.h"
+#include "survivors.h"
 #include <float.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-/* Get a random individual from the population (with replacement).
- *
- * Disregards their fitness or genotype.
+/* Returns the index of a random individual from the population.
  */
-static Individual select_random_individual(const Individual *individuals, const unsigned n_individuals) {
-    const unsigned index = uniform() * n_individuals;
-
-    return individuals[index];
+static unsigned select_individual_with_replacement(const Individual *individuals, const unsigned n_individuals, const unsigned char size, Random *const rng) {
+    return graded_tournament_selection(&(individuals[0].fitness), &(individuals[0].fidelity), sizeof(Individual), n_individuals, size, rng);
 }
 
-/* Select the best individual from a tournament of `size` random individuals
- * from the population.
+/* Forget the parents of the individuals `first` to `last` of `lineage`, if
+ * tracing.
  */
-static Individual tournament_selection(const Individual *individuals, const unsigned n_individuals, const unsigned char size) {
-    Individual best = select_random_individual(individuals, n_individuals);
-
-    for(unsigned char iter = 1; iter < size; iter++) {
-        Individual tmp = select_random_individual(individuals, n_individuals);
-
-        if(tmp.fitness < best.fitness) {
-            best = tmp;
+static void clear_lineage(Lineage *const lineage, const unsigned first, const unsigned last) {
+    if(lineage != NULL) {
+        for(unsigned iter = first; iter < last; iter++) {
+            lineage[iter] = (Lineage) { .parent = { LINEAGE_NONE, LINEAGE_NONE } };
         }
     }
+}
 
-    return best;
+/* Append the current population to the trace, if any.
+ */
+static void trace_population(const GeneticAlgorithm *const ga) {
+    if(ga->config.trace != NULL) {
+        trace_record(ga->config.trace, ga->generation, &(ga->individuals[0].genotype), &(ga->individuals[0].fitness),
+                &(ga->individuals[0].fidelity), sizeof(Individual), ga->lineage);
+    }
 }
 
-/* Returns a random individual from the population.
+/* Randomly mutate bits of a genotype of an individual.
  */
-static Individual select_individual_with_replacement(const Individual *individuals, const unsigned n_individuals) {
-    return tournament_selection(individuals, n_individuals, 10);
+static void mutate_individual(Individual *const individual, const double prob, Random *const rng) {
+    mutate_genotype(&(individual->genotype), prob, rng);
 }
 
-/* Mix and match  genotypes of two individuals to form two children genotypes.
+/* Record the individuals of `ga` evaluated at full accuracy in its archive,
+ * if any.
  */
-static void individual_crossover(const Individual p1, const Individual p2, Individual *const c1, Individual *const c2) {
-    genotype_crossover(p1.genotype, p2.genotype, &(c1->genotype), &(c2->genotype));
+static void archive_individuals(const GeneticAlgorithm *const ga, const Individual *const individuals, const unsigned n_individuals) {
+    Archive *const archive = ga->config.archive;
+    if(archive == NULL) {
+        return;
+    }
+
+    for(unsigned iter = 0; iter < n_individuals; iter++) {
+        if(individuals[iter].fidelity == FIDELITY_HIGH) {
+            archive_insert(archive, &(ga->key), &(individuals[iter].genotype), individuals[iter].fitness);
+        }
+    }
+    archive_flush(archive);
 }
 
-/* Randomly mutate bits of a genotype of an individual.
+/* Round of initial candidates of a run, evaluated by the scheduler.
  */
-static void mutate_individual(Individual *const individual) {
-    mutate_genotype(&(individual->genotype));
+typedef struct {
+    GeneticAlgorithm *ga;
+    const Scheduler *scheduler;
+    Individual *candidates;
+} RunRound;
+
+/* Scheduler task evaluating the `index`-th candidate of a round.
+ */
+static void candidate_task(const unsigned index, void *const data) {
+    const RunRound *const round = (RunRound *) data;
+
+    genetic_algorithm_evaluate(round->ga, round->candidates + index);
 }
 
-/* Generate random individual with valid fitness.
+/* Evaluate a round of initial candidates of a run, in parallel.
  */
-static Individual get_random_individual() {
-    Genotype g = get_random_genotype();
-    double fitness = get_genotype_fitness(g);
+static void evaluate_run_round(Individual *const candidates, const unsigned n, void *const data) {
+    RunRound *const round = (RunRound *) data;
 
-    while(fitness == DBL_MAX) {
-        g = get_random_genotype();
-        fitness = get_genotype_fitness(g);
+    round->candidates = candidates;
+    scheduler_run(round->scheduler, n, candidate_task, round);
+}
+
+int genetic_algorithm_alloc(GeneticAlgorithm *const ga, const GeneticAlgorithmConfig *const config, const long seed) {
+    const unsigned n_individuals = config->n_individuals;
+    ga->individuals = (Individual *) malloc(sizeof(Individual) * n_individuals);
+    ga->new_individuals = (Individual *) malloc(sizeof(Individual) * n_individuals);
+    ga->mating = (Genotype *) malloc(sizeof(Genotype) * 5 * ((n_individuals + 1) / 2));
+    ga->ranking = config->screening > 0.0 ? (ScreeningRank *) malloc(sizeof(ScreeningRank) * n_individuals) : NULL;
+    ga->n_confirmed = 0;
+    ga->n_audited = 0;
+    ga->screening = (ScreeningStats) { .evaluations = { 0 }, .audited = 0, .misranked = 0 };
+    for(unsigned fidelity = 0; fidelity < FIDELITIES; fidelity++) {
+        atomic_init(ga->integrations + fidelity, 0);
+    }
+    ga->survivors = config->survivors == SURVIVORS_PLUS || config->survivors == SURVIVORS_ELITISM ? survivor_scratch_alloc(n_individuals) : NULL;
+    ga->lineage = config->trace != NULL ? (Lineage *) malloc(sizeof(Lineage) * n_individuals) : NULL;
+    ga->new_lineage = config->trace != NULL ? (Lineage *) malloc(sizeof(Lineage) * n_individuals) : NULL;
+    ga->measure = diversity_scratch_alloc(n_individuals);
+    if(ga->individuals == NULL || ga->new_individuals == NULL || ga->mating == NULL || ga->measure == NULL
+            || (config->screening > 0.0 && ga->ranking == NULL)
+            || ((config->survivors == SURVIVORS_PLUS || config->survivors == SURVIVORS_ELITISM) && ga->survivors == NULL)
+            || (config->trace != NULL && (ga->lineage == NULL || ga->new_lineage == NULL))) {
+        genetic_algorithm_free(ga);
+        return 1;
     }
+    clear_lineage(ga->lineage, 0, n_individuals);
+    ga->config = *config;
+    ga->key = config->archive != NULL ? archive_key(config->dataset, config->encoding, config->integrator, config->controller, config->event_location) : (ArchiveKey) { .dataset = 0, .settings = 0 };
+    ga->n_individuals = n_individuals;
+    ga->generation = 0;
+    ga->mutation = config->mutation;
+    ga->seed = seed;
+    random_seed(&(ga->rng), seed);
 
-    return (Individual) {
-        .genotype = g,
-        .fitness = fitness,
-    };
+    for(unsigned iter = 0; iter < n_individuals; iter++) {
+        ga->individuals[iter].genotype = get_random_genotype(&(ga->rng));
+        ga->individuals[iter].fitness = DBL_MAX;
+        ga->individuals[iter].fidelity = FIDELITY_HIGH;
+    }
+    ga->best = ga->individuals[0];
+
+    return 0;
 }
 
-Individual run_genetic_algorithm(const unsigned n_individuals) {
-    Individual *individuals = (Individual *) malloc(sizeof(Individual) * n_individuals);;
-    Individual *new_individuals = (Individual *) malloc(sizeof(Individual) * n_individuals);;
+int genetic_algorithm_init(GeneticAlgorithm *const ga, const GeneticAlgorithmConfig *const config, const long seed, const Scheduler *const scheduler) {
+    unsigned long drawn;
 
-    for(unsigned iter = 0; iter < n_individuals; iter++) {
-        individuals[iter] = get_random_individual();
+    if(genetic_algorithm_alloc(ga, config, seed) != 0) {
+        return 1;
     }
-    Individual best = individuals[0];
-    best.fitness = DBL_MAX;
+    return genetic_algorithm_populate(ga, scheduler, &drawn);
+}
 
-    const unsigned n_generations = 1000;
-    for(unsigned generation = 0; generation < n_generations; generation++) {
-        for(unsigned iter = 0; iter < n_individuals; iter++) {
-            if(individuals[iter].fitness < best.fitness) {
-                best = individuals[iter];
-            }
+int genetic_algorithm_populate(GeneticAlgorithm *const ga, const Scheduler *const scheduler, unsigned long *const drawn) {
+    const GeneticAlgorithmConfig *const config = &(ga->config);
+    unsigned n_seeded = 0;
+    if(config->archive != NULL && config->warm_start > 0.0) {
+        const double wanted = ceil(config->warm_start * ga->n_individuals);
+        const unsigned n = wanted < ga->n_individuals ? (unsigned) wanted : ga->n_individuals;
+        Genotype *const genotypes = (Genotype *) malloc(sizeof(Genotype) * n);
+        double *const fitness = (double *) malloc(sizeof(double) * n);
+        if(genotypes == NULL || fitness == NULL) {
+            free(genotypes);
+            free(fitness);
+            genetic_algorithm_free(ga);
+            *drawn = 0;
+            return 1;
         }
 
-        if(generation % 100 == 0) {
-            printf("Generation %u\n", generation);
-            printf("Best fitness so far: %lf (%lf)\n", best.fitness, sqrt(best.fitness));
-            Phenotype p = genoype_to_phenotype(best.genotype);
-            printf("\tphi: %f\n\tlambda: %f\n\tmu: %f\n\tsigma: %f\n\tdelta: %f\n",
-                    p.phi, p.lambda, p.mu, p.sigma, p.delta);
+        n_seeded = archive_best(config->archive, &(ga->key), genotypes, fitness, n);
+        for(unsigned iter = 0; iter < n_seeded; iter++) {
+            ga->individuals[iter] = (Individual) { .genotype = genotypes[iter], .fitness = fitness[iter], .fidelity = FIDELITY_HIGH };
         }
+        free(genotypes);
+        free(fitness);
+    }
 
-        for(unsigned iter = 0; iter < (n_individuals - 1) / 2; iter++) {
-            Individual p1 = select_individual_with_replacement(individuals, n_individuals);
-            Individual p2 = select_individual_with_replacement(individuals, n_individuals);
-            Individual c1, c2;
+    RunRound round = { .ga = ga, .scheduler = scheduler, .candidates = NULL };
+    *drawn = initialize_population_with(ga->individuals + n_seeded, ga->n_individuals - n_seeded, config, &(ga->rng), evaluate_run_round, &round);
+    if(*drawn == 0 && n_seeded < ga->n_individuals) {
+        genetic_algorithm_free(ga);
+        return 1;
+    }
+    archive_individuals(ga, ga->individuals + n_seeded, ga->n_individuals - n_seeded);
+    ga->best = ga->individuals[0];
+    ga->best.fitness = DBL_MAX;
+
+    return 0;
+}
 
-            individual_crossover(p1, p2, &c1, &c2);
-            mutate_individual(&c1);
-            mutate_individual(&c2);
+void genetic_algorithm_free(GeneticAlgorithm *const ga) {
+    free(ga->individuals);
+    free(ga->new_individuals);
+    free(ga->mating);
+    free(ga->ranking);
+    survivor_scratch_free(ga->survivors);
+    free(ga->lineage);
+    free(ga->new_lineage);
+    diversity_scratch_free(ga->measure);
+    ga->individuals = NULL;
+    ga->new_individuals = NULL;
+    ga->mating = NULL;
+    ga->ranking = NULL;
+    ga->survivors = NULL;
+    ga->lineage = NULL;
+    ga->new_lineage = NULL;
+    ga->measure = NULL;
+}
 
-            new_individuals[2 * iter] = c1;
-            new_individuals[(2 * iter) + 1] = c2;
+void genetic_algorithm_update_best(GeneticAlgorithm *const ga) {
+    for(unsigned iter = 0; iter < ga->n_individuals; iter++) {
+        if(ga->individuals[iter].fidelity == FIDELITY_HIGH && ga->individuals[iter].fitness < ga->best.fitness) {
+            ga->best = ga->individuals[iter];
         }
+    }
+}
+
+int genetic_algorithm_update_diversity(GeneticAlgorithm *const ga) {
+    measure_diversity(&(ga->individuals[0].genotype), sizeof(Individual), ga->n_individuals, ga->config.encoding,
+            (unsigned long) ga->seed * 0x9E3779B97F4A7C15UL + ga->generation, ga->measure, &(ga->diversity));
+
+    if(ga->diversity.mean_hamming >= ga->config.diversity_threshold) {
+        ga->mutation = ga->config.mutation;
+        return 0;
+    }
+
+    /* Flip more bits every generation the diversity stays low */
+    if(ga->config.diversity_trigger == DIVERSITY_MUTATION) {
+        ga->mutation = fmax(0.5 * ga->mutation, DIVERSITY_MUTATION_FLOOR * ga->config.mutation);
+        return 0;
+    }
+
+    ga->individuals[0] = ga->best;
+    for(unsigned iter = 1; iter < ga->n_individuals; iter++) {
+        ga->individuals[iter].genotype = get_random_genotype(&(ga->rng));
+        ga->individuals[iter].fidelity = FIDELITY_HIGH;
+    }
+    clear_lineage(ga->lineage, 0, ga->n_individuals);
+    return 1;
+}
+
+void genetic_algorithm_breed(GeneticAlgorithm *const ga) {
+    const unsigned n_individuals = ga->n_individuals;
+    const int generational = ga->config.survivors == SURVIVORS_GENERATIONAL;
+    /* Leave room for the two copies of the best individual if generational */
+    const unsigned n_pairs = generational ? (n_individuals - 1) / 2 : (n_individuals + 1) / 2;
+    const unsigned char tournament = (unsigned char) ga->config.tournament_size;
+    Genotype *const p1 = ga->mating;
+    Genotype *const p2 = p1 + n_pairs;
+    Genotype *const masks = p2 + n_pairs;
+    Genotype *const c1 = masks + n_pairs;
+    Genotype *const c2 = c1 + n_pairs;
 
-        new_individuals[n_individuals - 2] = best;
-        new_individuals[n_individuals - 1] = best;
+    perf_begin(REGION_SELECTION);
+    for(unsigned iter = 0; iter < n_pairs; iter++) {
+        const unsigned first = select_individual_with_replacement(ga->individuals, n_individuals, tournament, &(ga->rng));
+        const unsigned second = select_individual_with_replacement(ga->individuals, n_individuals, tournament, &(ga->rng));
+        p1[iter] = ga->individuals[first].genotype;
+        p2[iter] = ga->individuals[second].genotype;
 
-#pragma omp parallel default (none) shared (new_individuals) firstprivate (n_individuals) num_threads (8)
-        {
-#pragma omp for
-            for(unsigned iter = 0; iter < n_individuals; iter++) {
-                new_individuals[iter].fitness = get_genotype_fitness(new_individuals[iter].genotype);
+        if(ga->new_lineage != NULL) {
+            const Lineage lineage = { .parent = { first, second } };
+            ga->new_lineage[2 * iter] = lineage;
+            if((2 * iter) + 1 < n_individuals) {
+                ga->new_lineage[(2 * iter) + 1] = lineage;
             }
         }
+    }
+    perf_end(REGION_SELECTION);
+
+    perf_begin(REGION_BREEDING);
+    for(unsigned iter = 0; iter < n_pairs; iter++) {
+        masks[iter] = get_crossover_mask(ga->config.crossover, &(ga->rng));
+    }
+
+    genotype_crossover_batch(p1, p2, masks, c1, c2, n_pairs);
+
+    const Fidelity fidelity = ga->config.screening > 0.0 ? FIDELITY_LOW : FIDELITY_HIGH;
+    for(unsigned iter = 0; iter < n_pairs; iter++) {
+        ga->new_individuals[2 * iter].genotype = c1[iter];
+        ga->new_individuals[2 * iter].fidelity = fidelity;
+        mutate_individual(ga->new_individuals + 2 * iter, ga->mutation, &(ga->rng));
+        if((2 * iter) + 1 < n_individuals) {
+            ga->new_individuals[(2 * iter) + 1].genotype = c2[iter];
+            ga->new_individuals[(2 * iter) + 1].fidelity = fidelity;
+            mutate_individual(ga->new_individuals + (2 * iter) + 1, ga->mutation, &(ga->rng));
+        }
+    }
+    perf_end(REGION_BREEDING);
+
+    if(generational) {
+        ga->new_individuals[n_individuals - 2] = ga->best;
+        ga->new_individuals[n_individuals - 1] = ga->best;
+        clear_lineage(ga->new_lineage, n_individuals - 2, n_individuals);
+    }
+}
+
+static int compare_ranks(const void *a, const void *b) {
+    const double x = ((const ScreeningRank *) a)->fitness;
+    const double y = ((const ScreeningRank *) b)->fitness;
 
-        Individual *tmp = individuals;
-        individuals = new_individuals;
-        new_individuals = tmp;
+    return (x > y) - (x < y);
+}
+
+unsigned genetic_algorithm_screen(GeneticAlgorithm *const ga, Individual **const confirm) {
+    if(ga->config.screening <= 0.0) {
+        return 0;
+    }
+
+    unsigned n_screened = 0;
+    for(unsigned iter = 0; iter < ga->n_individuals; iter++) {
+        if(ga->new_individuals[iter].fidelity == FIDELITY_LOW) {
+            ga->ranking[n_screened++] = (ScreeningRank) {
+                .fitness = ga->new_individuals[iter].fitness,
+                .index = iter,
+            };
+        }
+    }
+    qsort(ga->ranking, n_screened, sizeof(ScreeningRank), compare_ranks);
+
+    unsigned n_confirmed = (unsigned) ceil(ga->config.screening * n_screened);
+    n_confirmed = n_confirmed < n_screened ? n_confirmed : n_screened;
+
+    /* Move random rejected children right after the confirmed ones */
+    unsigned n_audited = 0;
+    while(n_audited < SCREENING_AUDITS && n_confirmed + n_audited < n_screened) {
+        const unsigned first = n_confirmed + n_audited;
+        const unsigned pick = first + select_random_index(n_screened - first, &(ga->rng));
+        const ScreeningRank tmp = ga->ranking[first];
+
+        ga->ranking[first] = ga->ranking[pick];
+        ga->ranking[pick] = tmp;
+        n_audited++;
+    }
+
+    for(unsigned iter = 0; iter < n_confirmed + n_audited; iter++) {
+        confirm[iter] = ga->new_individuals + ga->ranking[iter].index;
+        confirm[iter]->fidelity = FIDELITY_HIGH;
+    }
+
+    ga->n_confirmed = n_confirmed;
+    ga->n_audited = n_audited;
+    ga->screening.evaluations[FIDELITY_LOW] += n_screened;
+    ga->screening.evaluations[FIDELITY_HIGH] += n_confirmed + n_audited;
+
+    return n_confirmed + n_audited;
+}
+
+/* Count the audited children that the screening should have confirmed.
+ */
+static void audit_screening(GeneticAlgorithm *const ga) {
+    double worst = -DBL_MAX;
+    for(unsigned iter = 0; iter < ga->n_confirmed; iter++) {
+        const double fitness = ga->new_individuals[ga->ranking[iter].index].fitness;
+        worst = fitness > worst ? fitness : worst;
+    }
+
+    for(unsigned iter = ga->n_confirmed; iter < ga->n_confirmed + ga->n_audited; iter++) {
+        if(ga->new_individuals[ga->ranking[iter].index].fitness < worst) {
+            ga->screening.misranked++;
+        }
+    }
+    ga->screening.audited += ga->n_audited;
+
+    ga->n_confirmed = 0;
+    ga->n_audited = 0;
+}
+
+void genetic_algorithm_replace(GeneticAlgorithm *const ga, const Scheduler *const scheduler) {
+    if(ga->n_confirmed + ga->n_audited > 0) {
+        audit_screening(ga);
+    }
+
+    archive_individuals(ga, ga->new_individuals, ga->n_individuals);
+    trace_population(ga);
+    if(ga->survivors != NULL) {
+        select_survivors(ga, scheduler);
+    }
+
+    Individual *tmp = ga->individuals;
+    ga->individuals = ga->new_individuals;
+    ga->new_individuals = tmp;
+    Lineage *lineage = ga->lineage;
+    ga->lineage = ga->new_lineage;
+    ga->new_lineage = lineage;
+    ga->generation++;
+
+    if(ga->generation == ga->config.n_generations) {
+        trace_population(ga);
+    }
+}
+
+unsigned long genetic_algorithm_evaluations(const GeneticAlgorithm *const ga) {
+    return atomic_load(ga->integrations + FIDELITY_LOW) + atomic_load(ga->integrations + FIDELITY_HIGH);
+}
+
+int evaluate_individual(Individual *const individual, const GeneticAlgorithmConfig *const config, const ArchiveKey *const key) {
+    if(config->archive != NULL && individual->fidelity == FIDELITY_HIGH) {
+        if(archive_lookup(config->archive, key, &(individual->genotype), &(individual->fitness))) {
+            return 0;
+        }
+    }
+
+    perf_begin(REGION_FITNESS);
+    individual->fitness = get_genotype_fitness(individual->genotype, config->encoding, config->dataset, config->integrator, config->controller, config->event_location, individual->fidelity);
+    perf_end(REGION_FITNESS);
+    return 1;
+}
+
+void genetic_algorithm_evaluate(GeneticAlgorithm *const ga, Individual *const individual) {
+    if(evaluate_individual(individual, &(ga->config), &(ga->key))) {
+        atomic_fetch_add_explicit(ga->integrations + individual->fidelity, 1, memory_order_relaxed);
+    }
+}
+
+/* Report the progress of the run every 100 generations, its diversity every
+ * generation to the stream in `data`, if any, and publish its metrics.
+ */
+static int report_task(const GAProgress *const progress, void *const data) {
+    FILE *const stats = (FILE *) data;
+
+    if(stats != NULL) {
+        report_diversity(stats, progress->generation, progress->fitness, progress->diversity);
+    }
+    metrics_update(progress->generation, progress->fitness, &(progress->best));
+
+    if(progress->generation % 100 == 0) {
+        report_progress(progress->generation, progress->fitness, &(progress->best));
+        printf("Diversity: %f mean Hamming distance, %u unique genotypes, %u fixed bits\n",
+                progress->diversity->mean_hamming, progress->diversity->unique, progress->diversity->fixed_bits);
+    }
+
+    return 0;
+}
+
+Individual run_genetic_algorithm(const GeneticAlgorithmConfig *const config, const long seed, const Scheduler *const scheduler, FILE *const stats) {
+    GAConfig library;
+    ga_config_default(&library);
+    library.algorithm = *config;
+    library.n_threads = scheduler->n_threads;
+    library.seed = seed;
+    library.progress = report_task;
+    library.progress_data = stats;
+
+    GAContext *context = ga_create(&library);
+    if(context == NULL) {
+        fprintf(stderr, "Could not allocate the population\n");
+        return (Individual) { .fitness = DBL_MAX, .fidelity = FIDELITY_HIGH };
+    }
+    ga_run(context);
+    if(config->screening > 0.0) {
+        report_screening(stdout, ga_screening(context));
     }
 
-    free(individuals);
-    free(new_individuals);
+    const Individual best = ga_best(context);
+    ga_destroy(context);
     return best;
 }
@@ -1,11 +1,291 @@
 #pragma once
+#include "archive.h"
+#include "diversity.h"
 #include "genotype.h"
+#include "randombits.h"
+#include "scheduler.h"
+#include "trace.h"
+#include <stdatomic.h>
+#include <stdio.h>
 
 typedef struct {
     Genotype genotype;
     double fitness;
+    /* `Fidelity` of the integration behind `fitness`, so that fitness values
+     * of different accuracy are never compared.
+     */
+    unsigned char fidelity;
 } Individual;
 
+/* Random children rejected by the screening that are confirmed anyway every
+ * generation, to measure how often the screening misranks them.
+ */
+#define SCREENING_AUDITS (2)
+
+/* Cost and accuracy of the screening of the children at low fidelity.
+ */
+typedef struct {
+    /* Evaluations of children performed at each fidelity.
+     */
+    unsigned long evaluations[FIDELITIES];
+    /* Rejected children confirmed to audit the screening, and how many of them
+     * turned out better than the worst child it confirmed.
+     */
+    unsigned long audited;
+    unsigned long misranked;
+} ScreeningStats;
+
+/* Child ranked by its fitness at low fidelity.
+ */
+typedef struct {
+    double fitness;
+    unsigned index;
+} ScreeningRank;
+
+/* Smallest fraction of the configured mutation parameter that
+ * `DIVERSITY_MUTATION` halves it down to.
+ */
+#define DIVERSITY_MUTATION_FLOOR (1.0 / 64)
+
+/* Reaction of a run to the loss of diversity of its population.
+ */
+typedef enum {
+    /* Replace every individual but the best one by a random one.
+     */
+    DIVERSITY_RESTART,
+    /* Halve the mutation parameter, flipping more bits, every generation
+     * until the diversity recovers.
+     */
+    DIVERSITY_MUTATION,
+} DiversityTrigger;
+
+/* Sampling of the genotypes of the initial population.
+ */
+typedef enum {
+    /* Independent uniform genotypes.
+     */
+    INITIALIZATION_RANDOM,
+    /* Randomly shifted Sobol sequence.
+     */
+    INITIALIZATION_SOBOL,
+    /* Latin hypercube.
+     */
+    INITIALIZATION_LATIN,
+} Initialization;
+
+/* Survivors of every generation, among the parents and their children.
+ */
+typedef enum {
+    /* The children replace the parents, but for two of them replaced by
+     * copies of the best individual found so far.
+     */
+    SURVIVORS_GENERATIONAL,
+    /* (μ+λ): the best distinct individuals among parents and children.
+     */
+    SURVIVORS_PLUS,
+    /* The `n_elite` best distinct parents and the best distinct children.
+     */
+    SURVIVORS_ELITISM,
+} Survivors;
+
+/* Scratch space of the selection of the survivors among parents and
+ * children.
+ */
+typedef struct SurvivorScratch SurvivorScratch;
+
+/* Parameters of a run of the genetic algorithm.
+ */
+typedef struct {
+    unsigned n_individuals;
+    unsigned n_generations;
+    /* Observations to fit.
+     */
+    const Dataset *dataset;
+    Encoding encoding;
+    Crossover crossover;
+    /* Individuals of the tournaments choosing the parents.
+     */
+    unsigned tournament_size;
+    /* Parameter `prob` of `mutate_genotype`.
+     */
+    double mutation;
+    /* Relative mean Hamming distance below which `diversity_trigger` fires,
+     * or `0` to never react.
+     */
+    double diversity_threshold;
+    DiversityTrigger diversity_trigger;
+    Initialization initialization;
+    Survivors survivors;
+    /* Parents kept by `SURVIVORS_ELITISM`.
+     */
+    unsigned n_elite;
+    IntegratorMethod integrator;
+    StepController controller;
+    /* Whether the integrations locate the crossings of `x = delta`, cutting
+     * the steps at them.
+     */
+    int event_location;
+    /* Fraction of the children confirmed at full accuracy after screening all
+     * of them at low fidelity, or `0` to evaluate every child at full
+     * accuracy.
+     */
+    double screening;
+    /* Evaluations shared with earlier runs and other processes, reused
+     * instead of integrating the model again and extended with every new
+     * evaluation at full accuracy, or `NULL`.
+     */
+    Archive *archive;
+    /* Fraction of the initial population seeded from the best distinct
+     * genotypes of `archive`.
+     */
+    double warm_start;
+    /* History of the populations of the run and their lineages, or `NULL`.
+     */
+    Trace *trace;
+} GeneticAlgorithmConfig;
+
+/* State of a single run of the genetic algorithm.
+ *
+ * The run is split into steps (breeding, evaluation and replacement) so that
+ * drivers running several instances at once can interleave them, evaluating
+ * the children of every run in a single batch.
+ */
+typedef struct {
+    Individual *individuals;
+    Individual *new_individuals;
+    /* Scratch space for the parents, crossover masks and children of a
+     * generation, laid out contiguously for the batched crossover.
+     */
+    Genotype *mating;
+    GeneticAlgorithmConfig config;
+    /* Key of the fitness values of the run in the archive, if any, computed
+     * once from its dataset and settings.
+     */
+    ArchiveKey key;
+    unsigned n_individuals;
+    unsigned generation;
+    Individual best;
+    /* Mutation parameter in use, which may differ from the configured one
+     * while reacting to a loss of diversity.
+     */
+    double mutation;
+    Diversity diversity;
+    /* Scratch space of the measurement of `diversity`.
+     */
+    DiversityScratch *measure;
+    /* Children of the generation ranked by their screening, the confirmed
+     * ones first and then the audited ones, when screening.
+     */
+    ScreeningRank *ranking;
+    unsigned n_confirmed;
+    unsigned n_audited;
+    ScreeningStats screening;
+    /* Integrations of the model the run performed at every fidelity, fitness
+     * values reused from the archive excluded, counted by concurrent
+     * evaluations.
+     */
+    atomic_ulong integrations[FIDELITIES];
+    /* Candidates and scratch space of the survivors, when chosen among both
+     * parents and children.
+     */
+    SurvivorScratch *survivors;
+    /* Parents of `individuals` and `new_individuals` when tracing, `NULL`
+     * otherwise.
+     */
+    Lineage *lineage;
+    Lineage *new_lineage;
+    long seed;
+    Random rng;
+} GeneticAlgorithm;
+
+/* Allocate the population of `config->n_individuals` random, unevaluated,
+ * individuals, drawing them from a stream seeded with `seed`.
+ *
+ * Returns `0` on success, and otherwise non-zero after releasing whatever
+ * was allocated.
+ */
+int genetic_algorithm_alloc(GeneticAlgorithm *const ga, const GeneticAlgorithmConfig *const config, const long seed);
+
+/* Allocate the population of `config->n_individuals` individuals with valid
+ * fitness, sampled as `config->initialization` says from a stream seeded with
+ * `seed` and evaluated on `scheduler`, after the `config->warm_start` fraction
+ * of them taken from the archive.
+ *
+ * Returns `0` on success, and otherwise non-zero after releasing whatever
+ * was allocated.
+ */
+int genetic_algorithm_init(GeneticAlgorithm *const ga, const GeneticAlgorithmConfig *const config, const long seed, const Scheduler *const scheduler);
+
+/* Replace the population allocated by `genetic_algorithm_alloc` with one of
+ * valid fitness, as `genetic_algorithm_init` does, storing the number of
+ * candidates evaluated in `drawn`.
+ *
+ * Returns `0` on success, and otherwise non-zero after releasing the run.
+ */
+int genetic_algorithm_populate(GeneticAlgorithm *const ga, const Scheduler *const scheduler, unsigned long *const drawn);
+
+/* Release the population of the run.
+ */
+void genetic_algorithm_free(GeneticAlgorithm *const ga);
+
+/* Keep track of the best individual in the current population.
+ */
+void genetic_algorithm_update_best(GeneticAlgorithm *const ga);
+
+/* Measure the diversity of the current population, and react to its loss as
+ * configured.
+ *
+ * Returns `1` if every individual but the first (the best) was restarted,
+ * and needs to be evaluated again.
+ */
+int genetic_algorithm_update_diversity(GeneticAlgorithm *const ga);
+
+/* Fill `new_individuals` with the (yet unevaluated) children of the current
+ * population, to be evaluated at low fidelity if screening, all of them but
+ * the copies of the best one when `SURVIVORS_GENERATIONAL`.
+ */
+void genetic_algorithm_breed(GeneticAlgorithm *const ga);
+
+/* Pick the children screened at low fidelity that must be confirmed at full
+ * accuracy: the best `config.screening` fraction of them, the only ones
+ * likely to win tournaments or enter the elite, and `SCREENING_AUDITS` random
+ * ones among the rest to audit the screening.
+ *
+ * Stores them in `confirm`, marked for evaluation at full accuracy, and
+ * returns their number, `0` if not screening.
+ */
+unsigned genetic_algorithm_screen(GeneticAlgorithm *const ga, Individual **const confirm);
+
+/* Replace the current population with the survivors among it and the
+ * evaluated children, archiving the children evaluated at full accuracy and
+ * tracing the population replaced, and the last one.
+ *
+ * Survivors chosen among both parents and children are selected in parallel
+ * on `scheduler` for large populations.
+ */
+void genetic_algorithm_replace(GeneticAlgorithm *const ga, const Scheduler *const scheduler);
+
+/* Integrations of the model the run performed so far, at either fidelity,
+ * rejected initial candidates included and fitness values reused from the
+ * archive excluded.
+ */
+unsigned long genetic_algorithm_evaluations(const GeneticAlgorithm *const ga);
+
+/* Compute the fitness of an individual from its genotype, with the accuracy
+ * of its `fidelity`, unless archived under `key` in `config->archive`.
+ *
+ * Returns non-zero if it integrated the model, and `0` if it reused the
+ * archived fitness.
+ */
+int evaluate_individual(Individual *const individual, const GeneticAlgorithmConfig *const config, const ArchiveKey *const key);
+
+/* Evaluate an individual of the run `ga`, counting its integration, from any
+ * thread.
+ */
+void genetic_algorithm_evaluate(GeneticAlgorithm *const ga, Individual *const individual);
+
 /* Main function to run the genetic algorithm, based in [1].
+ *
+ * The diversity of every generation is written to `stats`, unless `NULL`.
  */
-Individual run_genetic_algorithm(const unsigned n_individuals);
+Individual run_genetic_algorithm(const GeneticAlgorithmConfig *const config, const long seed, const Scheduler *const scheduler, FILE *const stats);
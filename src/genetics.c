@@ -0,0 +1,293 @@
+#include "genetics.h"
+#include "equations.h"
+#include "genetic-algorithm.h"
+#include "genotype.h"
+#include "initialization.h"
+#include "scheduler.h"
+#include <float.h>
+#include <stdlib.h>
+
+struct GAContext {
+    GAConfig config;
+    GeneticAlgorithm ga;
+    Scheduler scheduler;
+    /* Decoded phenotypes and fitness values of a batch for the user fitness
+     * function.
+     */
+    Phenotype *phenotypes;
+    double *fitness;
+    /* Children to confirm at full accuracy when screening.
+     */
+    Individual **confirm;
+    unsigned long evaluations;
+    int stopped;
+};
+
+/* Batch of individuals evaluated by the scheduler of a context.
+ */
+typedef struct {
+    GAContext *context;
+    Individual *individuals;
+    /* Addresses of the individuals instead, unless `NULL`.
+     */
+    Individual *const *pointers;
+    unsigned n_individuals;
+} Batch;
+
+void ga_config_default(GAConfig *const config) {
+    *config = (GAConfig) {
+        .algorithm = {
+            .n_individuals = 1000,
+            .n_generations = 1000,
+            .dataset = &default_dataset,
+            .encoding = ENCODING_BINARY,
+            .crossover = CROSSOVER_ONE_POINT,
+            .tournament_size = 10,
+            .mutation = 0.5,
+            .diversity_threshold = 0.0,
+            .diversity_trigger = DIVERSITY_RESTART,
+            .initialization = INITIALIZATION_RANDOM,
+            .survivors = SURVIVORS_GENERATIONAL,
+            .n_elite = 2,
+            .integrator = INTEGRATOR_RKF78,
+            .controller = CONTROLLER_ELEMENTARY,
+            .event_location = 0,
+            .screening = 0.0,
+            .archive = NULL,
+            .warm_start = 0.0,
+            .trace = NULL,
+        },
+        .n_threads = 0,
+        .seed = 1,
+        .fitness = NULL,
+        .fitness_data = NULL,
+        .batch_size = 0,
+        .progress = NULL,
+        .progress_data = NULL,
+    };
+}
+
+/* Scheduler task evaluating the `index`-th individual of a batch with the
+ * model.
+ */
+static void evaluate_task(const unsigned index, void *const data) {
+    const Batch *const batch = (Batch *) data;
+    Individual *const individual = batch->pointers != NULL ? batch->pointers[index] : batch->individuals + index;
+
+    genetic_algorithm_evaluate(&(batch->context->ga), individual);
+}
+
+/* Scheduler task evaluating the `index`-th chunk of a batch with the user
+ * fitness function.
+ */
+static void callback_task(const unsigned index, void *const data) {
+    const Batch *const batch = (Batch *) data;
+    const GAConfig *const config = &(batch->context->config);
+    const unsigned first = index * config->batch_size;
+    const unsigned length = first + config->batch_size < batch->n_individuals ? config->batch_size : batch->n_individuals - first;
+
+    config->fitness(batch->context->phenotypes + first, batch->context->fitness + first, length, config->fitness_data);
+}
+
+/* Evaluate `n_individuals` individuals with the fitness of the context.
+ */
+static void evaluate_batch(GAContext *const context, Individual *const individuals, const unsigned n_individuals) {
+    Batch batch = {
+        .context = context,
+        .individuals = individuals,
+        .pointers = NULL,
+        .n_individuals = n_individuals,
+    };
+    context->evaluations += n_individuals;
+
+    if(context->config.fitness == NULL) {
+        scheduler_run(&(context->scheduler), n_individuals, evaluate_task, &batch);
+        return;
+    }
+
+    for(unsigned iter = 0; iter < n_individuals; iter++) {
+        context->phenotypes[iter] = genoype_to_phenotype(individuals[iter].genotype, context->ga.config.encoding);
+    }
+
+    if(context->config.batch_size == 0) {
+        context->config.fitness(context->phenotypes, context->fitness, n_individuals, context->config.fitness_data);
+    } else {
+        const unsigned n_chunks = (n_individuals + context->config.batch_size - 1) / context->config.batch_size;
+        scheduler_run(&(context->scheduler), n_chunks, callback_task, &batch);
+    }
+
+    for(unsigned iter = 0; iter < n_individuals; iter++) {
+        individuals[iter].fitness = context->fitness[iter];
+    }
+}
+
+/* Confirm at full accuracy the children the screening picked, if any.
+ */
+static void confirm_batch(GAContext *const context) {
+    Batch batch = {
+        .context = context,
+        .individuals = NULL,
+        .pointers = context->confirm,
+        .n_individuals = genetic_algorithm_screen(&(context->ga), context->confirm),
+    };
+    context->evaluations += batch.n_individuals;
+
+    scheduler_run(&(context->scheduler), batch.n_individuals, evaluate_task, &batch);
+}
+
+/* Evaluate a round of initial candidates with the user fitness function, at
+ * most a population at a time.
+ */
+static void evaluate_round(Individual *const candidates, const unsigned n, void *const data) {
+    GAContext *const context = (GAContext *) data;
+
+    for(unsigned first = 0; first < n; first += context->ga.n_individuals) {
+        const unsigned length = n - first < context->ga.n_individuals ? n - first : context->ga.n_individuals;
+        evaluate_batch(context, candidates + first, length);
+    }
+}
+
+GAContext *ga_create(const GAConfig *const config) {
+    const GeneticAlgorithmConfig *const algorithm = &(config->algorithm);
+    const unsigned n_individuals = algorithm->n_individuals;
+    if(n_individuals < 3 || algorithm->dataset == NULL || algorithm->dataset->length > DATASET_MAX_LENGTH
+            || algorithm->tournament_size < 1 || algorithm->tournament_size > 255
+            || !(algorithm->screening >= 0.0 && algorithm->screening <= 1.0)
+            || algorithm->n_elite >= n_individuals) {
+        return NULL;
+    }
+
+    GAContext *context = (GAContext *) malloc(sizeof(GAContext));
+    if(context == NULL) {
+        return NULL;
+    }
+    context->config = *config;
+    context->evaluations = 0;
+    context->stopped = 0;
+    context->phenotypes = NULL;
+    context->fitness = NULL;
+    context->confirm = NULL;
+
+    if(config->fitness == NULL) {
+        if(config->algorithm.screening > 0.0) {
+            context->confirm = (Individual **) malloc(sizeof(Individual *) * n_individuals);
+        }
+    } else {
+        /* The user fitness function has a single accuracy, and nothing to
+         * archive its values by */
+        context->config.algorithm.screening = 0.0;
+        context->config.algorithm.archive = NULL;
+        context->phenotypes = (Phenotype *) malloc(sizeof(Phenotype) * n_individuals);
+        context->fitness = (double *) malloc(sizeof(double) * n_individuals);
+    }
+
+    if((context->config.algorithm.screening > 0.0 && context->confirm == NULL)
+            || (config->fitness != NULL && (context->phenotypes == NULL || context->fitness == NULL))
+            || genetic_algorithm_alloc(&(context->ga), &(context->config.algorithm), config->seed) != 0) {
+        free(context->phenotypes);
+        free(context->fitness);
+        free(context->confirm);
+        free(context);
+        return NULL;
+    }
+    scheduler_init(&(context->scheduler), config->n_threads);
+
+    int err = 0;
+    if(config->fitness == NULL) {
+        unsigned long drawn;
+        err = genetic_algorithm_populate(&(context->ga), &(context->scheduler), &drawn);
+        context->evaluations += drawn;
+    } else {
+        /* The same initialisation as the model, invalid candidates included */
+        GeneticAlgorithm *const ga = &(context->ga);
+        if(initialize_population_with(ga->individuals, ga->n_individuals, &(ga->config), &(ga->rng), evaluate_round, context) == 0) {
+            genetic_algorithm_free(ga);
+            err = 1;
+        } else {
+            ga->best = ga->individuals[0];
+            ga->best.fitness = DBL_MAX;
+        }
+    }
+
+    if(err != 0) {
+        free(context->phenotypes);
+        free(context->fitness);
+        free(context->confirm);
+        free(context);
+        return NULL;
+    }
+
+    return context;
+}
+
+int ga_step(GAContext *const context) {
+    GeneticAlgorithm *const ga = &(context->ga);
+
+    if(context->stopped || ga->generation >= ga->config.n_generations) {
+        return 1;
+    }
+
+    genetic_algorithm_update_best(ga);
+    if(genetic_algorithm_update_diversity(ga)) {
+        evaluate_batch(context, ga->individuals + 1, ga->n_individuals - 1);
+    }
+
+    if(context->config.progress != NULL) {
+        const GAProgress progress = {
+            .generation = ga->generation,
+            .evaluations = context->evaluations,
+            .fitness = ga->best.fitness,
+            .best = genoype_to_phenotype(ga->best.genotype, ga->config.encoding),
+            .diversity = &(ga->diversity),
+        };
+
+        if(context->config.progress(&progress, context->config.progress_data) != 0) {
+            context->stopped = 1;
+            return 1;
+        }
+    }
+
+    genetic_algorithm_breed(ga);
+    evaluate_batch(context, ga->new_individuals, ga->n_individuals);
+    if(context->confirm != NULL) {
+        confirm_batch(context);
+    }
+    genetic_algorithm_replace(ga, &(context->scheduler));
+    genetic_algorithm_update_best(ga);
+
+    return ga->generation >= ga->config.n_generations;
+}
+
+int ga_run(GAContext *const context) {
+    while(ga_step(context) == 0);
+
+    return context->stopped;
+}
+
+Individual ga_best(const GAContext *const context) {
+    return context->ga.best;
+}
+
+Phenotype ga_best_phenotype(const GAContext *const context) {
+    return genoype_to_phenotype(context->ga.best.genotype, context->ga.config.encoding);
+}
+
+unsigned ga_generation(const GAContext *const context) {
+    return context->ga.generation;
+}
+
+unsigned long ga_evaluations(const GAContext *const context) {
+    return context->evaluations;
+}
+
+const ScreeningStats *ga_screening(const GAContext *const context) {
+    return &(context->ga.screening);
+}
+
+void ga_destroy(GAContext *const context) {
+    genetic_algorithm_free(&(context->ga));
+    free(context->phenotypes);
+    free(context->fitness);
+    free(context->confirm);
+    free(context);
+}
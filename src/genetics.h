@@ -0,0 +1,106 @@
+#pragma once
+#include "diversity.h"
+#include "equations.h"
+#include "genetic-algorithm.h"
+
+/* Library interface of the genetic algorithm.
+ *
+ * Every fit lives in its own `GAContext`, holding its population, random
+ * stream and evaluation scheduler, so that several fits can run at once from
+ * different threads of a process. The contexts still share the state global
+ * to the process: the genotype layout, which must not change while any of
+ * them runs, and the integration statistics, hardware counters and metrics
+ * page, which add up all of them.
+ */
+
+/* Compute the `n` fitness values of `phenotypes`, the lower the better, with
+ * `DBL_MAX` marking an invalid phenotype.
+ *
+ * When evaluating in chunks the function is called concurrently from the
+ * threads of the scheduler, and must be thread safe.
+ */
+typedef void (*FitnessCallback)(const Phenotype *const phenotypes, double *const fitness, const unsigned n, void *const data);
+
+/* State of a fit reported after every generation.
+ */
+typedef struct {
+    unsigned generation;
+    unsigned long evaluations;
+    double fitness;
+    Phenotype best;
+    const Diversity *diversity;
+} GAProgress;
+
+/* Called after every generation; returning non-zero stops the fit.
+ */
+typedef int (*ProgressCallback)(const GAProgress *const progress, void *const data);
+
+typedef struct {
+    GeneticAlgorithmConfig algorithm;
+    /* Threads evaluating the fitness, or `0` for as many as OpenMP allows.
+     */
+    unsigned n_threads;
+    long seed;
+    /* Fitness of a batch of phenotypes, or `NULL` to fit the model to
+     * `algorithm.dataset`.
+     */
+    FitnessCallback fitness;
+    void *fitness_data;
+    /* Phenotypes per call of `fitness`, spread over the threads of the
+     * context, or `0` to pass the whole generation in a single call made
+     * from the calling thread.
+     */
+    unsigned batch_size;
+    ProgressCallback progress;
+    void *progress_data;
+} GAConfig;
+
+typedef struct GAContext GAContext;
+
+/* Fill `config` with the default parameters of the algorithm.
+ */
+void ga_config_default(GAConfig *const config);
+
+/* Create a context for a fit with parameters `config`, evaluating its initial
+ * population.
+ *
+ * Returns `NULL` if the population has fewer than 3 individuals, the dataset
+ * is missing or longer than `DATASET_MAX_LENGTH`, the tournaments have not 1
+ * to 255 individuals, the screening fraction is outside [0, 1], the elite is
+ * not smaller than the population, or memory runs out.
+ */
+GAContext *ga_create(const GAConfig *const config);
+
+/* Advance the fit one generation.
+ *
+ * Returns `0` while the fit can go on, and non-zero once it has run all of
+ * its generations or was stopped by the progress callback.
+ */
+int ga_step(GAContext *const context);
+
+/* Run the fit until it finishes, returning `1` if the progress callback
+ * stopped it and `0` otherwise.
+ */
+int ga_run(GAContext *const context);
+
+/* Best individual found so far, and its parameters.
+ */
+Individual ga_best(const GAContext *const context);
+Phenotype ga_best_phenotype(const GAContext *const context);
+
+/* Number of generations run so far.
+ */
+unsigned ga_generation(const GAContext *const context);
+
+/* Number of fitness evaluations performed so far.
+ */
+unsigned long ga_evaluations(const GAContext *const context);
+
+/* Cost and accuracy of the screening of the children so far, all zero unless
+ * `config.algorithm.screening` is set.
+ */
+const ScreeningStats *ga_screening(const GAContext *const context);
+
+/* Release the context.
+ */
+void ga_destroy(GAContext *const context);
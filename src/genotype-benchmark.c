@@ -0,0 +1,115 @@
+#include "genotype-benchmark.h"
+#include "genotype.h"
+#include "randombits.h"
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Repetitions of every measurement, keeping the fastest one.
+ */
+#define BENCHMARK_REPETITIONS (5)
+
+/* Operators timed.
+ */
+typedef enum {
+    OPERATOR_RANDOM,
+    OPERATOR_DECODE,
+    OPERATOR_ONE_POINT_MASK,
+    OPERATOR_TWO_POINT_MASK,
+    OPERATOR_UNIFORM_MASK,
+    OPERATOR_CROSSOVER,
+    OPERATOR_MUTATION,
+    OPERATORS,
+} Operator;
+
+static const char *const operator_names[OPERATORS] = {
+    [OPERATOR_RANDOM] = "random",
+    [OPERATOR_DECODE] = "decode",
+    [OPERATOR_ONE_POINT_MASK] = "one_point_mask",
+    [OPERATOR_TWO_POINT_MASK] = "two_point_mask",
+    [OPERATOR_UNIFORM_MASK] = "uniform_mask",
+    [OPERATOR_CROSSOVER] = "crossover_batch",
+    [OPERATOR_MUTATION] = "mutation",
+};
+
+/* Apply `operator` to the `n` genotypes of `g`, using `h` and `masks` as
+ * second parents and masks, and `c1` and `c2` for the children, returning a
+ * value depending on every result so that none is optimised away.
+ */
+static double apply_operator(const Operator operator, Genotype *const g, Genotype *const h, Genotype *const masks, Genotype *const c1, Genotype *const c2, const unsigned n, const Encoding encoding, Random *const rng) {
+    double sink = 0.0;
+
+    switch(operator) {
+        case OPERATOR_RANDOM:
+            for(unsigned iter = 0; iter < n; iter++) {
+                g[iter] = get_random_genotype(rng);
+            }
+            break;
+        case OPERATOR_DECODE:
+            for(unsigned iter = 0; iter < n; iter++) {
+                const Phenotype p = genoype_to_phenotype(g[iter], encoding);
+                sink += p.phi + p.lambda + p.mu + p.sigma + p.delta;
+            }
+            break;
+        case OPERATOR_ONE_POINT_MASK:
+        case OPERATOR_TWO_POINT_MASK:
+        case OPERATOR_UNIFORM_MASK:
+            for(unsigned iter = 0; iter < n; iter++) {
+                masks[iter] = get_crossover_mask((Crossover) (operator - OPERATOR_ONE_POINT_MASK), rng);
+            }
+            break;
+        case OPERATOR_CROSSOVER:
+            genotype_crossover_batch(g, h, masks, c1, c2, n);
+            break;
+        case OPERATOR_MUTATION:
+        default:
+            for(unsigned iter = 0; iter < n; iter++) {
+                mutate_genotype(c1 + iter, 0.5, rng);
+            }
+            break;
+    }
+
+    for(unsigned iter = 0; iter < n; iter += 64) {
+        sink += (double) (g[iter].word[0] ^ masks[iter].word[1] ^ c1[iter].word[0] ^ c2[iter].word[1]);
+    }
+    return sink;
+}
+
+void benchmark_genotype(const unsigned n, const Encoding encoding, const long seed, FILE *const stream) {
+    Genotype *const g = (Genotype *) malloc(sizeof(Genotype) * n);
+    Genotype *const h = (Genotype *) malloc(sizeof(Genotype) * n);
+    Genotype *const masks = (Genotype *) malloc(sizeof(Genotype) * n);
+    Genotype *const c1 = (Genotype *) malloc(sizeof(Genotype) * n);
+    Genotype *const c2 = (Genotype *) malloc(sizeof(Genotype) * n);
+    Random rng;
+    random_seed(&rng, seed);
+
+    for(unsigned iter = 0; iter < n; iter++) {
+        g[iter] = get_random_genotype(&rng);
+        h[iter] = get_random_genotype(&rng);
+        masks[iter] = get_crossover_mask(CROSSOVER_UNIFORM, &rng);
+        c1[iter] = g[iter];
+        c2[iter] = h[iter];
+    }
+
+    fprintf(stream, "operator\tns_per_genotype\n");
+    double sink = 0.0;
+    for(unsigned operator = 0; operator < OPERATORS; operator++) {
+        double best = HUGE_VAL;
+        for(unsigned repetition = 0; repetition < BENCHMARK_REPETITIONS; repetition++) {
+            const double start = omp_get_wtime();
+            sink += apply_operator((Operator) operator, g, h, masks, c1, c2, n, encoding, &rng);
+            const double elapsed = omp_get_wtime() - start;
+            best = elapsed < best ? elapsed : best;
+        }
+        fprintf(stream, "%s\t%.2f\n", operator_names[operator], 1.0e9 * best / n);
+    }
+    fprintf(stream, "Checksum: %g\n", sink);
+
+    free(g);
+    free(h);
+    free(masks);
+    free(c1);
+    free(c2);
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include "genotype.h"
+#include <stdio.h>
+
+/* Time the genetic operators of the binary engine on `n` random genotypes of
+ * the schema in use, decoded with `encoding`, writing to `stream` the
+ * nanoseconds per genotype of random generation, decoding, every crossover
+ * mask, the batched crossover and mutation, the best of a few repetitions.
+ */
+void benchmark_genotype(const unsigned n, const Encoding encoding, const long seed, FILE *const stream);
@@ -1,111 +1,385 @@
 #include "equations.h"
 #include "genotype.h"
 #include "randombits.h"
+#include <limits.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 
-Phenotype genoype_to_phenotype(const Genotype g) {
-    const double phi = g.phi * ((0.35 + 100.0) / ((double) (1UL << PHI_LENGTH) - 1)) - 100.0;
-    const double lambda = g.lambda * (30000.0 / ((double) (1UL << LAMBDA_LENGTH) - 1));
-    const double mu = g.mu * (20.0 / ((double) (1UL << MU_LENGTH) - 1));
-    const double sigma = g.sigma * (1000.0 / ((double) (1UL << SIGMA_LENGTH) - 1));
-    const double delta = g.delta * (25000.0 / ((double) (1UL << DELTA_LENGTH) - 1));
+/* Convert a reflected Gray code to binary with a branch-free prefix XOR, which
+ * computes `b_i = g_i ^ g_{i+1} ^ ... ^ g_63` in six steps.
+ */
+static inline uint64_t gray_to_binary(uint64_t g) {
+    g ^= g >> 1;
+    g ^= g >> 2;
+    g ^= g >> 4;
+    g ^= g >> 8;
+    g ^= g >> 16;
+    g ^= g >> 32;
 
-    return (Phenotype) {
-        .phi = phi,
-        .lambda = lambda,
-        .mu = mu,
-        .sigma = sigma,
-        .delta = delta,
-    };
+    return g;
 }
 
-Genotype get_random_genotype() {
-    return (Genotype) {
-        .phi = random_U64_length(PHI_LENGTH),
-        .lambda = random_U32_length(LAMBDA_LENGTH),
-        .mu = random_U32_length(MU_LENGTH),
-        .sigma = random_U32_length(SIGMA_LENGTH),
-        .delta = random_U16_length(DELTA_LENGTH),
-    };
+/* Integer value of a field of a genotype under `encoding`.
+ */
+static inline uint64_t decode_field(const uint64_t field, const Encoding encoding) {
+    return encoding == ENCODING_GRAY ? gray_to_binary(field) : field;
 }
 
-/* Generate two children from applying one point crossover on the parameters of
- * two parents
+/* Mask of the `length` lower bits of a word, displaced `shift` bits.
  */
-static void one_point_crossover(const Genotype p1, const Genotype p2, Genotype *const c1, Genotype *const c2) {
-    unsigned char d = uniform() * (PHI_LENGTH - 1) + 1;
-    unsigned char di = PHI_LENGTH - d;
-    c1->phi = ((p1.phi >> d) << d) | ((p2.phi << di) >> di);
-    c2->phi = ((p2.phi >> d) << d) | ((p1.phi << di) >> di);
-
-    d = uniform() * (LAMBDA_LENGTH - 1) + 1;
-    di = PHI_LENGTH - d;
-    c1->lambda = ((p1.lambda >> d) << d) | ((p2.lambda << di) >> di);
-    c2->lambda = ((p2.lambda >> d) << d) | ((p1.lambda << di) >> di);
+#define FIELD_MASK(length, shift) (((((uint64_t) 1) << (length)) - 1) << (shift))
 
-    d = uniform() * (MU_LENGTH - 1) + 1;
-    di = PHI_LENGTH - d;
-    c1->mu = ((p1.mu >> d) << d) | ((p2.mu << di) >> di);
-    c2->mu = ((p2.mu >> d) << d) | ((p1.mu << di) >> di);
+/* Layout of a field of the built-in schema.
+ */
+#define DEFAULT_LAYOUT(word_, shift_, length_, lower_, upper_) { \
+    .word = (word_), .shift = (shift_), .length = (length_), .encoding = FIELD_ENCODING_RUN, .gray = { 0, 1 }, \
+    .mask = FIELD_MASK(length_, shift_), \
+    .lower = (lower_), .upper = (upper_), .step = ((upper_) - (lower_)) / ((double) (1UL << (length_)) - 1) }
 
-    d = uniform() * (SIGMA_LENGTH - 1) + 1;
-    di = PHI_LENGTH - d;
-    c1->sigma = ((p1.sigma >> d) << d) | ((p2.sigma << di) >> di);
-    c2->sigma = ((p2.sigma >> d) << d) | ((p1.sigma << di) >> di);
+const char *const field_names[GENOTYPE_FIELDS] = {
+    [FIELD_PHI] = "phi",
+    [FIELD_LAMBDA] = "lambda",
+    [FIELD_MU] = "mu",
+    [FIELD_SIGMA] = "sigma",
+    [FIELD_DELTA] = "delta",
+};
 
-    d = uniform() * (DELTA_LENGTH - 1) + 1;
-    di = PHI_LENGTH - d;
-    c1->delta = ((p1.delta >> d) << d) | ((p2.delta << di) >> di);
-    c2->delta = ((p2.delta >> d) << d) | ((p1.delta << di) >> di);
+#define DEFAULT_LAYOUTS { \
+    [FIELD_PHI] = DEFAULT_LAYOUT(0, 0, PHI_LENGTH, PHI_MIN, PHI_MAX), \
+    [FIELD_LAMBDA] = DEFAULT_LAYOUT(0, PHI_LENGTH, LAMBDA_LENGTH, LAMBDA_MIN, LAMBDA_MAX), \
+    [FIELD_MU] = DEFAULT_LAYOUT(1, 0, MU_LENGTH, MU_MIN, MU_MAX), \
+    [FIELD_SIGMA] = DEFAULT_LAYOUT(1, MU_LENGTH, SIGMA_LENGTH, SIGMA_MIN, SIGMA_MAX), \
+    [FIELD_DELTA] = DEFAULT_LAYOUT(1, MU_LENGTH + SIGMA_LENGTH, DELTA_LENGTH, DELTA_MIN, DELTA_MAX), \
 }
 
-void genotype_crossover(const Genotype p1, const Genotype p2, Genotype *const c1, Genotype *const c2) {
-    one_point_crossover(p1, p2, c1, c2);
-}
+static const FieldLayout default_layout[GENOTYPE_FIELDS] = DEFAULT_LAYOUTS;
 
-/* Mutate parameters of a Genotype by fliping bits of its members with
- * probability `1 / length`, where `length` is the bitlength of the parameter.
+FieldLayout genotype_layout[GENOTYPE_FIELDS] = DEFAULT_LAYOUTS;
+
+uint64_t genotype_used_bits[GENOTYPE_WORDS] = {
+    FIELD_MASK(PHI_LENGTH + LAMBDA_LENGTH, 0),
+    FIELD_MASK(MU_LENGTH + SIGMA_LENGTH + DELTA_LENGTH, 0),
+};
+
+unsigned genotype_bits = PHI_LENGTH + LAMBDA_LENGTH + MU_LENGTH + SIGMA_LENGTH + DELTA_LENGTH;
+
+/* Used bits of every word, the lowest ones.
  */
-static void bit_flip_mutation(Genotype *const g) {
-    const double prob = 0.5;
+static unsigned char word_bits[GENOTYPE_WORDS] = { PHI_LENGTH + LAMBDA_LENGTH, MU_LENGTH + SIGMA_LENGTH + DELTA_LENGTH };
 
-    for(int iter = 0; iter < PHI_LENGTH; iter++) {
-        if(uniform() * (PHI_LENGTH * PHI_LENGTH) > prob * ((iter + 1) * (iter + 1))) {
-            g->phi ^= ((uint64_t) 1) << iter;
-        }
+/* Hash of the layout in use, `0` while it is the built-in one.
+ */
+static uint64_t schema_hash = 0;
+
+void genotype_schema_default(GenotypeSchema *const schema) {
+    static const FieldSchema fields[GENOTYPE_FIELDS] = {
+        { .field = FIELD_PHI, .length = PHI_LENGTH, .lower = PHI_MIN, .upper = PHI_MAX, .encoding = FIELD_ENCODING_RUN },
+        { .field = FIELD_LAMBDA, .length = LAMBDA_LENGTH, .lower = LAMBDA_MIN, .upper = LAMBDA_MAX, .encoding = FIELD_ENCODING_RUN },
+        { .field = FIELD_MU, .length = MU_LENGTH, .lower = MU_MIN, .upper = MU_MAX, .encoding = FIELD_ENCODING_RUN },
+        { .field = FIELD_SIGMA, .length = SIGMA_LENGTH, .lower = SIGMA_MIN, .upper = SIGMA_MAX, .encoding = FIELD_ENCODING_RUN },
+        { .field = FIELD_DELTA, .length = DELTA_LENGTH, .lower = DELTA_MIN, .upper = DELTA_MAX, .encoding = FIELD_ENCODING_RUN },
+    };
+
+    for(unsigned iter = 0; iter < GENOTYPE_FIELDS; iter++) {
+        schema->fields[iter] = fields[iter];
     }
+}
+
+int genotype_schema_load(const char *const path, GenotypeSchema *const schema) {
+    FILE *const file = fopen(path, "r");
+    if(file == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    char line[256];
+    unsigned n_fields = 0;
+    unsigned line_number = 0;
+    int err = 0;
+    while(!err && fgets(line, sizeof(line), file) != NULL) {
+        line_number++;
+
+        char name[32];
+        char encoding[32] = "";
+        unsigned length;
+        double lower;
+        double upper;
+        const int n_read = sscanf(line, "%31s %u %lf %lf %31s", name, &length, &lower, &upper, encoding);
+        if(n_read <= 0 || name[0] == '#') {
+            continue;
+        }
 
-    for(int iter = 0; iter < LAMBDA_LENGTH; iter++) {
-        if(uniform() * (LAMBDA_LENGTH * LAMBDA_LENGTH) > prob * ((iter + 1) * (iter + 1))) {
-            g->lambda ^= ((uint32_t) 1) << iter;
+        unsigned field = 0;
+        while(field < GENOTYPE_FIELDS && strcmp(name, field_names[field]) != 0) {
+            field++;
         }
+        if(n_read < 4 || field == GENOTYPE_FIELDS || n_fields == GENOTYPE_FIELDS || length > UCHAR_MAX) {
+            fprintf(stderr, "%s:%u: expected 'name bits lower upper [binary|gray]' with a parameter of the model\n", path, line_number);
+            err = 1;
+            continue;
+        }
+
+        schema->fields[n_fields] = (FieldSchema) {
+            .field = (GenotypeField) field,
+            .length = (unsigned char) length,
+            .lower = lower,
+            .upper = upper,
+            .encoding = FIELD_ENCODING_RUN,
+        };
+        if(strcmp(encoding, "binary") == 0) {
+            schema->fields[n_fields].encoding = ENCODING_BINARY;
+        } else if(strcmp(encoding, "gray") == 0) {
+            schema->fields[n_fields].encoding = ENCODING_GRAY;
+        } else if(n_read == 5) {
+            fprintf(stderr, "%s:%u: unknown encoding %s\n", path, line_number, encoding);
+            err = 1;
+        }
+        n_fields++;
     }
+    fclose(file);
+
+    if(!err && n_fields != GENOTYPE_FIELDS) {
+        fprintf(stderr, "%s: expected the %u parameters of the model\n", path, GENOTYPE_FIELDS);
+        err = 1;
+    }
+    return err ? -1 : 0;
+}
 
-    for(int iter = 0; iter < MU_LENGTH; iter++) {
-        if(uniform() * (MU_LENGTH * MU_LENGTH) > prob * ((iter + 1) * (iter + 1))) {
-            g->mu ^= ((uint32_t) 1) << iter;
+int genotype_schema_apply(const GenotypeSchema *const schema) {
+    FieldLayout layout[GENOTYPE_FIELDS];
+    unsigned char bits[GENOTYPE_WORDS] = { 0 };
+    unsigned seen = 0;
+    unsigned word = 0;
+
+    for(unsigned iter = 0; iter < GENOTYPE_FIELDS; iter++) {
+        const FieldSchema *const field = schema->fields + iter;
+        if(field->field >= GENOTYPE_FIELDS || (seen >> field->field) & 1 || field->length < 2 || field->length > 63
+                || !(field->lower < field->upper)) {
+            fprintf(stderr, "Invalid field %u of the schema: every parameter once, 2 to 63 bits and lower below upper bound\n", iter);
+            return -1;
+        }
+        seen |= 1U << field->field;
+
+        if(bits[word] + field->length > 63) {
+            word++;
         }
+        if(word == GENOTYPE_WORDS) {
+            fprintf(stderr, "The fields of the schema do not fit in %u words of 63 bits\n", GENOTYPE_WORDS);
+            return -1;
+        }
+
+        layout[field->field] = (FieldLayout) {
+            .word = (unsigned char) word,
+            .shift = bits[word],
+            .length = field->length,
+            .encoding = field->encoding,
+            .gray = {
+                [ENCODING_BINARY] = field->encoding == ENCODING_GRAY,
+                [ENCODING_GRAY] = field->encoding != ENCODING_BINARY,
+            },
+            .mask = FIELD_MASK(field->length, bits[word]),
+            .lower = field->lower,
+            .upper = field->upper,
+            .step = (field->upper - field->lower) / ((double) (1UL << field->length) - 1),
+        };
+        bits[word] += field->length;
+    }
+
+    int is_default = 1;
+    for(unsigned iter = 0; iter < GENOTYPE_FIELDS; iter++) {
+        is_default &= layout[iter].mask == default_layout[iter].mask && layout[iter].word == default_layout[iter].word
+            && layout[iter].encoding == default_layout[iter].encoding && layout[iter].lower == default_layout[iter].lower
+            && layout[iter].upper == default_layout[iter].upper;
+    }
+
+    genotype_bits = 0;
+    for(unsigned iter = 0; iter < GENOTYPE_WORDS; iter++) {
+        word_bits[iter] = bits[iter];
+        genotype_used_bits[iter] = bits[iter] > 0 ? FIELD_MASK(bits[iter], 0) : 0;
+        genotype_bits += bits[iter];
     }
+    memcpy(genotype_layout, layout, sizeof(layout));
 
-    for(int iter = 0; iter < SIGMA_LENGTH; iter++) {
-        if(uniform() * (SIGMA_LENGTH * SIGMA_LENGTH) > prob * ((iter + 1) * (iter + 1))) {
-            g->sigma ^= ((uint32_t) 1) << iter;
+    /* FNV-1a of the layout, zero for the built-in one */
+    schema_hash = 0;
+    if(!is_default) {
+        schema_hash = 0xCBF29CE484222325UL;
+        for(unsigned iter = 0; iter < GENOTYPE_FIELDS; iter++) {
+            const FieldLayout *const field = genotype_layout + iter;
+            const uint64_t values[] = { field->word, field->shift, field->length, (uint64_t) (field->encoding + 1) };
+            const double bounds[] = { field->lower, field->upper };
+
+            for(unsigned byte = 0; byte < sizeof(values); byte++) {
+                schema_hash = (schema_hash ^ ((const unsigned char *) values)[byte]) * 0x100000001B3UL;
+            }
+            for(unsigned byte = 0; byte < sizeof(bounds); byte++) {
+                schema_hash = (schema_hash ^ ((const unsigned char *) bounds)[byte]) * 0x100000001B3UL;
+            }
         }
     }
 
-    for(int iter = 0; iter < DELTA_LENGTH; iter++) {
-        if(uniform() * (DELTA_LENGTH * DELTA_LENGTH) > prob * ((iter + 1) * (iter + 1))) {
-            g->delta ^= ((uint16_t) 1) << iter;
+    return 0;
+}
+
+uint64_t genotype_schema_hash(void) {
+    return schema_hash;
+}
+
+/* Parameter encoded in a field of a genotype under `layout`, mapping the
+ * integer search range linearly onto `[lower, upper]`.
+ */
+static inline double decode_parameter(const Genotype *const g, const FieldLayout *const layout, const Encoding encoding) {
+    const uint64_t word = layout->word == 0 ? g->word[0] : g->word[1];
+    const uint64_t value = (word & layout->mask) >> layout->shift;
+
+    /* Fields are at most 63 bits long, so that the signed conversion is exact */
+    return (int64_t) (layout->gray[encoding] ? gray_to_binary(value) : value) * layout->step + layout->lower;
+}
+
+static inline Phenotype decode_phenotype(const Genotype *const g, const FieldLayout *const layout, const Encoding encoding) {
+    return (Phenotype) {
+        .phi = decode_parameter(g, layout + FIELD_PHI, encoding),
+        .lambda = decode_parameter(g, layout + FIELD_LAMBDA, encoding),
+        .mu = decode_parameter(g, layout + FIELD_MU, encoding),
+        .sigma = decode_parameter(g, layout + FIELD_SIGMA, encoding),
+        .delta = decode_parameter(g, layout + FIELD_DELTA, encoding),
+    };
+}
+
+Phenotype genoype_to_phenotype(const Genotype g, const Encoding encoding) {
+    /* The built-in layout is known at compile time, which folds its shifts,
+     * masks and steps into the code */
+    if(schema_hash == 0) {
+        return encoding == ENCODING_GRAY ? decode_phenotype(&g, default_layout, ENCODING_GRAY)
+                                         : decode_phenotype(&g, default_layout, ENCODING_BINARY);
+    }
+    return decode_phenotype(&g, genotype_layout, encoding);
+}
+
+Genotype get_random_genotype(Random *const rng) {
+    Genotype g = { .word = { 0, 0 } };
+
+    for(unsigned field = 0; field < GENOTYPE_FIELDS; field++) {
+        genotype_set(&g, field, random_U64_length(rng, genotype_layout[field].length));
+    }
+
+    return g;
+}
+
+/* Mask swapping the lower bits of every field below a random cut point, so
+ * that the children take the upper part of each parameter from one parent and
+ * the lower part from the other.
+ */
+static Genotype one_point_mask(Random *const rng) {
+    Genotype mask = { .word = { 0, 0 } };
+
+    for(unsigned field = 0; field < GENOTYPE_FIELDS; field++) {
+        const FieldLayout *const layout = genotype_layout + field;
+        const unsigned char d = uniform(rng) * (layout->length - 1) + 1;
+
+        mask.word[layout->word] |= FIELD_MASK(d, layout->shift);
+    }
+
+    return mask;
+}
+
+/* Mask of the used bits between two random cut points of the chromosome,
+ * numbering the used bits of both words consecutively.
+ */
+static Genotype two_point_mask(Random *const rng) {
+    unsigned char a = uniform(rng) * (genotype_bits + 1);
+    unsigned char b = uniform(rng) * (genotype_bits + 1);
+    if(a > b) {
+        const unsigned char tmp = a;
+        a = b;
+        b = tmp;
+    }
+
+    const unsigned char a0 = a < word_bits[0] ? a : word_bits[0];
+    const unsigned char b0 = b < word_bits[0] ? b : word_bits[0];
+    const unsigned char a1 = a > word_bits[0] ? a - word_bits[0] : 0;
+    const unsigned char b1 = b > word_bits[0] ? b - word_bits[0] : 0;
+
+    return (Genotype) {
+        .word = {
+            FIELD_MASK(b0 - a0, a0),
+            FIELD_MASK(b1 - a1, a1),
+        },
+    };
+}
+
+/* Mask swapping every used bit with probability 1/2.
+ */
+static Genotype uniform_mask(Random *const rng) {
+    Genotype mask;
+
+    for(unsigned iter = 0; iter < GENOTYPE_WORDS; iter++) {
+        mask.word[iter] = random_U64(rng) & genotype_used_bits[iter];
+    }
+
+    return mask;
+}
+
+Genotype get_crossover_mask(const Crossover crossover, Random *const rng) {
+    switch(crossover) {
+        case CROSSOVER_TWO_POINT:
+            return two_point_mask(rng);
+        case CROSSOVER_UNIFORM:
+            return uniform_mask(rng);
+        case CROSSOVER_ONE_POINT:
+        default:
+            return one_point_mask(rng);
+    }
+}
+
+void genotype_crossover(const Genotype p1, const Genotype p2, const Genotype mask, Genotype *const c1, Genotype *const c2) {
+    for(unsigned iter = 0; iter < GENOTYPE_WORDS; iter++) {
+        const uint64_t swap = (p1.word[iter] ^ p2.word[iter]) & mask.word[iter];
+
+        c1->word[iter] = p1.word[iter] ^ swap;
+        c2->word[iter] = p2.word[iter] ^ swap;
+    }
+}
+
+void genotype_crossover_batch(const Genotype *const p1, const Genotype *const p2, const Genotype *const masks, Genotype *const c1, Genotype *const c2, const unsigned n) {
+    const uint64_t *const x = p1[0].word;
+    const uint64_t *const y = p2[0].word;
+    const uint64_t *const m = masks[0].word;
+    uint64_t *const u = c1[0].word;
+    uint64_t *const v = c2[0].word;
+
+#pragma omp simd
+    for(unsigned iter = 0; iter < n * GENOTYPE_WORDS; iter++) {
+        const uint64_t swap = (x[iter] ^ y[iter]) & m[iter];
+
+        u[iter] = x[iter] ^ swap;
+        v[iter] = y[iter] ^ swap;
+    }
+}
+
+/* Mutate parameters of a Genotype by fliping bits of its members with
+ * probability `1 / length`, where `length` is the bitlength of the parameter.
+ */
+static void bit_flip_mutation(Genotype *const g, const double prob, Random *const rng) {
+    for(unsigned field = 0; field < GENOTYPE_FIELDS; field++) {
+        const FieldLayout *const layout = genotype_layout + field;
+        const int length = layout->length;
+
+        for(int iter = 0; iter < length; iter++) {
+            if(uniform(rng) * (length * length) > prob * ((iter + 1) * (iter + 1))) {
+                g->word[layout->word] ^= ((uint64_t) 1) << (layout->shift + iter);
+            }
         }
     }
 }
 
-void mutate_genotype(Genotype *const g) {
-    bit_flip_mutation(g);
+void mutate_genotype(Genotype *const g, const double prob, Random *const rng) {
+    bit_flip_mutation(g, prob, rng);
 }
 
-double get_genotype_fitness(Genotype const g) {
-    const Phenotype p = genoype_to_phenotype(g);
+double get_genotype_fitness(Genotype const g, const Encoding encoding, const Dataset *const data, const IntegratorMethod method, const StepController controller, const int event_location, const Fidelity fidelity) {
+    const Phenotype p = genoype_to_phenotype(g, encoding);
 
-    return get_phenotype_fitness(p);
+    return get_phenotype_fitness(p, data, method, controller, event_location, fidelity);
 }
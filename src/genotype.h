@@ -1,15 +1,36 @@
 #pragma once
 #include <stdint.h>
 #include "equations.h"
+#include "randombits.h"
 
+/* Lengths of the fields of the built-in schema.
+ */
 #define PHI_LENGTH 34
 #define LAMBDA_LENGTH 25
 #define MU_LENGTH 25
 #define SIGMA_LENGTH 17
 #define DELTA_LENGTH 15
 
-/* Structure containing the discretisation of the ODE parameters as unsigned
- * integers of appropriate length.
+/* Effective search ranges of the parameters of the built-in schema.
+ */
+#define PHI_MIN (-100.0)
+#define PHI_MAX (0.35)
+#define LAMBDA_MIN (0.0)
+#define LAMBDA_MAX (30000.0)
+#define MU_MIN (0.0)
+#define MU_MAX (20.0)
+#define SIGMA_MIN (0.0)
+#define SIGMA_MAX (1000.0)
+#define DELTA_MIN (0.0)
+#define DELTA_MAX (25000.0)
+
+/* Number of 64 bit words of a packed genotype, and most bits it can use.
+ */
+#define GENOTYPE_WORDS 2
+#define GENOTYPE_MAX_BITS (64 * GENOTYPE_WORDS)
+
+/* Fields of a genotype, containing the discretisation of the ODE parameters as
+ * unsigned integers of appropriate length.
  *
  * This is done for compatibility with Holland's Convergence Theorem, which
  * works under the setting of genes consisting in unsigned integers expressed
@@ -18,11 +39,8 @@
  * For each parameter we need the theoretical range, an effective search range
  * and a reasonable precision, thus fixing the range and discretisation
  * formula for the genotype.
- *
- * The structure is packed as to occupy the least space possible, and in total
- * we achieve a `sizeof(Phenotype) = 40`, while `sizeof(Genotype) = 16`.
  */
-typedef struct {
+typedef enum {
     /* - Theoretical search range: (-∞, α], where α = 0.3489494085776018 is the
      * neat population growth rate estimated from the first epoch.
      *
@@ -32,7 +50,7 @@ typedef struct {
      *
      * - Integer search range: [0, 2^34 - 1].
      */
-    uint64_t phi : PHI_LENGTH;
+    FIELD_PHI,
     /* - Theoretical search range: (0, ∞).
      *
      * - Effective search range: [0, 3000].
@@ -41,7 +59,7 @@ typedef struct {
      *
      * - Integer search range: [0, 2^25 - 1].
      */
-    uint32_t lambda : LAMBDA_LENGTH;
+    FIELD_LAMBDA,
     /* - Theoretical search range: (0, ∞).
      *
      * - Effective search range: [0, 20].
@@ -50,7 +68,7 @@ typedef struct {
      *
      * - Integer search range: [0, 2^25 - 1].
      */
-    uint32_t mu : MU_LENGTH;
+    FIELD_MU,
     /* - Theoretical search range: (0, ∞).
      *
      * - Effective search range: [0, 1000].
@@ -59,7 +77,7 @@ typedef struct {
      *
      * - Integer search range: [0, 2^17 - 1].
      */
-    uint32_t sigma : SIGMA_LENGTH;
+    FIELD_SIGMA,
     /* - Theoretical search range: (0, ∞).
      *
      * - Effective search range: [0, 25000].
@@ -68,27 +86,189 @@ typedef struct {
      *
      * - Integer search range: [0, 2^15 - 1].
      */
-    uint16_t delta : DELTA_LENGTH;
+    FIELD_DELTA,
+    GENOTYPE_FIELDS,
+} GenotypeField;
+
+/* Names of the fields, those of the parameters they encode.
+ */
+extern const char *const field_names[GENOTYPE_FIELDS];
+
+/* Interpretation of the bits of every field of a `Genotype`.
+ *
+ * With the reflected Gray code consecutive integers differ in a single bit,
+ * so that `mutate_genotype` can perform small moves in every parameter
+ * instead of facing the Hamming cliffs of the plain binary code.
+ */
+typedef enum {
+    ENCODING_BINARY,
+    ENCODING_GRAY,
+} Encoding;
+
+/* Encoding of a field of a schema following the encoding of the run.
+ */
+#define FIELD_ENCODING_RUN (-1)
+
+/* Position of a field inside the packed genotype: the word holding it, the
+ * offset of its lowest bit, its length and the mask of its bits in the word,
+ * and the range of the parameter it encodes, mapped linearly onto its
+ * integer values `step` apart.
+ *
+ * No field straddles two words, so that every field is read and written with
+ * a single shift and mask.
+ */
+typedef struct {
+    unsigned char word;
+    unsigned char shift;
+    unsigned char length;
+    /* `Encoding` of the field, or `FIELD_ENCODING_RUN`.
+     */
+    signed char encoding;
+    /* Whether the field is read as a Gray code under each `Encoding` of the
+     * run, resolved from `encoding`.
+     */
+    unsigned char gray[2];
+    uint64_t mask;
+    double lower;
+    double upper;
+    double step;
+} FieldLayout;
+
+/* Field of a schema, the fields of a schema packed in their order.
+ */
+typedef struct {
+    GenotypeField field;
+    unsigned char length;
+    double lower;
+    double upper;
+    signed char encoding;
+} FieldSchema;
+
+/* Width, range and encoding of every parameter of the model, and the order
+ * of their fields in the genotype.
+ */
+typedef struct {
+    FieldSchema fields[GENOTYPE_FIELDS];
+} GenotypeSchema;
+
+/* Layout of the fields in the packed genotype, built from the schema in use,
+ * by default:
+ *
+ *     word 0: phi [0, 34), lambda [34, 59)
+ *     word 1: mu [0, 25), sigma [25, 42), delta [42, 57)
+ */
+extern FieldLayout genotype_layout[GENOTYPE_FIELDS];
+
+/* Bits of every word of the genotype that belong to some field, always the
+ * lowest ones of the word, and their total.
+ */
+extern uint64_t genotype_used_bits[GENOTYPE_WORDS];
+extern unsigned genotype_bits;
+
+/* Fill `schema` with the built-in schema.
+ */
+void genotype_schema_default(GenotypeSchema *const schema);
+
+/* Read the schema at `path`, one field per line as its name, length in bits,
+ * lower and upper bounds and optionally its encoding, binary or gray, which
+ * otherwise follows `--encoding`. Lines starting with `#` are ignored.
+ *
+ * Returns `0` on success, printing the reason otherwise.
+ */
+int genotype_schema_load(const char *const path, GenotypeSchema *const schema);
+
+/* Build the layout of the genotype from `schema`, packing its fields into the
+ * words in order, at most 63 bits of each one, returning `0` on success and
+ * leaving the layout untouched if the schema is invalid or does not fit.
+ *
+ * The layout is shared by every run of the process and must not change while
+ * any of them is alive.
+ */
+int genotype_schema_apply(const GenotypeSchema *const schema);
+
+/* Hash of the layout in use, `0` for the built-in schema, so that fitness
+ * values and traces are only reused with the schema that decoded them.
+ */
+uint64_t genotype_schema_hash(void);
+
+/* Encoding of `field` in the genotypes of a run with `encoding`.
+ */
+static inline Encoding field_encoding(const GenotypeField field, const Encoding encoding) {
+    return genotype_layout[field].encoding == FIELD_ENCODING_RUN ? encoding : (Encoding) genotype_layout[field].encoding;
+}
+
+/* The fields are packed in two 64 bit words following `genotype_layout`, so
+ * that genetic operators act on whole words with a few bitwise operations.
+ * In total we achieve a `sizeof(Phenotype) = 40`, while
+ * `sizeof(Genotype) = 16`.
+ */
+typedef struct {
+    uint64_t word[GENOTYPE_WORDS];
 } Genotype;
 
+/* Integer value of a field of a genotype.
+ */
+static inline uint64_t genotype_get(const Genotype *const g, const GenotypeField field) {
+    const FieldLayout *const layout = genotype_layout + field;
+
+    return (g->word[layout->word] & layout->mask) >> layout->shift;
+}
+
+/* Set the integer value of a field of a genotype.
+ */
+static inline void genotype_set(Genotype *const g, const GenotypeField field, const uint64_t value) {
+    const FieldLayout *const layout = genotype_layout + field;
+    uint64_t *const word = g->word + layout->word;
+
+    *word = (*word & ~layout->mask) | ((value << layout->shift) & layout->mask);
+}
+
+/* Crossover operators, all of them expressed as a mask of the bits the first
+ * child inherits from the second parent (and vice versa).
+ */
+typedef enum {
+    /* One cut point per field, swapping the lower bits of every parameter.
+     */
+    CROSSOVER_ONE_POINT,
+    /* Two cut points over the whole chromosome.
+     */
+    CROSSOVER_TWO_POINT,
+    /* Every bit is swapped with probability 1/2.
+     */
+    CROSSOVER_UNIFORM,
+} Crossover;
+
 /* Function to convert from discrertised coefficients, used by the genetic
  * algorithm as unsigned integers, to floating point numbers.
  */
-Phenotype genoype_to_phenotype(const Genotype g);
+Phenotype genoype_to_phenotype(const Genotype g, const Encoding encoding);
 
 /* Generate random genotype.
  */
-Genotype get_random_genotype();
+Genotype get_random_genotype(Random *const rng);
+
+/* Draw the mask of bits to swap with the operator `crossover`.
+ */
+Genotype get_crossover_mask(const Crossover crossover, Random *const rng);
 
-/* Mix and match parts of two genotypes to form two children genotypes.
+/* Mix and match parts of two genotypes to form two children genotypes,
+ * swapping the bits set in `mask`.
+ */
+void genotype_crossover(const Genotype p1, const Genotype p2, const Genotype mask, Genotype *const c1, Genotype *const c2);
+
+/* Apply `genotype_crossover` to `n` pairs of parents at once.
+ *
+ * The kernel is a branch-free loop of AND and XOR over the words of the
+ * batch, vectorised by the compiler.
  */
-void genotype_crossover(const Genotype p1, const Genotype p2, Genotype *const c1, Genotype *const c2);
+void genotype_crossover_batch(const Genotype *const p1, const Genotype *const p2, const Genotype *const masks, Genotype *const c1, Genotype *const c2, const unsigned n);
 
-/* Randomly mutate bits of a genotype.
+/* Randomly mutate bits of a genotype, the lower `prob` the more bits flipped.
  */
-void mutate_genotype(Genotype *const g);
+void mutate_genotype(Genotype *const g, const double prob, Random *const rng);
 
 /* Calculate fitness of a genotype through the sum of the squared error between
- * the predictions made from the associated phenotype and the observations.
+ * the predictions made from the associated phenotype, integrated by `method`
+ * with the accuracy of `fidelity`, and the observations.
  */
-double get_genotype_fitness(Genotype const g);
+double get_genotype_fitness(Genotype const g, const Encoding encoding, const Dataset *const data, const IntegratorMethod method, const StepController controller, const int event_location, const Fidelity fidelity);
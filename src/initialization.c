@@ -0,0 +1,232 @@
+#include "initialization.h"
+#include "archive.h"
+#include "equations.h"
+#include "genetic-algorithm.h"
+#include "genotype.h"
+#include "randombits.h"
+#include "scheduler.h"
+#include "selection.h"
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Bits of the points of the Sobol sequence.
+ */
+#define SOBOL_BITS (64)
+
+/* Lowest fraction of valid candidates assumed when sizing a round.
+ */
+#define MIN_VALID_RATE (0.01)
+
+/* Primitive polynomials of degree `s` with inner coefficients `a`, and the
+ * initial direction numbers `m` of the dimensions following the first one, as
+ * tabulated by Joe and Kuo.
+ */
+static const struct {
+    unsigned char s;
+    unsigned char a;
+    unsigned char m[3];
+} sobol_polynomials[GENOTYPE_FIELDS - 1] = {
+    { .s = 1, .a = 0, .m = { 1 } },
+    { .s = 2, .a = 1, .m = { 1, 3 } },
+    { .s = 3, .a = 1, .m = { 1, 3, 1 } },
+    { .s = 3, .a = 2, .m = { 1, 1, 1 } },
+};
+
+/* Candidates of a round, evaluated by the scheduler.
+ */
+typedef struct {
+    Individual *candidates;
+    const GeneticAlgorithmConfig *config;
+    const ArchiveKey *key;
+} Round;
+
+/* Model of a population, evaluating its rounds on a scheduler.
+ */
+typedef struct {
+    const GeneticAlgorithmConfig *config;
+    const Scheduler *scheduler;
+    ArchiveKey key;
+} ModelRounds;
+
+/* Direction numbers of the first `GENOTYPE_FIELDS` dimensions of the Sobol
+ * sequence, left aligned in `SOBOL_BITS` bits.
+ */
+static void sobol_directions(uint64_t directions[GENOTYPE_FIELDS][SOBOL_BITS]) {
+    for(unsigned bit = 0; bit < SOBOL_BITS; bit++) {
+        directions[0][bit] = ((uint64_t) 1) << (SOBOL_BITS - 1 - bit);
+    }
+
+    for(unsigned dimension = 1; dimension < GENOTYPE_FIELDS; dimension++) {
+        const unsigned s = sobol_polynomials[dimension - 1].s;
+        const unsigned a = sobol_polynomials[dimension - 1].a;
+        uint64_t *const v = directions[dimension];
+
+        for(unsigned bit = 0; bit < s; bit++) {
+            v[bit] = ((uint64_t) sobol_polynomials[dimension - 1].m[bit]) << (SOBOL_BITS - 1 - bit);
+        }
+        for(unsigned bit = s; bit < SOBOL_BITS; bit++) {
+            v[bit] = v[bit - s] ^ (v[bit - s] >> s);
+            for(unsigned j = 1; j < s; j++) {
+                if((a >> (s - 1 - j)) & 1) {
+                    v[bit] ^= v[bit - j];
+                }
+            }
+        }
+    }
+}
+
+/* Field of a genotype decoding to the integer `value` under `encoding`.
+ */
+static inline uint64_t encode_field(const uint64_t value, const Encoding encoding) {
+    return encoding == ENCODING_GRAY ? value ^ (value >> 1) : value;
+}
+
+/* Fill `candidates` with the points `first` to `first + n - 1` of the Sobol
+ * sequence, digitally shifted by `shift`.
+ */
+static void sobol_candidates(Individual *const candidates, const unsigned n, const unsigned long first, uint64_t directions[GENOTYPE_FIELDS][SOBOL_BITS], const uint64_t *const shift, const Encoding encoding) {
+    for(unsigned iter = 0; iter < n; iter++) {
+        const uint64_t index = first + iter;
+        const uint64_t gray = index ^ (index >> 1);
+        Genotype g = { .word = { 0, 0 } };
+
+        for(unsigned field = 0; field < GENOTYPE_FIELDS; field++) {
+            uint64_t x = shift[field];
+            for(unsigned bit = 0; bit < SOBOL_BITS; bit++) {
+                if((gray >> bit) & 1) {
+                    x ^= directions[field][bit];
+                }
+            }
+            genotype_set(&g, field, encode_field(x >> (SOBOL_BITS - genotype_layout[field].length), field_encoding(field, encoding)));
+        }
+        candidates[iter].genotype = g;
+    }
+}
+
+/* Fill `candidates` with a Latin hypercube of `n` points: the range of every
+ * field is split into `n` strata, each of them holding exactly one point at a
+ * random position.
+ */
+static void latin_candidates(Individual *const candidates, const unsigned n, unsigned *const permutation, Random *const rng, const Encoding encoding) {
+    for(unsigned iter = 0; iter < n; iter++) {
+        candidates[iter].genotype = (Genotype) { .word = { 0, 0 } };
+    }
+
+    for(unsigned field = 0; field < GENOTYPE_FIELDS; field++) {
+        const double range = ldexp(1.0, genotype_layout[field].length);
+
+        for(unsigned iter = 0; iter < n; iter++) {
+            permutation[iter] = iter;
+        }
+        for(unsigned iter = n - 1; iter > 0; iter--) {
+            const unsigned pick = select_random_index(iter + 1, rng);
+            const unsigned tmp = permutation[iter];
+            permutation[iter] = permutation[pick];
+            permutation[pick] = tmp;
+        }
+
+        for(unsigned iter = 0; iter < n; iter++) {
+            const uint64_t low = (uint64_t) floor(permutation[iter] * range / n);
+            const uint64_t high = (uint64_t) floor((permutation[iter] + 1) * range / n);
+            const uint64_t value = high > low ? low + random_U64_length(rng, SOBOL_BITS) % (high - low) : low;
+
+            genotype_set(&(candidates[iter].genotype), field, encode_field(value, field_encoding(field, encoding)));
+        }
+    }
+}
+
+/* Scheduler task evaluating the `index`-th candidate of a round.
+ */
+static void candidate_task(const unsigned index, void *const data) {
+    const Round *const round = (Round *) data;
+
+    evaluate_individual(round->candidates + index, round->config, round->key);
+}
+
+/* Evaluate a round of candidates with the model, in parallel.
+ */
+static void evaluate_model_round(Individual *const candidates, const unsigned n, void *const data) {
+    const ModelRounds *const rounds = (ModelRounds *) data;
+    Round round = { .candidates = candidates, .config = rounds->config, .key = &(rounds->key) };
+
+    scheduler_run(rounds->scheduler, n, candidate_task, &round);
+}
+
+unsigned long initialize_population(Individual *const individuals, const unsigned n_individuals, const GeneticAlgorithmConfig *const config, Random *const rng, const Scheduler *const scheduler) {
+    ModelRounds rounds = { .config = config, .scheduler = scheduler, .key = { .dataset = 0, .settings = 0 } };
+    if(config->archive != NULL) {
+        rounds.key = archive_key(config->dataset, config->encoding, config->integrator, config->controller, config->event_location);
+    }
+
+    return initialize_population_with(individuals, n_individuals, config, rng, evaluate_model_round, &rounds);
+}
+
+unsigned long initialize_population_with(Individual *const individuals, const unsigned n_individuals, const GeneticAlgorithmConfig *const config, Random *const rng, const RoundEvaluation evaluate, void *const data) {
+    uint64_t directions[GENOTYPE_FIELDS][SOBOL_BITS];
+    uint64_t shift[GENOTYPE_FIELDS];
+
+    if(config->initialization == INITIALIZATION_SOBOL) {
+        sobol_directions(directions);
+        for(unsigned field = 0; field < GENOTYPE_FIELDS; field++) {
+            shift[field] = random_U64_length(rng, SOBOL_BITS);
+        }
+    }
+
+    Individual *candidates = NULL;
+    unsigned *permutation = NULL;
+    unsigned capacity = 0;
+    unsigned long drawn = 0;
+    double valid_rate = 1.0;
+
+    for(unsigned filled = 0; filled < n_individuals;) {
+        const unsigned missing = n_individuals - filled;
+        const double wanted = ceil(1.1 * missing / valid_rate);
+        const unsigned n = wanted < 4.0 * n_individuals ? (unsigned) wanted : 4 * n_individuals;
+
+        if(n > capacity) {
+            Individual *const grown = (Individual *) realloc(candidates, sizeof(Individual) * n);
+            unsigned *const grown_permutation = grown != NULL ? (unsigned *) realloc(permutation, sizeof(unsigned) * n) : NULL;
+            if(grown_permutation == NULL) {
+                free(grown != NULL ? grown : candidates);
+                free(permutation);
+                return 0;
+            }
+            candidates = grown;
+            permutation = grown_permutation;
+            capacity = n;
+        }
+
+        if(config->initialization == INITIALIZATION_SOBOL) {
+            sobol_candidates(candidates, n, drawn, directions, shift, config->encoding);
+        } else if(config->initialization == INITIALIZATION_LATIN) {
+            latin_candidates(candidates, n, permutation, rng, config->encoding);
+        } else {
+            for(unsigned iter = 0; iter < n; iter++) {
+                candidates[iter].genotype = get_random_genotype(rng);
+            }
+        }
+        for(unsigned iter = 0; iter < n; iter++) {
+            candidates[iter].fidelity = FIDELITY_HIGH;
+        }
+        drawn += n;
+
+        evaluate(candidates, n, data);
+
+        unsigned valid = 0;
+        for(unsigned iter = 0; iter < n; iter++) {
+            if(candidates[iter].fitness != DBL_MAX) {
+                valid++;
+                if(filled < n_individuals) {
+                    individuals[filled++] = candidates[iter];
+                }
+            }
+        }
+        valid_rate = fmax((double) valid / n, MIN_VALID_RATE);
+    }
+
+    free(permutation);
+    free(candidates);
+    return drawn;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "genetic-algorithm.h"
+#include "randombits.h"
+#include "scheduler.h"
+
+/* Fill `individuals` with `n_individuals` individuals of valid fitness,
+ * sampled in genotype space as `config->initialization` says.
+ *
+ * Candidates are drawn in rounds sized from the fraction of valid ones seen
+ * so far, evaluated in parallel on `scheduler`, and the valid ones fill the
+ * population in sequence order, so that the result does not depend on the
+ * number of threads. Sequences are stratified in the decoded parameters,
+ * whatever the encoding, and randomised from `rng`.
+ *
+ * Returns the number of candidates evaluated, or `0` if memory runs out.
+ */
+unsigned long initialize_population(Individual *const individuals, const unsigned n_individuals, const GeneticAlgorithmConfig *const config, Random *const rng, const Scheduler *const scheduler);
+
+/* Evaluates the `n` candidates of a round, with `data` given to
+ * `initialize_population_with`.
+ */
+typedef void (*RoundEvaluation)(Individual *const candidates, const unsigned n, void *const data);
+
+/* Fill `individuals` like `initialize_population`, but evaluating the rounds
+ * of candidates with `evaluate` instead of the model.
+ */
+unsigned long initialize_population_with(Individual *const individuals, const unsigned n_individuals, const GeneticAlgorithmConfig *const config, Random *const rng, const RoundEvaluation evaluate, void *const data);
@@ -0,0 +1,263 @@
+#include "integrator-comparison.h"
+#include "equations.h"
+#include "genetic-algorithm.h"
+#include "genotype.h"
+#include "integrator.h"
+#include "multiplexer.h"
+#include "randombits.h"
+#include "scheduler.h"
+#include <float.h>
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Lowest sigma of the population with a nearly discontinuous dispersal.
+ */
+#define HIGH_SIGMA (600.0)
+
+static const char *const fidelity_names[FIDELITIES] = {
+    [FIDELITY_LOW] = "low",
+    [FIDELITY_HIGH] = "high",
+};
+
+/* Population evaluated with one integrator and fidelity.
+ */
+typedef struct {
+    const Individual *individuals;
+    const GeneticAlgorithmConfig *config;
+    IntegratorMethod method;
+    StepController controller;
+    int event_location;
+    Fidelity fidelity;
+    double *fitness;
+    unsigned long *ode;
+    unsigned long *rejected;
+} Comparison;
+
+typedef struct {
+    double value;
+    unsigned index;
+} Ranked;
+
+/* Scheduler task evaluating the `index`-th individual of a comparison.
+ */
+static void comparison_task(const unsigned index, void *const data) {
+    const Comparison *const comparison = (Comparison *) data;
+    const GeneticAlgorithmConfig *const config = comparison->config;
+    const unsigned long before = get_ode_evaluations();
+    const unsigned long rejected = get_integration_stats().rejected;
+
+    comparison->fitness[index] = get_genotype_fitness(comparison->individuals[index].genotype, config->encoding,
+            config->dataset, comparison->method, comparison->controller, comparison->event_location, comparison->fidelity);
+    comparison->ode[index] = get_ode_evaluations() - before;
+    comparison->rejected[index] = get_integration_stats().rejected - rejected;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    const double x = *(const double *) a;
+    const double y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+static int compare_ranked(const void *a, const void *b) {
+    const double x = ((const Ranked *) a)->value;
+    const double y = ((const Ranked *) b)->value;
+
+    return (x > y) - (x < y);
+}
+
+/* Store in `ranks` the rank of every value, averaging ties.
+ */
+static void rank_values(const double *const values, const unsigned n, double *const ranks) {
+    Ranked *ranked = (Ranked *) malloc(sizeof(Ranked) * n);
+
+    for(unsigned iter = 0; iter < n; iter++) {
+        ranked[iter] = (Ranked) { .value = values[iter], .index = iter };
+    }
+    qsort(ranked, n, sizeof(Ranked), compare_ranked);
+
+    for(unsigned first = 0; first < n;) {
+        unsigned last = first + 1;
+        while(last < n && ranked[last].value == ranked[first].value) {
+            last++;
+        }
+        for(unsigned iter = first; iter < last; iter++) {
+            ranks[ranked[iter].index] = 0.5 * (first + last - 1);
+        }
+        first = last;
+    }
+
+    free(ranked);
+}
+
+/* Pearson correlation of `x` and `y`.
+ */
+static double correlation(const double *const x, const double *const y, const unsigned n) {
+    double mean_x = 0.0;
+    double mean_y = 0.0;
+    for(unsigned iter = 0; iter < n; iter++) {
+        mean_x += x[iter] / n;
+        mean_y += y[iter] / n;
+    }
+
+    double xy = 0.0;
+    double xx = 0.0;
+    double yy = 0.0;
+    for(unsigned iter = 0; iter < n; iter++) {
+        xy += (x[iter] - mean_x) * (y[iter] - mean_y);
+        xx += (x[iter] - mean_x) * (x[iter] - mean_x);
+        yy += (y[iter] - mean_y) * (y[iter] - mean_y);
+    }
+
+    return xx > 0.0 && yy > 0.0 ? xy / sqrt(xx * yy) : 1.0;
+}
+
+/* Kendall tau-b rank correlation of `x` and `y`.
+ */
+static double kendall(const double *const x, const double *const y, const unsigned n) {
+    double concordance = 0.0;
+    double pairs_x = 0.0;
+    double pairs_y = 0.0;
+
+    for(unsigned i = 0; i < n; i++) {
+        for(unsigned j = i + 1; j < n; j++) {
+            const int sign_x = (x[i] > x[j]) - (x[i] < x[j]);
+            const int sign_y = (y[i] > y[j]) - (y[i] < y[j]);
+
+            concordance += sign_x * sign_y;
+            pairs_x += sign_x != 0;
+            pairs_y += sign_y != 0;
+        }
+    }
+
+    return pairs_x > 0.0 && pairs_y > 0.0 ? concordance / sqrt(pairs_x * pairs_y) : 1.0;
+}
+
+/* Compare the integrators on the population `individuals`.
+ */
+static void compare_population(const char *const name, const Individual *const individuals, const unsigned n,
+        const GeneticAlgorithmConfig *const config, const Scheduler *const scheduler, FILE *const stream) {
+    double *reference = (double *) malloc(sizeof(double) * n);
+    double *reference_ranks = (double *) malloc(sizeof(double) * n);
+    double *fitness = (double *) malloc(sizeof(double) * n);
+    double *ranks = (double *) malloc(sizeof(double) * n);
+    unsigned long *ode = (unsigned long *) malloc(sizeof(unsigned long) * n);
+    unsigned long *rejected = (unsigned long *) malloc(sizeof(unsigned long) * n);
+    double *tail = (double *) malloc(sizeof(double) * n);
+    const double decile = 0.1 * n;
+
+    for(unsigned fidelity = FIDELITIES; fidelity-- > 0;) {
+        for(unsigned run = 0; run < CONTROLLERS * INTEGRATORS; run++) {
+            const unsigned controller = run / INTEGRATORS;
+            const unsigned method = run % INTEGRATORS;
+            Comparison comparison = {
+                .individuals = individuals,
+                .config = config,
+                .method = (IntegratorMethod) method,
+                .controller = (StepController) controller,
+                .event_location = config->event_location,
+                .fidelity = (Fidelity) fidelity,
+                .fitness = fidelity == FIDELITY_HIGH && controller == CONTROLLER_ELEMENTARY && method == INTEGRATOR_RKF78 ? reference : fitness,
+                .ode = ode,
+                .rejected = rejected,
+            };
+
+            /* Rejected steps without locating the crossings of delta */
+            comparison.event_location = 0;
+            scheduler_run(scheduler, n, comparison_task, &comparison);
+            unsigned long rejected_without = 0;
+            for(unsigned iter = 0; iter < n; iter++) {
+                rejected_without += rejected[iter];
+            }
+            comparison.event_location = config->event_location;
+
+            const double start = omp_get_wtime();
+            scheduler_run(scheduler, n, comparison_task, &comparison);
+            const double elapsed = omp_get_wtime() - start;
+
+            if(comparison.fitness == reference) {
+                rank_values(reference, n, reference_ranks);
+            }
+            rank_values(comparison.fitness, n, ranks);
+
+            for(unsigned iter = 0; iter < n; iter++) {
+                tail[iter] = (double) ode[iter];
+            }
+            qsort(tail, n, sizeof(double), compare_doubles);
+
+            unsigned long ode_total = 0;
+            unsigned long rejected_total = 0;
+            unsigned failures = 0;
+            unsigned top = 0;
+            double error = 0.0;
+            for(unsigned iter = 0; iter < n; iter++) {
+                ode_total += ode[iter];
+                rejected_total += rejected[iter];
+                failures += comparison.fitness[iter] == DBL_MAX;
+                top += reference_ranks[iter] < decile && ranks[iter] < decile;
+                if(reference[iter] != DBL_MAX && comparison.fitness[iter] != DBL_MAX) {
+                    error = fmax(error, fabs(comparison.fitness[iter] - reference[iter]) / fmax(reference[iter], DBL_MIN));
+                }
+            }
+
+            fprintf(stream, "%s\t%s\t%s\t%s\t%.1f\t%.0f\t%.2f\t%.2f\t%.2f\t%u\t%.6f\t%.6f\t%.3f\t%.3g\n", name, integrator_names[method],
+                    controller_names[controller], fidelity_names[fidelity], (double) ode_total / n, tail[(unsigned) (0.99 * (n - 1))], 1.0e6 * elapsed * scheduler->n_threads / n,
+                    (double) rejected_total / n, (double) rejected_without / n, failures,
+                    correlation(reference_ranks, ranks, n), kendall(reference_ranks, ranks, n),
+                    decile >= 1.0 ? top / floor(decile) : 1.0, error);
+        }
+    }
+
+    free(tail);
+    free(rejected);
+    free(ode);
+    free(ranks);
+    free(fitness);
+    free(reference_ranks);
+    free(reference);
+}
+
+int compare_integrators(const GeneticAlgorithmConfig *const config, const long seed, const Scheduler *const scheduler, FILE *const stream) {
+    GeneticAlgorithm ga;
+    GeneticAlgorithm *gas[1] = { &ga };
+    const GeneticAlgorithmConfig *configs[1] = { config };
+    Multiplexer multiplexer;
+
+    ode_counting_enabled = 1;
+    fprintf(stream, "population\tintegrator\tcontroller\tfidelity\tode_per_call\tode_p99\tus_per_call\trejected_per_call\trejected_without_events\tfailures\tspearman\tkendall\ttop_decile\tmax_relative_error\n");
+
+    if(multiplexer_init_runs(scheduler, gas, configs, &seed, 1) != 0) {
+        fprintf(stderr, "Could not allocate the population\n");
+        return 1;
+    }
+    compare_population("initial", ga.individuals, ga.n_individuals, config, scheduler, stream);
+
+    /* The initial population moved to the steep dispersal of high sigma */
+    Individual *steep = (Individual *) malloc(sizeof(Individual) * ga.n_individuals);
+    const FieldLayout *const sigma = genotype_layout + FIELD_SIGMA;
+    const uint64_t sigma_max = (1UL << sigma->length) - 1;
+    const double high = (HIGH_SIGMA - sigma->lower) / (sigma->upper - sigma->lower);
+    for(unsigned iter = 0; iter < ga.n_individuals; iter++) {
+        const uint64_t value = (uint64_t) ((high + (1.0 - high) * uniform(&(ga.rng))) * sigma_max);
+
+        steep[iter] = ga.individuals[iter];
+        genotype_set(&(steep[iter].genotype), FIELD_SIGMA, field_encoding(FIELD_SIGMA, config->encoding) == ENCODING_GRAY ? value ^ (value >> 1) : value);
+    }
+    compare_population("high_sigma", steep, ga.n_individuals, config, scheduler, stream);
+    free(steep);
+
+    if(config->n_generations > 0) {
+        multiplexer_init(&multiplexer);
+        for(unsigned generation = 0; generation < config->n_generations; generation++) {
+            multiplexer_step(&multiplexer, scheduler, gas, 1);
+        }
+        multiplexer_free(&multiplexer);
+
+        compare_population("evolved", ga.individuals, ga.n_individuals, config, scheduler, stream);
+    }
+
+    genetic_algorithm_free(&ga);
+    return 0;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "genetic-algorithm.h"
+#include "scheduler.h"
+#include <stdio.h>
+
+/* Compare every integrator, step size controller and fidelity against RKF78
+ * with the elementary controller at full accuracy on the initial population
+ * of a run with `config` and `seed`, on the same population with sigma moved
+ * above 600, where the dispersal is nearly a step, and on the one it evolves
+ * to after `config->n_generations` generations.
+ *
+ * Writes a tab separated line to `stream` per population, integrator,
+ * controller and fidelity with the mean and 99th percentile of the ODE
+ * evaluations (Jacobian ones included), the mean microseconds per fitness
+ * call, the mean rejected steps per call with and without locating the
+ * crossings of `x = delta`, the failed integrations, the Spearman and Kendall
+ * (tau-b) correlations of the fitness ranking with the reference one, the
+ * fraction of the reference top decile kept in the top decile, and the largest
+ * relative fitness error.
+ *
+ * Returns `0` on success, and `1` if the population cannot be allocated.
+ */
+int compare_integrators(const GeneticAlgorithmConfig *const config, const long seed, const Scheduler *const scheduler, FILE *const stream);
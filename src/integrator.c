@@ -0,0 +1,558 @@
+#include "integrator.h"
+#include "RKF78.h"
+#include <float.h>
+#include <math.h>
+
+#define TABLEAU_MAX_STAGES (13)
+
+/* Butcher tableau of an embedded explicit Runge-Kutta pair.
+ */
+typedef struct {
+    unsigned stages;
+    double c[TABLEAU_MAX_STAGES];
+    double a[TABLEAU_MAX_STAGES][TABLEAU_MAX_STAGES];
+    /* Weights of the solution, of the higher order.
+     */
+    double b[TABLEAU_MAX_STAGES];
+    /* Weights of the error estimate, the difference between both orders.
+     */
+    double e[TABLEAU_MAX_STAGES];
+    /* One over the lower order plus one, for the step size control.
+     */
+    double exponent;
+    /* Whether the last stage is the derivative at the new point.
+     */
+    int fsal;
+} Tableau;
+
+static const Tableau dopri54 = {
+    .stages = 7,
+    .c = { 0.0, 1.0 / 5.0, 3.0 / 10.0, 4.0 / 5.0, 8.0 / 9.0, 1.0, 1.0 },
+    .a = {
+        { 0.0 },
+        { 1.0 / 5.0 },
+        { 3.0 / 40.0, 9.0 / 40.0 },
+        { 44.0 / 45.0, -56.0 / 15.0, 32.0 / 9.0 },
+        { 19372.0 / 6561.0, -25360.0 / 2187.0, 64448.0 / 6561.0, -212.0 / 729.0 },
+        { 9017.0 / 3168.0, -355.0 / 33.0, 46732.0 / 5247.0, 49.0 / 176.0, -5103.0 / 18656.0 },
+        { 35.0 / 384.0, 0.0, 500.0 / 1113.0, 125.0 / 192.0, -2187.0 / 6784.0, 11.0 / 84.0 },
+    },
+    .b = { 35.0 / 384.0, 0.0, 500.0 / 1113.0, 125.0 / 192.0, -2187.0 / 6784.0, 11.0 / 84.0, 0.0 },
+    .e = { 71.0 / 57600.0, 0.0, -71.0 / 16695.0, 71.0 / 1920.0, -17253.0 / 339200.0, 22.0 / 525.0, -1.0 / 40.0 },
+    .exponent = 1.0 / 5.0,
+    .fsal = 1,
+};
+
+static const Tableau bs32 = {
+    .stages = 4,
+    .c = { 0.0, 1.0 / 2.0, 3.0 / 4.0, 1.0 },
+    .a = {
+        { 0.0 },
+        { 1.0 / 2.0 },
+        { 0.0, 3.0 / 4.0 },
+        { 2.0 / 9.0, 1.0 / 3.0, 4.0 / 9.0 },
+    },
+    .b = { 2.0 / 9.0, 1.0 / 3.0, 4.0 / 9.0, 0.0 },
+    .e = { -5.0 / 72.0, 1.0 / 12.0, 1.0 / 9.0, -1.0 / 8.0 },
+    .exponent = 1.0 / 3.0,
+    .fsal = 1,
+};
+
+/* The pair of RKF78, the coefficients of `RKF78.c` in the same order, stepping
+ * with the solution of order 8.
+ */
+static const Tableau rkf78 = {
+    .stages = 13,
+    .c = { 0.0, 2.0 / 27.0, 1.0 / 9.0, 1.0 / 6.0, 5.0 / 12.0, 0.5, 5.0 / 6.0, 1.0 / 6.0, 2.0 / 3.0, 1.0 / 3.0, 1.0, 0.0, 1.0 },
+    .a = {
+        { 0.0 },
+        { 2.0 / 27.0 },
+        { 1.0 / 36.0, 1.0 / 12.0 },
+        { 1.0 / 24.0, 0.0, 1.0 / 8.0 },
+        { 5.0 / 12.0, 0.0, -25.0 / 16.0, 25.0 / 16.0 },
+        { 0.05, 0.0, 0.0, 0.25, 0.2 },
+        { -25.0 / 108.0, 0.0, 0.0, 125.0 / 108.0, -65.0 / 27.0, 125.0 / 54.0 },
+        { 31.0 / 300.0, 0.0, 0.0, 0.0, 61.0 / 225.0, -2.0 / 9.0, 13.0 / 900.0 },
+        { 2.0, 0.0, 0.0, -53.0 / 6.0, 704.0 / 45.0, -107.0 / 9.0, 67.0 / 90.0, 3.0 },
+        { -91.0 / 108.0, 0.0, 0.0, 23.0 / 108.0, -976.0 / 135.0, 311.0 / 54.0, -19.0 / 60.0, 17.0 / 6.0, -1.0 / 12.0 },
+        { 2383.0 / 4100.0, 0.0, 0.0, -341.0 / 164.0, 4496.0 / 1025.0, -301.0 / 82.0, 2133.0 / 4100.0, 45.0 / 82.0, 45.0 / 164.0, 18.0 / 41.0 },
+        { 3.0 / 205.0, 0.0, 0.0, 0.0, 0.0, -6.0 / 41.0, -3.0 / 205.0, -3.0 / 41.0, 3.0 / 41.0, 6.0 / 41.0, 0.0 },
+        { -1777.0 / 4100.0, 0.0, 0.0, -341.0 / 164.0, 4496.0 / 1025.0, -289.0 / 82.0, 2193.0 / 4100.0, 51.0 / 82.0, 33.0 / 164.0, 12.0 / 41.0, 0.0, 1.0 },
+    },
+    .b = { 0.0, 0.0, 0.0, 0.0, 0.0, 34.0 / 105.0, 9.0 / 35.0, 9.0 / 35.0, 9.0 / 280.0, 9.0 / 280.0, 0.0, 41.0 / 840.0, 41.0 / 840.0 },
+    .e = { -41.0 / 840.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, -41.0 / 840.0, 41.0 / 840.0, 41.0 / 840.0 },
+    .exponent = 1.0 / 8.0,
+    .fsal = 0,
+};
+
+const char *const integrator_names[INTEGRATORS] = {
+    [INTEGRATOR_RKF78] = "rkf78",
+    [INTEGRATOR_DOPRI54] = "dopri54",
+    [INTEGRATOR_BS32] = "bs32",
+    [INTEGRATOR_ROS23] = "ros23",
+    [INTEGRATOR_AUTO] = "auto",
+};
+
+const char *const controller_names[CONTROLLERS] = {
+    [CONTROLLER_ELEMENTARY] = "elementary",
+    [CONTROLLER_PI] = "pi",
+    [CONTROLLER_PID] = "pid",
+};
+
+/* Bounds of the factor by which the step changes after a step.
+ */
+static const double factor_min = 0.2;
+static const double factor_max = 5.0;
+
+/* Gains of each controller: the exponents of the ratios of the error to the
+ * tolerance of the step just accepted and of the two before it, in units of
+ * the exponent of the method. Gustafsson's PI has an integral gain of 0.3
+ * and a proportional one of 0.4.
+ */
+static const double controller_gains[CONTROLLERS][3] = {
+    [CONTROLLER_ELEMENTARY] = { 1.0, 0.0, 0.0 },
+    [CONTROLLER_PI] = { 0.7, -0.4, 0.0 },
+    [CONTROLLER_PID] = { 0.49, -0.34, 0.1 },
+};
+
+/* Smallest ratio of the error to the tolerance the controllers take, so that
+ * an exact step does not blow up the history.
+ */
+static const double ratio_min = 1.0e-10;
+
+/* Factor of the retry of a step rejected with an error `ratio` times the
+ * tolerance, the elementary one whatever the controller, as a rejection
+ * calls for the quickest reaction.
+ */
+static inline double rejected_factor(const double ratio, const double exponent) {
+    return fmax(0.9 * pow(ratio, -exponent), factor_min);
+}
+
+/* Factor of the step after one accepted with an error `ratio` times the
+ * tolerance, recording the ratio in the history of the controller.
+ */
+static double accepted_factor(Integrator *const integrator, const double ratio, const double exponent) {
+    const double *const gains = controller_gains[integrator->controller];
+    const double current = fmax(ratio, ratio_min);
+    double factor = 0.9 * pow(current, -gains[0] * exponent);
+
+    if(integrator->controller != CONTROLLER_ELEMENTARY) {
+        factor *= pow(integrator->ratios[0], -gains[1] * exponent) * pow(integrator->ratios[1], -gains[2] * exponent);
+    }
+    integrator->ratios[1] = integrator->ratios[0];
+    integrator->ratios[0] = current;
+
+    return fmin(fmax(factor, factor_min), factor_max);
+}
+
+/* Clamp the absolute value of `h` into `[h_min, h_max]`.
+ */
+static inline double clamp_step(const double h, const double h_min, const double h_max) {
+    const double size = fmin(fmax(fabs(h), h_min), h_max);
+
+    return h < 0.0 ? -size : size;
+}
+
+/* Step of the embedded pair `tableau`, with the same error control as RKF78:
+ * retry with smaller steps until the error is below the tolerance (relative
+ * "retarded two digits" for large values) or the step is minimal, and the
+ * next step set by the controller of the integration.
+ */
+static int tableau_step(const Tableau *const tableau, Integrator *const integrator, double *const t, double *const x, double *const h, const ScalarField field, void *const params) {
+    double k[TABLEAU_MAX_STAGES];
+    double x_new;
+    double error;
+    double tolerance;
+
+    if(!integrator->has_derivative) {
+        field(*t, *x, k, params);
+        integrator->derivative = k[0];
+        integrator->has_derivative = 1;
+    }
+
+    while(1) {
+        k[0] = integrator->derivative;
+        for(unsigned stage = 1; stage < tableau->stages; stage++) {
+            double y = 0.0;
+            for(unsigned iter = 0; iter < stage; iter++) {
+                y += tableau->a[stage][iter] * k[iter];
+            }
+            field(*t + tableau->c[stage] * *h, *x + *h * y, k + stage, params);
+        }
+
+        double solution = 0.0;
+        double estimate = 0.0;
+        for(unsigned stage = 0; stage < tableau->stages; stage++) {
+            solution += tableau->b[stage] * k[stage];
+            estimate += tableau->e[stage] * k[stage];
+        }
+        x_new = *x + *h * solution;
+        error = fabs(*h * estimate);
+
+        if(isnan(x_new) || isnan(error)) {
+            return 66;
+        }
+
+        tolerance = integrator->tolerance * (1.0 + fabs(x_new) / 100.0);
+        if(fabs(*h) <= integrator->step_min || error < tolerance) {
+            break;
+        }
+
+        integrator->rejected++;
+        *h = clamp_step(*h * rejected_factor(error / tolerance, tableau->exponent), integrator->step_min, integrator->step_max);
+    }
+
+    *t += *h;
+    *x = x_new;
+    if(tableau->fsal) {
+        integrator->derivative = k[tableau->stages - 1];
+    } else {
+        integrator->has_derivative = 0;
+    }
+
+    *h = clamp_step(*h * accepted_factor(integrator, error / tolerance, tableau->exponent), integrator->step_min, integrator->step_max);
+
+    return 0;
+}
+
+/* Field of a step of RKF78 counting its evaluations, to tell the attempts of
+ * the step, all of them of `RKF78_STAGES` evaluations.
+ */
+#define RKF78_STAGES (13)
+
+typedef struct {
+    ScalarField field;
+    void *params;
+    unsigned evaluations;
+} CountedField;
+
+static void counted_field(double t, double x, double *result, void *data) {
+    CountedField *const counted = (CountedField *) data;
+
+    counted->evaluations++;
+    counted->field(t, x, result, counted->params);
+}
+
+/* Step of RKF78, counting the attempts it rejected, or of its tableau with
+ * any controller but the elementary one.
+ */
+static int rkf78_step(Integrator *const integrator, double *const t, double *const x, double *const h, const ScalarField field, void *const params) {
+    if(integrator->controller != CONTROLLER_ELEMENTARY) {
+        return tableau_step(&rkf78, integrator, t, x, h, field, params);
+    }
+
+    CountedField counted = { .field = field, .params = params, .evaluations = 0 };
+    double error;
+
+    integrator->has_derivative = 0;
+    const int err = RKF78(t, x, h, &error, integrator->step_min, integrator->step_max, integrator->tolerance, &counted, counted_field);
+    integrator->rejected += counted.evaluations / RKF78_STAGES - 1;
+
+    return err;
+}
+
+/* Derivative of `field` with respect to `x` at `(t, x)`.
+ */
+static double field_jacobian(const Integrator *const integrator, const double t, const double x, const double f, const ScalarField field, void *const params) {
+    double result;
+
+    if(integrator->jacobian != NULL) {
+        integrator->jacobian(t, x, &result, params);
+        return result;
+    }
+
+    const double dx = sqrt(DBL_EPSILON) * fmax(fabs(x), 1.0);
+    field(t, x + dx, &result, params);
+    return (result - f) / dx;
+}
+
+/* Step of the Rosenbrock 2(3) pair of ode23s for an autonomous field, with
+ * the Jacobian `jacobian` at `*x` and the same error control as RKF78.
+ *
+ * Being linearly implicit, a scalar step costs a division per stage instead
+ * of a nonlinear solve, and its L-stability lets it take steps far beyond the
+ * stability region of the explicit methods where the field is stiff.
+ */
+static int rosenbrock_step(Integrator *const integrator, const double jacobian, double *const t, double *const x, double *const h, const ScalarField field, void *const params) {
+    static const double d = 0.29289321881345247560; /* 1 / (2 + sqrt(2)) */
+    static const double e32 = 7.41421356237309504880; /* 6 + sqrt(2) */
+    double x_new;
+    double f_new;
+    double error;
+    double tolerance;
+
+    if(!integrator->has_derivative) {
+        field(*t, *x, &(integrator->derivative), params);
+        integrator->has_derivative = 1;
+    }
+    const double f0 = integrator->derivative;
+
+    while(1) {
+        const double w = 1.0 / (1.0 - *h * d * jacobian);
+        double f1;
+
+        const double k1 = w * f0;
+        field(*t + 0.5 * *h, *x + 0.5 * *h * k1, &f1, params);
+        const double k2 = w * (f1 - k1) + k1;
+        x_new = *x + *h * k2;
+        field(*t + *h, x_new, &f_new, params);
+        const double k3 = w * (f_new - e32 * (k2 - f1) - 2.0 * (k1 - f0));
+        error = fabs(*h / 6.0 * (k1 - 2.0 * k2 + k3));
+
+        if(isnan(x_new) || isnan(error)) {
+            return 66;
+        }
+
+        tolerance = integrator->tolerance * (1.0 + fabs(x_new) / 100.0);
+        if(fabs(*h) <= integrator->step_min || error < tolerance) {
+            break;
+        }
+
+        integrator->rejected++;
+        *h = clamp_step(*h * rejected_factor(error / tolerance, 1.0 / 3.0), integrator->step_min, integrator->step_max);
+    }
+
+    *t += *h;
+    *x = x_new;
+    integrator->derivative = f_new;
+
+    *h = clamp_step(*h * accepted_factor(integrator, error / tolerance, 1.0 / 3.0), integrator->step_min, integrator->step_max);
+
+    return 0;
+}
+
+/* Step of RKF78, or of the Rosenbrock method while the field is stiff: while
+ * `-h * J` at the longest step exceeds the stability bound of RKF78, which
+ * would otherwise be stuck at the minimum step, rejecting and going unstable.
+ * The Jacobian is only checked once RKF78 shortens its steps.
+ *
+ * Switching back waits for `-h * J` to fall below half the bound, so that a
+ * trajectory on the edge does not alternate between both methods.
+ */
+static int auto_step(Integrator *const integrator, double *const t, double *const x, double *const h, const ScalarField field, void *const params) {
+    /* RKF78 at its longest step is not held back by stiffness */
+    if(!integrator->stiff && fabs(*h) >= integrator->step_max) {
+        return rkf78_step(integrator, t, x, h, field, params);
+    }
+
+    double f = integrator->derivative;
+    if(!integrator->has_derivative && integrator->jacobian == NULL) {
+        field(*t, *x, &f, params);
+        integrator->derivative = f;
+        integrator->has_derivative = 1;
+    }
+
+    /* Other controllers bound the step by the interval of the problem alone,
+     * so the step they propose is the longest the accuracy allows */
+    const double horizon = integrator->controller == CONTROLLER_ELEMENTARY ? integrator->step_max : fabs(*h);
+    const double jacobian = field_jacobian(integrator, *t, *x, f, field, params);
+    const double stiffness = -horizon * jacobian;
+    if(integrator->stiff) {
+        integrator->stiff = stiffness > 0.5 * STIFFNESS_BOUND;
+    } else {
+        integrator->stiff = stiffness > STIFFNESS_BOUND;
+    }
+
+    if(integrator->stiff) {
+        integrator->stiff_steps++;
+        return rosenbrock_step(integrator, jacobian, t, x, h, field, params);
+    }
+
+    return rkf78_step(integrator, t, x, h, field, params);
+}
+
+void integrator_init(Integrator *const integrator, const IntegratorMethod method, const double tolerance, const double step_min, const double step_max) {
+    integrator->method = method;
+    integrator->tolerance = tolerance;
+    integrator->step_min = step_min;
+    integrator->step_max = step_max;
+    integrator->derivative = 0.0;
+    integrator->has_derivative = 0;
+    integrator->jacobian = NULL;
+    integrator->stiff = 0;
+    integrator->stiff_steps = 0;
+    integrator->n_switches = 0;
+    integrator->accepted = 0;
+    integrator->rejected = 0;
+    integrator->events = 0;
+    integrator->controller = CONTROLLER_ELEMENTARY;
+    integrator->ratios[0] = 1.0;
+    integrator->ratios[1] = 1.0;
+}
+
+void integrator_set_controller(Integrator *const integrator, const StepController controller) {
+    integrator->controller = controller;
+}
+
+void integrator_set_jacobian(Integrator *const integrator, const ScalarField jacobian) {
+    integrator->jacobian = jacobian;
+}
+
+void integrator_add_switch(Integrator *const integrator, const SwitchingFunction switching) {
+    if(integrator->n_switches < INTEGRATOR_MAX_SWITCHES) {
+        integrator->switches[integrator->n_switches++] = switching;
+    }
+}
+
+/* Step of the method of the integration.
+ */
+static int method_step(Integrator *const integrator, double *const t, double *const x, double *const h, const ScalarField field, void *const params) {
+    switch(integrator->method) {
+    case INTEGRATOR_DOPRI54:
+        return tableau_step(&dopri54, integrator, t, x, h, field, params);
+    case INTEGRATOR_BS32:
+        return tableau_step(&bs32, integrator, t, x, h, field, params);
+    case INTEGRATOR_ROS23:
+        if(!integrator->has_derivative) {
+            field(*t, *x, &(integrator->derivative), params);
+            integrator->has_derivative = 1;
+        }
+        return rosenbrock_step(integrator, field_jacobian(integrator, *t, *x, integrator->derivative, field, params), t, x, h, field, params);
+    case INTEGRATOR_AUTO:
+        return auto_step(integrator, t, x, h, field, params);
+    default:
+        return rkf78_step(integrator, t, x, h, field, params);
+    }
+}
+
+/* Cubic Hermite interpolant of a step from `x0` to `x1` of length `h`, with
+ * derivatives `f0` and `f1` at both ends, at the fraction `theta` of it.
+ */
+static inline double hermite(const double theta, const double h, const double x0, const double f0, const double x1, const double f1) {
+    const double theta2 = theta * theta;
+    const double theta3 = theta2 * theta;
+
+    return (2.0 * theta3 - 3.0 * theta2 + 1.0) * x0 + (theta3 - 2.0 * theta2 + theta) * h * f0
+        + (3.0 * theta2 - 2.0 * theta3) * x1 + (theta3 - theta2) * h * f1;
+}
+
+/* Iterations of the search of a crossing, and the width of the bracket of the
+ * fraction of the step at which it stops.
+ */
+#define EVENT_ITERATIONS (60)
+#define EVENT_TOLERANCE (1.0e-12)
+
+/* Fraction of the step from `(t0, x0)` to `(t0 + h, x1)` at which the first
+ * switching function changing sign between both ends crosses zero along the
+ * Hermite interpolant of the step, or `1` if none changes sign.
+ *
+ * Each crossing is bracketed between both ends and found with the Illinois
+ * variant of the false position method. The derivative `f0` at the start of
+ * the step is `*f0` unless `has_f0` is zero, and both are evaluated only if
+ * some switching function changes sign.
+ */
+static double locate_event(const Integrator *const integrator, const double t0, const double x0, const double h, const double x1, double f0, const int has_f0, const ScalarField field, void *const params) {
+    double fraction = 1.0;
+    double f1 = 0.0;
+    int has_derivatives = 0;
+
+    for(unsigned iter = 0; iter < integrator->n_switches; iter++) {
+        const SwitchingFunction switching = integrator->switches[iter];
+        double a = 0.0;
+        double b = 1.0;
+        double g_a = switching(t0, x0, params);
+        double g_b = switching(t0 + h, x1, params);
+
+        if(!((g_a < 0.0 && g_b > 0.0) || (g_a > 0.0 && g_b < 0.0))) {
+            continue;
+        }
+
+        if(!has_derivatives) {
+            if(!has_f0) {
+                field(t0, x0, &f0, params);
+            }
+            if(integrator->has_derivative) {
+                f1 = integrator->derivative;
+            } else {
+                field(t0 + h, x1, &f1, params);
+            }
+            has_derivatives = 1;
+        }
+
+        /* Halve the value kept at the end that does not move, so that the
+         * bracket shrinks from both sides */
+        int side = 0;
+        for(unsigned step = 0; step < EVENT_ITERATIONS && b - a > EVENT_TOLERANCE; step++) {
+            const double theta = (a * g_b - b * g_a) / (g_b - g_a);
+            const double g = switching(t0 + theta * h, hermite(theta, h, x0, f0, x1, f1), params);
+
+            if(g == 0.0) {
+                a = theta;
+                b = theta;
+            } else if((g < 0.0) == (g_a < 0.0)) {
+                a = theta;
+                g_a = g;
+                if(side == -1) {
+                    g_b *= 0.5;
+                }
+                side = -1;
+            } else {
+                b = theta;
+                g_b = g;
+                if(side == 1) {
+                    g_a *= 0.5;
+                }
+                side = 1;
+            }
+        }
+
+        fraction = fmin(fraction, b);
+    }
+
+    return fraction;
+}
+
+/* Whether some switching function has a different sign at `x0` and at `x1`.
+ */
+static int crossed_switch(const Integrator *const integrator, const double t0, const double x0, const double t1, const double x1, void *const params) {
+    for(unsigned iter = 0; iter < integrator->n_switches; iter++) {
+        if((integrator->switches[iter](t0, x0, params) > 0.0) != (integrator->switches[iter](t1, x1, params) > 0.0)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int integrator_step(Integrator *const integrator, double *const t, double *const x, double *const h, const ScalarField field, void *const params) {
+    const double t0 = *t;
+    const double x0 = *x;
+
+    if(integrator->n_switches == 0) {
+        const int err = method_step(integrator, t, x, h, field, params);
+        if(err == 0) {
+            integrator->accepted++;
+        }
+        return err;
+    }
+
+    const Integrator start = *integrator;
+    int err = method_step(integrator, t, x, h, field, params);
+    if(err != 0) {
+        return err;
+    }
+
+    /* Redo a step straddling a switching surface so that it ends on the
+     * crossing, which is then left from the surface with the next step on the
+     * branch of the other side. The step redone may still be shortened by the
+     * error control, stopping before the crossing */
+    const double taken = *t - t0;
+    const double fraction = locate_event(integrator, t0, x0, taken, *x, start.derivative, start.has_derivative, field, params);
+    if(fraction < 1.0 && fabs(taken) * fraction > integrator->step_min) {
+        const unsigned long rejected = integrator->rejected + 1;
+
+        *integrator = start;
+        integrator->rejected = rejected;
+        *t = t0;
+        *x = x0;
+        *h = taken * fraction;
+        err = method_step(integrator, t, x, h, field, params);
+        if(err != 0) {
+            return err;
+        }
+    }
+    integrator->accepted++;
+    integrator->events += crossed_switch(integrator, t0, x0, *t, *x, params);
+
+    return 0;
+}
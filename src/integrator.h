@@ -0,0 +1,138 @@
+#pragma once
+
+/* Right hand side of a scalar ODE, x' = f(t, x), with the signature of the
+ * vector fields of RKF78.
+ */
+typedef void (*ScalarField)(double t, double x, double *result, void *params);
+
+/* Switching function of a piecewise field, whose sign tells the branch of
+ * the field in use at `(t, x)`.
+ */
+typedef double (*SwitchingFunction)(double t, double x, void *params);
+
+/* Most switching functions an integration can locate the crossings of.
+ */
+#define INTEGRATOR_MAX_SWITCHES (4)
+
+/* Methods integrating the model.
+ */
+typedef enum {
+    /* Runge-Kutta-Fehlberg 7(8), 13 stages per step.
+     */
+    INTEGRATOR_RKF78,
+    /* Dormand-Prince 5(4), 6 new stages per step thanks to FSAL.
+     */
+    INTEGRATOR_DOPRI54,
+    /* Bogacki-Shampine 3(2), 3 new stages per step thanks to FSAL.
+     */
+    INTEGRATOR_BS32,
+    /* Linearly implicit Rosenbrock 2(3) of Shampine and Reichelt, L-stable,
+     * with 2 new evaluations and one of the Jacobian per step thanks to FSAL.
+     */
+    INTEGRATOR_ROS23,
+    /* RKF78 switching to the Rosenbrock method while the problem is stiff.
+     */
+    INTEGRATOR_AUTO,
+    INTEGRATORS,
+} IntegratorMethod;
+
+/* Command line names of the integrators.
+ */
+extern const char *const integrator_names[INTEGRATORS];
+
+/* Largest `-h * J` an explicit step of RKF78 takes in its stability region,
+ * above which `INTEGRATOR_AUTO` considers the problem stiff.
+ */
+#define STIFFNESS_BOUND (4.0)
+
+/* Controllers of the step size of the adaptive methods, setting the next step
+ * from the errors of the last accepted ones.
+ */
+typedef enum {
+    /* The step of RKF78, `0.9 * (tol / err)^(1/k)`, reacting to the last error
+     * alone. RKF78 keeps its own implementation with this controller.
+     */
+    CONTROLLER_ELEMENTARY,
+    /* Proportional-integral controller of Gustafsson, weighting the last two
+     * errors, which damps the oscillation of the steps between acceptance
+     * and rejection where the error estimate is not smooth.
+     */
+    CONTROLLER_PI,
+    /* Proportional-integral-derivative controller, weighting the last three
+     * errors.
+     */
+    CONTROLLER_PID,
+    CONTROLLERS,
+} StepController;
+
+/* Command line names of the step size controllers.
+ */
+extern const char *const controller_names[CONTROLLERS];
+
+/* State of an adaptive integration of a scalar ODE.
+ *
+ * Methods whose last stage is the derivative at the new point (first same as
+ * last, FSAL) keep it here, so that the next step, or the retry of a rejected
+ * one, starts without evaluating the field.
+ */
+typedef struct {
+    IntegratorMethod method;
+    double tolerance;
+    double step_min;
+    double step_max;
+    double derivative;
+    int has_derivative;
+    /* Derivative of the field with respect to `x`, with the signature of the
+     * field, or `NULL` to approximate it with finite differences.
+     */
+    ScalarField jacobian;
+    /* Whether `INTEGRATOR_AUTO` is on the Rosenbrock method, and the number
+     * of steps it took with it so far.
+     */
+    int stiff;
+    unsigned long stiff_steps;
+    /* Switching functions of the field.
+     */
+    SwitchingFunction switches[INTEGRATOR_MAX_SWITCHES];
+    unsigned n_switches;
+    /* Steps accepted and rejected so far, and switching surfaces crossed.
+     */
+    unsigned long accepted;
+    unsigned long rejected;
+    unsigned long events;
+    /* Controller of the steps, and the ratios of the error to the tolerance
+     * of the last two accepted steps it weights.
+     */
+    StepController controller;
+    double ratios[2];
+} Integrator;
+
+/* Start an integration with `method`, keeping the local error below
+ * `tolerance` with steps between `step_min` and `step_max`, as in RKF78.
+ */
+void integrator_init(Integrator *const integrator, const IntegratorMethod method, const double tolerance, const double step_min, const double step_max);
+
+/* Use the analytic Jacobian `jacobian` of the field in the implicit steps.
+ */
+void integrator_set_jacobian(Integrator *const integrator, const ScalarField jacobian);
+
+/* Control the steps with `controller` instead of the elementary controller.
+ */
+void integrator_set_controller(Integrator *const integrator, const StepController controller);
+
+/* Register the switching function `switching` of a piecewise field, whose
+ * field is not smooth where it changes sign.
+ *
+ * Steps ending where it has changed sign are redone to end on the crossing,
+ * found by the root of the function along the Hermite interpolant of the step,
+ * so that no step accepted spans the kink, and the next step starts on the
+ * other branch.
+ */
+void integrator_add_switch(Integrator *const integrator, const SwitchingFunction switching);
+
+/* Advance `*t` and `*x` one step of at most `*h`, updating `*h` with the
+ * step proposed for the next one.
+ *
+ * Returns `0` on success and the error code of RKF78 otherwise.
+ */
+int integrator_step(Integrator *const integrator, double *const t, double *const x, double *const h, const ScalarField field, void *const params);
@@ -1,15 +1,668 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "archive.h"
+#include "batch.h"
+#include "bootstrap.h"
+#include "cma-es.h"
+#include "ensemble.h"
 #include "equations.h"
 #include "genetic-algorithm.h"
+#include "genetics.h"
+#include "genotype-benchmark.h"
 #include "genotype.h"
+#include "integrator-comparison.h"
+#include "integrator.h"
+#include "math-benchmark.h"
+#include "metrics.h"
+#include "perf-counters.h"
 #include "randombits.h"
+#include "real-coded.h"
+#include "report.h"
+#include "scheduler.h"
+#include "server.h"
+#include "stochastic.h"
+#include "trace.h"
+#include "tuner.h"
 
-int main(void) {
-    randomize();
-    Individual best = run_genetic_algorithm(1000);
-    Phenotype p = genoype_to_phenotype(best.genotype);
+/* Optimisation engine fitting the model.
+ */
+typedef enum {
+    ENGINE_BINARY,
+    ENGINE_REAL,
+    ENGINE_CMAES,
+} Engine;
+
+/* Command line options, all of them optional.
+ */
+typedef struct {
+    Engine engine;
+    RestartStrategy restarts;
+    GeneticAlgorithmConfig config;
+    BootstrapConfig bootstrap;
+    TunerConfig tuner;
+    /* Paths simulated from the fit, `0` for none.
+     */
+    SdeConfig sde;
+    unsigned n_threads;
+    unsigned n_runs;
+    long seed;
+    double target;
+    const char *stats;
+    const char *serve;
+    const char *batch;
+    const char *archive;
+    const char *schema;
+    /* Genotypes of the benchmark of the genetic operators, `0` to run.
+     */
+    unsigned benchmark;
+    /* Values of the benchmark of the math kernels, `0` to run.
+     */
+    unsigned benchmark_math;
+    const char *trace;
+    int trace_compress;
+    /* Trace to print instead of running, and the generation or individual
+     * to print of it, unless negative.
+     */
+    const char *read_trace;
+    long trace_generation;
+    long trace_individual;
+    /* Page of live metrics of the run, and page to print instead of running.
+     */
+    const char *metrics;
+    const char *read_metrics;
+    int perf;
+    int compare;
+} Options;
+
+static void usage(const char *const name) {
+    fprintf(stderr, "Usage: %s [options]\n"
+            "\t--engine E\toptimisation engine, binary (default), real or cmaes\n"
+            "\t--restarts R\trestart strategy of cmaes, none, ipop (default) or bipop\n"
+            "\t--individuals N\tpopulation size (default 1000)\n"
+            "\t--generations N\tnumber of generations (default 1000)\n"
+            "\t--encoding E\tgenotype encoding, binary (default) or gray\n"
+            "\t--schema FILE\tbits, bounds and encoding of every parameter, one 'name bits lower upper [encoding]' per line\n"
+            "\t--benchmark-genotype N\ttime the genetic operators on N genotypes\n"
+            "\t--benchmark-math N\tcheck and time the vectorised math kernels on N values\n"
+            "\t--crossover C\tcrossover operator, one-point (default), two-point or uniform\n"
+            "\t--tournament K\tindividuals of the tournaments choosing the parents (default 10)\n"
+            "\t--mutation P\tmutation parameter, the lower the more bits flipped (default 0.5)\n"
+            "\t--diversity-threshold H\trelative Hamming distance reacting to convergence (default 0, never)\n"
+            "\t--initialization S\tsampling of the initial population, random (default), sobol or latin\n"
+            "\t--survivors S\tsurvivor selection, generational (default), plus or elitism\n"
+            "\t--elite K\tparents kept by the elitism survivor selection (default 2)\n"
+            "\t--integrator I\tintegrator of the model, rkf78 (default), dopri54, bs32, ros23 or auto\n"
+            "\t--controller C\tstep size controller, elementary (default), pi or pid\n"
+            "\t--events E\tlocate the crossings of x = delta in the integrations, off (default) or on\n"
+            "\t--compare-integrators\tcompare the cost and fitness ranking of every integrator\n"
+            "\t--screening F\tscreen children at low fidelity, confirming the best fraction F (default 0, off)\n"
+            "\t--diversity-trigger T\treaction to convergence, restart (default) or mutation\n"
+            "\t--archive FILE\treuse and extend the evaluations archived in FILE\n"
+            "\t--warm-start F\tseed the fraction F of the population from the archive (default 0)\n"
+            "\t--stats FILE\twrite the diversity of every generation to FILE\n"
+            "\t--trace FILE\twrite every population and its lineage to FILE\n"
+            "\t--trace-compress\tcompress the columns of the trace\n"
+            "\t--read-trace FILE\tprint a summary of every generation of the trace FILE\n"
+            "\t--trace-generation G\tprint every individual of generation G of the trace instead\n"
+            "\t--trace-individual I\tprint individual I of every generation of the trace instead\n"
+            "\t--metrics FILE\tpublish live metrics of the run, or of the jobs served, in the memory mapped FILE\n"
+            "\t--read-metrics FILE\tprint the metrics published in FILE by a running process\n"
+            "\t--bootstrap B\tfit B bootstrap replicates of the dataset and report confidence intervals\n"
+            "\t--resampling R\treplicates of the bootstrap, cases (default) or residuals\n"
+            "\t--bootstrap-generations N\tgenerations of every replicate (default a tenth of --generations)\n"
+            "\t--confidence C\tcoverage of the bootstrap intervals (default 0.95)\n"
+            "\t--tune N\trace N configurations by successive halving on time to --target and print the best\n"
+            "\t--tune-seeds S\truns of every raced configuration (default 3)\n"
+            "\t--tune-eta E\tkeep one in E configurations after every rung (default 3)\n"
+            "\t--sde-paths N\tsimulate N paths of the fit with demographic noise and report its quantiles\n"
+            "\t--sde-years Y\tyears simulated (default those of the dataset)\n"
+            "\t--sde-steps K\tsteps of the paths per year (default 100)\n"
+            "\t--sde-noise V\tvariance of the yearly change of the population per bird (default 1)\n"
+            "\t--sde-scheme S\tscheme integrating the paths, euler or milstein (default)\n"
+            "\t--batch FILE\tfit every series of FILE, one 'name y0,y1,... [w0,w1,...]' per line\n"
+            "\t--serve PATH\tserve fit jobs on the Unix socket PATH, or on the standard input if -\n"
+            "\t--perf\t\tcollect hardware counters of fitness, breeding and selection\n"
+            "\t--threads N\tevaluation threads (default OpenMP's)\n"
+            "\t--seed N\tseed of the first run (default current time)\n"
+            "\t--ensemble R\trun R independent instances and report statistics\n"
+            "\t--target F\tfitness defining the time to target of an ensemble\n",
+            name);
+}
+
+/* Option running a mode other than a single fit, as dispatched by `main`, or
+ * `NULL` for a single fit.
+ */
+static const char *run_mode(const Options *const options) {
+    if(options->serve != NULL) {
+        return "--serve";
+    }
+    if(options->compare) {
+        return "--compare-integrators";
+    }
+    if(options->bootstrap.n_replicates > 0) {
+        return "--bootstrap";
+    }
+    if(options->tuner.n_configurations > 0) {
+        return "--tune";
+    }
+    if(options->batch != NULL) {
+        return "--batch";
+    }
+    if(options->n_runs > 0) {
+        return "--ensemble";
+    }
+    return NULL;
+}
+
+/* Option given that the run mode `mode` does not support, mostly those only
+ * a single fit supports, or `NULL` if none.
+ */
+static const char *single_run_option(const Options *const options, const char *const mode) {
+    if(options->engine == ENGINE_REAL) {
+        return "--engine real";
+    }
+    if(options->engine == ENGINE_CMAES) {
+        return "--engine cmaes";
+    }
+    if(options->trace != NULL) {
+        return "--trace";
+    }
+    if(options->stats != NULL) {
+        return "--stats";
+    }
+    if(options->sde.n_paths > 0) {
+        return "--sde-paths";
+    }
+    /* The server publishes the metrics of the job running */
+    if(options->metrics != NULL && strcmp(mode, "--serve") != 0) {
+        return "--metrics";
+    }
+    /* The other modes report the counters of all of their runs */
+    if(options->perf && (strcmp(mode, "--serve") == 0 || strcmp(mode, "--compare-integrators") == 0)) {
+        return "--perf";
+    }
+    return NULL;
+}
+
+/* Parse the command line into `options`, returning `0` on success.
+ */
+static int parse_options(const int argc, char *const *const argv, Options *const options) {
+    for(int iter = 1; iter < argc; iter++) {
+        if(strcmp(argv[iter], "--perf") == 0) {
+            options->perf = 1;
+            continue;
+        }
+        if(strcmp(argv[iter], "--compare-integrators") == 0) {
+            options->compare = 1;
+            continue;
+        }
+        if(strcmp(argv[iter], "--trace-compress") == 0) {
+            options->trace_compress = 1;
+            continue;
+        }
+        if(iter + 1 >= argc) {
+            return 1;
+        }
+
+        const char *const option = argv[iter];
+        const char *const value = argv[++iter];
+        if(strcmp(option, "--engine") == 0) {
+            if(strcmp(value, "binary") == 0) {
+                options->engine = ENGINE_BINARY;
+            } else if(strcmp(value, "real") == 0) {
+                options->engine = ENGINE_REAL;
+            } else if(strcmp(value, "cmaes") == 0) {
+                options->engine = ENGINE_CMAES;
+            } else {
+                return 1;
+            }
+        } else if(strcmp(option, "--restarts") == 0) {
+            if(strcmp(value, "none") == 0) {
+                options->restarts = RESTART_NONE;
+            } else if(strcmp(value, "ipop") == 0) {
+                options->restarts = RESTART_IPOP;
+            } else if(strcmp(value, "bipop") == 0) {
+                options->restarts = RESTART_BIPOP;
+            } else {
+                return 1;
+            }
+        } else if(strcmp(option, "--individuals") == 0) {
+            options->config.n_individuals = strtoul(value, NULL, 10);
+        } else if(strcmp(option, "--generations") == 0) {
+            options->config.n_generations = strtoul(value, NULL, 10);
+        } else if(strcmp(option, "--encoding") == 0) {
+            if(strcmp(value, "binary") == 0) {
+                options->config.encoding = ENCODING_BINARY;
+            } else if(strcmp(value, "gray") == 0) {
+                options->config.encoding = ENCODING_GRAY;
+            } else {
+                return 1;
+            }
+        } else if(strcmp(option, "--crossover") == 0) {
+            if(strcmp(value, "one-point") == 0) {
+                options->config.crossover = CROSSOVER_ONE_POINT;
+            } else if(strcmp(value, "two-point") == 0) {
+                options->config.crossover = CROSSOVER_TWO_POINT;
+            } else if(strcmp(value, "uniform") == 0) {
+                options->config.crossover = CROSSOVER_UNIFORM;
+            } else {
+                return 1;
+            }
+        } else if(strcmp(option, "--tournament") == 0) {
+            options->config.tournament_size = strtoul(value, NULL, 10);
+        } else if(strcmp(option, "--mutation") == 0) {
+            options->config.mutation = strtod(value, NULL);
+        } else if(strcmp(option, "--diversity-threshold") == 0) {
+            options->config.diversity_threshold = strtod(value, NULL);
+        } else if(strcmp(option, "--initialization") == 0) {
+            if(strcmp(value, "random") == 0) {
+                options->config.initialization = INITIALIZATION_RANDOM;
+            } else if(strcmp(value, "sobol") == 0) {
+                options->config.initialization = INITIALIZATION_SOBOL;
+            } else if(strcmp(value, "latin") == 0) {
+                options->config.initialization = INITIALIZATION_LATIN;
+            } else {
+                return 1;
+            }
+        } else if(strcmp(option, "--survivors") == 0) {
+            if(strcmp(value, "generational") == 0) {
+                options->config.survivors = SURVIVORS_GENERATIONAL;
+            } else if(strcmp(value, "plus") == 0) {
+                options->config.survivors = SURVIVORS_PLUS;
+            } else if(strcmp(value, "elitism") == 0) {
+                options->config.survivors = SURVIVORS_ELITISM;
+            } else {
+                return 1;
+            }
+        } else if(strcmp(option, "--elite") == 0) {
+            options->config.n_elite = strtoul(value, NULL, 10);
+        } else if(strcmp(option, "--integrator") == 0) {
+            unsigned method = 0;
+            while(method < INTEGRATORS && strcmp(value, integrator_names[method]) != 0) {
+                method++;
+            }
+            if(method == INTEGRATORS) {
+                return 1;
+            }
+            options->config.integrator = (IntegratorMethod) method;
+        } else if(strcmp(option, "--controller") == 0) {
+            unsigned controller = 0;
+            while(controller < CONTROLLERS && strcmp(value, controller_names[controller]) != 0) {
+                controller++;
+            }
+            if(controller == CONTROLLERS) {
+                return 1;
+            }
+            options->config.controller = (StepController) controller;
+        } else if(strcmp(option, "--events") == 0) {
+            if(strcmp(value, "on") == 0) {
+                options->config.event_location = 1;
+            } else if(strcmp(value, "off") == 0) {
+                options->config.event_location = 0;
+            } else {
+                return 1;
+            }
+        } else if(strcmp(option, "--screening") == 0) {
+            options->config.screening = strtod(value, NULL);
+        } else if(strcmp(option, "--diversity-trigger") == 0) {
+            if(strcmp(value, "restart") == 0) {
+                options->config.diversity_trigger = DIVERSITY_RESTART;
+            } else if(strcmp(value, "mutation") == 0) {
+                options->config.diversity_trigger = DIVERSITY_MUTATION;
+            } else {
+                return 1;
+            }
+        } else if(strcmp(option, "--archive") == 0) {
+            options->archive = value;
+        } else if(strcmp(option, "--warm-start") == 0) {
+            options->config.warm_start = strtod(value, NULL);
+        } else if(strcmp(option, "--bootstrap") == 0) {
+            options->bootstrap.n_replicates = strtoul(value, NULL, 10);
+        } else if(strcmp(option, "--resampling") == 0) {
+            if(strcmp(value, "cases") == 0) {
+                options->bootstrap.resampling = RESAMPLING_CASES;
+            } else if(strcmp(value, "residuals") == 0) {
+                options->bootstrap.resampling = RESAMPLING_RESIDUALS;
+            } else {
+                return 1;
+            }
+        } else if(strcmp(option, "--bootstrap-generations") == 0) {
+            options->bootstrap.n_generations = strtoul(value, NULL, 10);
+        } else if(strcmp(option, "--confidence") == 0) {
+            options->bootstrap.confidence = strtod(value, NULL);
+        } else if(strcmp(option, "--tune") == 0) {
+            options->tuner.n_configurations = strtoul(value, NULL, 10);
+        } else if(strcmp(option, "--tune-seeds") == 0) {
+            options->tuner.n_seeds = strtoul(value, NULL, 10);
+        } else if(strcmp(option, "--tune-eta") == 0) {
+            options->tuner.eta = strtoul(value, NULL, 10);
+        } else if(strcmp(option, "--sde-paths") == 0) {
+            options->sde.n_paths = strtoul(value, NULL, 10);
+        } else if(strcmp(option, "--sde-years") == 0) {
+            options->sde.n_years = strtoul(value, NULL, 10);
+        } else if(strcmp(option, "--sde-steps") == 0) {
+            options->sde.steps_per_year = strtoul(value, NULL, 10);
+        } else if(strcmp(option, "--sde-noise") == 0) {
+            options->sde.noise = strtod(value, NULL);
+        } else if(strcmp(option, "--sde-scheme") == 0) {
+            unsigned scheme = 0;
+            while(scheme < SDE_SCHEMES && strcmp(value, sde_scheme_names[scheme]) != 0) {
+                scheme++;
+            }
+            if(scheme == SDE_SCHEMES) {
+                return 1;
+            }
+            options->sde.scheme = (SdeScheme) scheme;
+        } else if(strcmp(option, "--batch") == 0) {
+            options->batch = value;
+        } else if(strcmp(option, "--serve") == 0) {
+            options->serve = value;
+        } else if(strcmp(option, "--stats") == 0) {
+            options->stats = value;
+        } else if(strcmp(option, "--schema") == 0) {
+            options->schema = value;
+        } else if(strcmp(option, "--benchmark-genotype") == 0) {
+            options->benchmark = strtoul(value, NULL, 10);
+        } else if(strcmp(option, "--benchmark-math") == 0) {
+            options->benchmark_math = strtoul(value, NULL, 10);
+        } else if(strcmp(option, "--trace") == 0) {
+            options->trace = value;
+        } else if(strcmp(option, "--read-trace") == 0) {
+            options->read_trace = value;
+        } else if(strcmp(option, "--trace-generation") == 0) {
+            options->trace_generation = strtol(value, NULL, 10);
+        } else if(strcmp(option, "--trace-individual") == 0) {
+            options->trace_individual = strtol(value, NULL, 10);
+        } else if(strcmp(option, "--metrics") == 0) {
+            options->metrics = value;
+        } else if(strcmp(option, "--read-metrics") == 0) {
+            options->read_metrics = value;
+        } else if(strcmp(option, "--threads") == 0) {
+            options->n_threads = strtoul(value, NULL, 10);
+        } else if(strcmp(option, "--seed") == 0) {
+            options->seed = strtol(value, NULL, 10);
+        } else if(strcmp(option, "--ensemble") == 0) {
+            options->n_runs = strtoul(value, NULL, 10);
+        } else if(strcmp(option, "--target") == 0) {
+            options->target = strtod(value, NULL);
+        } else {
+            return 1;
+        }
+    }
+
+    /* Reject instead of silently ignoring the options of a single fit */
+    const char *const mode = run_mode(options);
+    const char *const unsupported = mode != NULL ? single_run_option(options, mode) : NULL;
+    if(unsupported != NULL) {
+        fprintf(stderr, "%s is not supported with %s\n", unsupported, mode);
+        return 1;
+    }
+    /* The statistics are those of the populations of the binary engine */
+    if(options->stats != NULL && options->engine != ENGINE_BINARY) {
+        fprintf(stderr, "--stats is not supported with --engine %s\n", options->engine == ENGINE_REAL ? "real" : "cmaes");
+        return 1;
+    }
+
+    return options->config.n_individuals < 3 || options->config.screening < 0.0 || options->config.screening > 1.0
+        || options->config.n_elite >= options->config.n_individuals
+        || options->config.tournament_size < 1 || options->config.tournament_size > 255
+        || options->tuner.n_seeds < 1 || options->tuner.eta < 2
+        || options->sde.steps_per_year < 1 || options->sde.noise < 0.0
+        || options->config.warm_start < 0.0 || options->config.warm_start > 1.0
+        || options->bootstrap.confidence <= 0.0 || options->bootstrap.confidence >= 1.0;
+}
+
+/* Print the steps per fitness evaluation taken since `before` with the
+ * controller of `config`.
+ */
+static void report_integration(FILE *const output, const GeneticAlgorithmConfig *const config, const IntegrationStats *const before) {
+    const IntegrationStats after = get_total_integration_stats();
+    const unsigned long predictions = after.predictions - before->predictions;
+
+    if(predictions > 0) {
+        fprintf(output, "Integration (%s controller): %.2f accepted and %.2f rejected steps per fitness evaluation, %lu evaluations\n",
+                controller_names[config->controller], (double) (after.accepted - before->accepted) / predictions,
+                (double) (after.rejected - before->rejected) / predictions, predictions);
+    }
+}
+
+/* Report the use of the archive of the run and close it, if any.
+ */
+static void close_archive(Archive *const archive) {
+    if(archive != NULL) {
+        archive_report(archive, stderr);
+        archive_close(archive);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    GAConfig defaults;
+    ga_config_default(&defaults);
+
+    Options options = {
+        .engine = ENGINE_BINARY,
+        .restarts = RESTART_IPOP,
+        .config = defaults.algorithm,
+        .bootstrap = {
+            .n_replicates = 0,
+            .n_generations = 0,
+            .resampling = RESAMPLING_CASES,
+            .confidence = 0.95,
+        },
+        .tuner = {
+            .n_configurations = 0,
+            .n_seeds = 3,
+            .eta = 3,
+            .target = 0.0,
+        },
+        .sde = {
+            .n_paths = 0,
+            .n_years = 0,
+            .steps_per_year = 100,
+            .noise = 1.0,
+            .scheme = SDE_MILSTEIN,
+        },
+        .n_threads = 0,
+        .n_runs = 0,
+        .seed = time(NULL),
+        .target = 0.0,
+        .stats = NULL,
+        .serve = NULL,
+        .batch = NULL,
+        .archive = NULL,
+        .schema = NULL,
+        .benchmark = 0,
+        .benchmark_math = 0,
+        .trace = NULL,
+        .trace_compress = 0,
+        .read_trace = NULL,
+        .trace_generation = -1,
+        .trace_individual = -1,
+        .metrics = NULL,
+        .read_metrics = NULL,
+        .perf = 0,
+        .compare = 0,
+    };
+    if(parse_options(argc, argv, &options) != 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if(options.schema != NULL) {
+        GenotypeSchema schema;
+        if(genotype_schema_load(options.schema, &schema) != 0 || genotype_schema_apply(&schema) != 0) {
+            return 1;
+        }
+    }
+
+    if(options.benchmark > 0) {
+        benchmark_genotype(options.benchmark, options.config.encoding, options.seed, stdout);
+        return 0;
+    }
+
+    if(options.benchmark_math > 0) {
+        return benchmark_math(options.benchmark_math, options.seed, stdout);
+    }
+
+    if(options.read_trace != NULL) {
+        return print_trace(options.read_trace, options.trace_generation, options.trace_individual, stdout);
+    }
+
+    if(options.read_metrics != NULL) {
+        return print_metrics(options.read_metrics, stdout);
+    }
+
+    if(options.archive != NULL) {
+        options.config.archive = archive_open(options.archive);
+        if(options.config.archive == NULL) {
+            return 1;
+        }
+    }
+
+    Scheduler scheduler;
+    scheduler_init(&scheduler, options.n_threads);
+
+    if(options.perf) {
+        perf_counters_enable();
+    }
+
+    if(options.serve != NULL) {
+        defaults.algorithm = options.config;
+        defaults.n_threads = options.n_threads;
+        defaults.seed = options.seed;
+
+        if(options.metrics != NULL && metrics_open(options.metrics, scheduler.n_threads, options.config.archive) != 0) {
+            close_archive(options.config.archive);
+            return 1;
+        }
+        const int err = run_server(options.serve, &defaults);
+        metrics_close();
+        close_archive(options.config.archive);
+        return err;
+    }
+
+    if(options.compare) {
+        const int err = compare_integrators(&(options.config), options.seed, &scheduler, stdout);
+        close_archive(options.config.archive);
+        return err;
+    }
+
+    if(options.bootstrap.n_replicates > 0) {
+        if(options.bootstrap.n_generations == 0) {
+            options.bootstrap.n_generations = options.config.n_generations > 10 ? options.config.n_generations / 10 : 1;
+        }
+        const int err = run_bootstrap(&(options.bootstrap), &(options.config), options.seed, &scheduler, stdout);
+        if(options.perf) {
+            perf_counters_report(stderr);
+            perf_counters_close();
+        }
+
+        close_archive(options.config.archive);
+        return err;
+    }
+
+    if(options.tuner.n_configurations > 0) {
+        options.tuner.target = options.target;
+        const int err = run_tuner(&(options.tuner), &(options.config), options.seed, &scheduler, stdout);
+        if(options.perf) {
+            perf_counters_report(stderr);
+            perf_counters_close();
+        }
+
+        close_archive(options.config.archive);
+        return err;
+    }
+
+    if(options.batch != NULL) {
+        const int err = run_batch(options.batch, stdout, &(options.config), options.seed, &scheduler);
+        if(options.perf) {
+            perf_counters_report(stderr);
+            perf_counters_close();
+        }
+
+        close_archive(options.config.archive);
+        return err;
+    }
+
+    if(options.n_runs > 0) {
+        EnsembleRun *runs = (EnsembleRun *) malloc(sizeof(EnsembleRun) * options.n_runs);
+        EnsembleSummary summary;
+
+        const IntegrationStats before = get_total_integration_stats();
+        if(run_ensemble(options.n_runs, &(options.config), options.target, options.seed, &scheduler, runs, &summary) != 0) {
+            if(options.perf) {
+                perf_counters_close();
+            }
+            free(runs);
+            close_archive(options.config.archive);
+            return 1;
+        }
+        print_ensemble(options.n_runs, &(options.config), runs, &summary);
+        report_integration(stdout, &(options.config), &before);
+        if(options.perf) {
+            perf_counters_report(stdout);
+            perf_counters_close();
+        }
+
+        free(runs);
+        close_archive(options.config.archive);
+        return 0;
+    }
+
+    if(options.metrics != NULL && metrics_open(options.metrics, scheduler.n_threads, options.config.archive) != 0) {
+        close_archive(options.config.archive);
+        return 1;
+    }
+
+    const IntegrationStats before = get_total_integration_stats();
+    Phenotype p;
+    if(options.engine == ENGINE_CMAES) {
+        RealIndividual best = run_cma_es(&(options.config), options.restarts, options.seed, &scheduler);
+        p = best.phenotype;
+    } else if(options.engine == ENGINE_REAL) {
+        RealIndividual best = run_real_coded_algorithm(&(options.config), options.seed, &scheduler);
+        p = best.phenotype;
+    } else {
+        FILE *stats = NULL;
+        if(options.stats != NULL) {
+            stats = fopen(options.stats, "w");
+            if(stats == NULL) {
+                perror(options.stats);
+                metrics_close();
+                close_archive(options.config.archive);
+                return 1;
+            }
+            report_diversity_header(stats);
+        }
+        if(options.trace != NULL) {
+            options.config.trace = trace_open(options.trace, options.config.n_individuals, options.config.encoding, options.trace_compress);
+            if(options.config.trace == NULL) {
+                if(stats != NULL) {
+                    fclose(stats);
+                }
+                metrics_close();
+                close_archive(options.config.archive);
+                return 1;
+            }
+        }
+
+        Individual best = run_genetic_algorithm(&(options.config), options.seed, &scheduler, stats);
+
+        if(stats != NULL) {
+            fclose(stats);
+        }
+        if(options.config.trace != NULL && trace_close(options.config.trace, stderr) != 0) {
+            metrics_close();
+            close_archive(options.config.archive);
+            return 1;
+        }
+        p = genoype_to_phenotype(best.genotype, options.config.encoding);
+    }
+    metrics_close();
+    report_integration(stdout, &(options.config), &before);
 
     // Phenotype p = (Phenotype) {
         // .phi = 0.252002,
@@ -19,14 +672,31 @@ int main(void) {
         // .delta = 11747.337260,
     // };
 
-    double x[12] = { 15329.0 };
-    const double y[12] = { 15329.0, 14177.0, 13031.0, 9762.0, 11271.0, 8688.0, 7571.0, 6983.0, 4778.0, 2067.0, 1586.0, 793.0 };
+    const Dataset *const data = options.config.dataset;
+    double x[DATASET_MAX_LENGTH] = { data->y[0] };
 
-    model_prediction(x[0], x, 12, &p);
+    model_prediction(x[0], x, data->length, &p, options.config.integrator, options.config.controller, options.config.event_location, FIDELITY_HIGH, NULL);
+
+    for(unsigned iter = 0; iter < data->length; iter++) {
+        printf("%d\t%lf\t%lf\n", iter, data->y[iter], x[iter]);
+    }
+
+    if(options.sde.n_paths > 0) {
+        if(options.sde.n_years == 0) {
+            options.sde.n_years = data->length - 1;
+        }
+        SdeYear *forecast = (SdeYear *) malloc(sizeof(SdeYear) * (options.sde.n_years + 1));
+
+        simulate_sde(&(options.sde), &p, data->y[0], options.seed, &scheduler, forecast);
+        print_sde(&(options.sde), forecast, data, stdout);
+        free(forecast);
+    }
 
-    for(unsigned iter = 0; iter < 12; iter++) {
-        printf("%d\t%lf\t%lf\n", iter, y[iter], x[iter]);
+    if(options.perf) {
+        perf_counters_report(stdout);
+        perf_counters_close();
     }
 
+    close_archive(options.config.archive);
     return 0;
 }
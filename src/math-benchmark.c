@@ -0,0 +1,243 @@
+#include "math-benchmark.h"
+#include "equations.h"
+#include "RKF78.h"
+#include "genotype.h"
+#include "math-kernels.h"
+#include "randombits.h"
+#include <float.h>
+#include <math.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Repetitions of every measurement, keeping the fastest one.
+ */
+#define BENCHMARK_REPETITIONS (5)
+
+/* Values sharing the parameters of the model in the kernels of the
+ * dispersal, and sharing a prediction in the weighted error, as long as the
+ * default dataset.
+ */
+#define DISPERSAL_CHUNK (1024)
+#define ERROR_CHUNK (11)
+
+/* Kernels checked and timed.
+ */
+typedef enum {
+    KERNEL_EIGHTHROOT,
+    KERNEL_SIGMOID,
+    KERNEL_DISPERSAL,
+    KERNEL_WEIGHTED_MAX_ERROR,
+    KERNELS,
+} Kernel;
+
+static const char *const kernel_names[KERNELS] = {
+    [KERNEL_EIGHTHROOT] = "eighthroot",
+    [KERNEL_SIGMOID] = "sigmoid",
+    [KERNEL_DISPERSAL] = "dispersal",
+    [KERNEL_WEIGHTED_MAX_ERROR] = "weighted_max_error",
+};
+
+/* Largest error of every vectorised kernel against the scalar version, in
+ * units in the last place, or in absolute value for the dispersal, whose
+ * distances in ulp grow where it nearly vanishes.
+ */
+static const struct {
+    uint64_t ulp;
+    double absolute;
+} kernel_bounds[KERNELS] = {
+    [KERNEL_EIGHTHROOT] = { .ulp = 5, .absolute = HUGE_VAL },
+    [KERNEL_SIGMOID] = { .ulp = 2, .absolute = HUGE_VAL },
+    [KERNEL_DISPERSAL] = { .ulp = UINT64_MAX, .absolute = 1.0e-15 },
+    [KERNEL_WEIGHTED_MAX_ERROR] = { .ulp = 0, .absolute = HUGE_VAL },
+};
+
+/* Inputs of every kernel.
+ */
+typedef struct {
+    unsigned n;
+    /* Arguments of the eighth root, as those of the step size control of
+     * RKF78, the populations of the dispersal and the predictions of the
+     * weighted error.
+     */
+    double *roots;
+    double *populations;
+    double *predictions;
+    /* Observations and weights of the weighted error.
+     */
+    double *observations;
+    double *weights;
+    /* Parameters `mu`, `sigma` and `delta` of every chunk.
+     */
+    double *parameters;
+} BenchmarkData;
+
+/* Distance between `a` and `b` in units in the last place.
+ */
+static uint64_t ulp_distance(const double a, const double b) {
+    int64_t x;
+    int64_t y;
+    memcpy(&x, &a, sizeof(x));
+    memcpy(&y, &b, sizeof(y));
+
+    /* Order the negative numbers below the positive ones */
+    x = x < 0 ? INT64_MIN - x : x;
+    y = y < 0 ? INT64_MIN - y : y;
+
+    return x > y ? (uint64_t) x - (uint64_t) y : (uint64_t) y - (uint64_t) x;
+}
+
+/* Run `kernel` on `data` with `kernels`, or the scalar versions if `NULL`,
+ * writing its results to `result`, returning their number.
+ */
+static unsigned run_kernel(const Kernel kernel, const MathKernels *const kernels, const BenchmarkData *const data, double *const result) {
+    const unsigned n = data->n;
+
+    switch(kernel) {
+        case KERNEL_EIGHTHROOT:
+            if(kernels == NULL) {
+                for(unsigned iter = 0; iter < n; iter++) {
+                    result[iter] = eighthroot(data->roots[iter]);
+                }
+            } else {
+                kernels->eighthroot(data->roots, result, n);
+            }
+            return n;
+        case KERNEL_SIGMOID:
+        case KERNEL_DISPERSAL:
+            for(unsigned chunk = 0; chunk < n / DISPERSAL_CHUNK; chunk++) {
+                const double *const x = data->populations + chunk * DISPERSAL_CHUNK;
+                double *const y = result + chunk * DISPERSAL_CHUNK;
+                const double mu = data->parameters[3 * chunk];
+                const double sigma = data->parameters[3 * chunk + 1];
+                const double delta = data->parameters[3 * chunk + 2];
+
+                if(kernels != NULL) {
+                    if(kernel == KERNEL_SIGMOID) {
+                        kernels->sigmoid(x, y, DISPERSAL_CHUNK, sigma, delta);
+                    } else {
+                        kernels->dispersal(x, y, DISPERSAL_CHUNK, mu, sigma, delta);
+                    }
+                    continue;
+                }
+                for(unsigned iter = 0; iter < DISPERSAL_CHUNK; iter++) {
+                    y[iter] = kernel == KERNEL_SIGMOID ? get_sigmoid(x[iter], sigma, delta) : get_dispersal(x[iter], mu, sigma, delta);
+                }
+            }
+            return n / DISPERSAL_CHUNK * DISPERSAL_CHUNK;
+        case KERNEL_WEIGHTED_MAX_ERROR:
+        default:
+            for(unsigned chunk = 0; chunk < n / ERROR_CHUNK; chunk++) {
+                const double *const x = data->predictions + chunk * ERROR_CHUNK;
+                const double *const y = data->observations + chunk * ERROR_CHUNK;
+                const double *const w = data->weights + chunk * ERROR_CHUNK;
+
+                if(kernels != NULL) {
+                    result[chunk] = kernels->weighted_max_error(y, x, w, ERROR_CHUNK, DBL_MAX_EXP);
+                    continue;
+                }
+                double fitness = DBL_MAX_EXP;
+                for(unsigned iter = 0; iter < ERROR_CHUNK; iter++) {
+                    const double tmp = w[iter] * (y[iter] - x[iter]) * (y[iter] - x[iter]);
+                    if(tmp > fitness) {
+                        fitness = tmp;
+                    }
+                }
+                result[chunk] = fitness;
+            }
+            return n / ERROR_CHUNK;
+    }
+}
+
+/* Fastest of the runs of `kernel` with `kernels`, in seconds.
+ */
+static double time_kernel(const Kernel kernel, const MathKernels *const kernels, const BenchmarkData *const data, double *const result) {
+    double best = HUGE_VAL;
+
+    for(unsigned repetition = 0; repetition < BENCHMARK_REPETITIONS; repetition++) {
+        const double start = omp_get_wtime();
+        run_kernel(kernel, kernels, data, result);
+        const double elapsed = omp_get_wtime() - start;
+        best = elapsed < best ? elapsed : best;
+    }
+
+    return best;
+}
+
+int benchmark_math(const unsigned n, const long seed, FILE *const stream) {
+    const unsigned n_chunks = n / DISPERSAL_CHUNK + 1;
+    BenchmarkData data = {
+        .n = n,
+        .roots = (double *) malloc(sizeof(double) * n),
+        .populations = (double *) malloc(sizeof(double) * n),
+        .predictions = (double *) malloc(sizeof(double) * n),
+        .observations = (double *) malloc(sizeof(double) * n),
+        .weights = (double *) malloc(sizeof(double) * n),
+        .parameters = (double *) malloc(sizeof(double) * 3 * n_chunks),
+    };
+    double *const reference = (double *) malloc(sizeof(double) * n);
+    double *const result = (double *) malloc(sizeof(double) * n);
+    Random rng;
+    random_seed(&rng, seed);
+    int violations = 0;
+
+    /* Ratios of tolerance to error from 1e-12 to 256, parameters within the
+     * bounds of the genotype and populations up to twice delta */
+    for(unsigned chunk = 0; chunk < n_chunks; chunk++) {
+        for(unsigned parameter = 0; parameter < 3; parameter++) {
+            const FieldLayout *const layout = genotype_layout + FIELD_MU + parameter;
+            data.parameters[3 * chunk + parameter] = layout->lower + (layout->upper - layout->lower) * uniform(&rng);
+        }
+    }
+    for(unsigned iter = 0; iter < n; iter++) {
+        data.roots[iter] = exp(log(1.0e-12) + (log(256.0) - log(1.0e-12)) * uniform(&rng));
+        data.populations[iter] = 2.0 * data.parameters[3 * (iter / DISPERSAL_CHUNK) + 2] * uniform(&rng);
+        data.observations[iter] = 20000.0 * uniform(&rng);
+        data.predictions[iter] = 20000.0 * uniform(&rng);
+        data.weights[iter] = floor(4.0 * uniform(&rng));
+    }
+
+    fprintf(stream, "kernel\tisa\tns_per_value\tmax_ulp\tmean_ulp\tmax_abs\n");
+    for(unsigned kernel = 0; kernel < KERNELS; kernel++) {
+        const double scalar = time_kernel((Kernel) kernel, NULL, &data, reference);
+        const unsigned n_results = run_kernel((Kernel) kernel, NULL, &data, reference);
+        fprintf(stream, "%s\tscalar\t%.3f\t0\t0.000\t0\n", kernel_names[kernel], 1.0e9 * scalar / n);
+
+        for(unsigned isa = 0; isa < MATH_ISAS; isa++) {
+            const MathKernels *const kernels = math_kernels_for((MathIsa) isa);
+            if(kernels == NULL) {
+                continue;
+            }
+
+            const double elapsed = time_kernel((Kernel) kernel, kernels, &data, result);
+            uint64_t max_ulp = 0;
+            double mean_ulp = 0.0;
+            double max_abs = 0.0;
+            for(unsigned iter = 0; iter < n_results; iter++) {
+                const uint64_t distance = ulp_distance(result[iter], reference[iter]);
+                max_ulp = distance > max_ulp ? distance : max_ulp;
+                mean_ulp += (double) distance / n_results;
+                max_abs = fmax(max_abs, fabs(result[iter] - reference[iter]));
+            }
+            fprintf(stream, "%s\t%s\t%.3f\t%lu\t%.3f\t%.3g\n", kernel_names[kernel], math_isa_names[isa], 1.0e9 * elapsed / n, (unsigned long) max_ulp, mean_ulp, max_abs);
+
+            if(max_ulp > kernel_bounds[kernel].ulp || !(max_abs <= kernel_bounds[kernel].absolute)) {
+                fprintf(stderr, "%s (%s) exceeds its bound of error\n", kernel_names[kernel], math_isa_names[isa]);
+                violations++;
+            }
+        }
+    }
+    fprintf(stream, "Selected: %s\n", math_isa_names[math_kernels()->isa]);
+
+    free(data.roots);
+    free(data.populations);
+    free(data.predictions);
+    free(data.observations);
+    free(data.weights);
+    free(data.parameters);
+    free(reference);
+    free(result);
+    return violations > 0;
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include "math-kernels.h"
+#include <stdio.h>
+
+/* Check and time the math kernels of every vector extension of the machine
+ * on `n` random values, writing to `stream` for every kernel the
+ * nanoseconds per value of its scalar version and of each vectorised one,
+ * the best of a few repetitions, the largest and mean distance in units in
+ * the last place of the vectorised results to the scalar ones, and the
+ * largest absolute one.
+ *
+ * Returns non-zero if a vectorised kernel exceeds the bound of its error.
+ */
+int benchmark_math(const unsigned n, const long seed, FILE *const stream);
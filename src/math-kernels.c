@@ -0,0 +1,155 @@
+#include "math-kernels.h"
+#include "equations.h"
+#include <float.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+const char *const math_isa_names[MATH_ISAS] = {
+    [MATH_ISA_SSE2] = "sse2",
+    [MATH_ISA_AVX2] = "avx2",
+    [MATH_ISA_AVX512] = "avx512",
+};
+
+/* First approximation of `x^(-1/8)` from the bits of `x`, dividing its
+ * exponent by eight, with the offset minimising the largest relative error,
+ * about 3%.
+ */
+#define INVERSE_ROOT_MAGIC (0x47ED23D613000000UL)
+
+/* Newton iterations refining it, each one squaring the relative error.
+ */
+#define INVERSE_ROOT_ITERATIONS (5)
+
+static inline uint64_t double_to_bits(const double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    return bits;
+}
+
+static inline double bits_to_double(const uint64_t bits) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+
+    return value;
+}
+
+/* The bodies of the kernels, compiled for every vector extension by the
+ * functions inlining them.
+ */
+static inline void eighthroot_lanes(const double *const restrict x, double *const restrict y, const unsigned n) {
+#pragma omp simd
+    for(unsigned iter = 0; iter < n; iter++) {
+        const double value = x[iter];
+        double root = bits_to_double(INVERSE_ROOT_MAGIC - double_to_bits(value) / 8);
+
+        /* r = r (9 - x r^8) / 8 */
+        for(unsigned step = 0; step < INVERSE_ROOT_ITERATIONS; step++) {
+            const double square = root * root;
+            const double fourth = square * square;
+            root *= (9.0 - value * fourth * fourth) * 0.125;
+        }
+
+        /* As `eighthroot`, not a number beyond 2^16 and zero below the
+         * normal numbers */
+        y[iter] = value < 0.0 || value >= 65536.0 ? NAN : (value < DBL_MIN ? 0.0 : 1.0 / root);
+    }
+}
+
+static inline void sigmoid_lanes(const double *const restrict x, double *const restrict y, const unsigned n, const double sigma, const double delta) {
+#pragma omp simd
+    for(unsigned iter = 0; iter < n; iter++) {
+        const double distance = x[iter] - delta;
+
+        y[iter] = sigma * distance / (MODEL_THETA + sigma * fabs(distance));
+    }
+}
+
+static inline void dispersal_lanes(const double *const restrict x, double *const restrict y, const unsigned n, const double mu, const double sigma, const double delta) {
+    /* The directed sigmoid is the sigmoid times a line from `scale` at zero
+     * to one at `delta` */
+    const double scale = mu * ((MODEL_THETA + sigma * delta) / (2 * MODEL_THETA + sigma * delta));
+    const double slope = (1.0 - scale) / delta;
+    const double normalisation = 1.0 / (1.0 - scale * (-sigma * delta / (MODEL_THETA + sigma * delta)));
+
+#pragma omp simd
+    for(unsigned iter = 0; iter < n; iter++) {
+        const double distance = x[iter] - delta;
+        const double sigmoid = sigma * distance / (MODEL_THETA + sigma * fabs(distance));
+        const double direction = distance > 0.0 ? 1.0 : scale + slope * x[iter];
+
+        y[iter] = (1.0 - direction * sigmoid) * normalisation;
+    }
+}
+
+static inline double weighted_max_error_lanes(const double *const restrict y, const double *const restrict x, const double *const restrict w, const unsigned n, const double initial) {
+    double result = initial;
+
+#pragma omp simd reduction (max:result)
+    for(unsigned iter = 0; iter < n; iter++) {
+        result = fmax(result, w[iter] * (y[iter] - x[iter]) * (y[iter] - x[iter]));
+    }
+
+    return result;
+}
+
+/* Instantiate the kernels for the vector extension `isa`, compiled with the
+ * function attributes `target`.
+ */
+#define DEFINE_KERNELS(name, isa_, target) \
+    target static void eighthroot_##name(const double *const x, double *const y, const unsigned n) { \
+        eighthroot_lanes(x, y, n); \
+    } \
+    target static void sigmoid_##name(const double *const x, double *const y, const unsigned n, const double sigma, const double delta) { \
+        sigmoid_lanes(x, y, n, sigma, delta); \
+    } \
+    target static void dispersal_##name(const double *const x, double *const y, const unsigned n, const double mu, const double sigma, const double delta) { \
+        dispersal_lanes(x, y, n, mu, sigma, delta); \
+    } \
+    target static double weighted_max_error_##name(const double *const y, const double *const x, const double *const w, const unsigned n, const double initial) { \
+        return weighted_max_error_lanes(y, x, w, n, initial); \
+    } \
+    static const MathKernels kernels_##name = { \
+        .isa = (isa_), \
+        .eighthroot = eighthroot_##name, \
+        .sigmoid = sigmoid_##name, \
+        .dispersal = dispersal_##name, \
+        .weighted_max_error = weighted_max_error_##name, \
+    };
+
+DEFINE_KERNELS(sse2, MATH_ISA_SSE2, )
+#if defined(__x86_64__)
+DEFINE_KERNELS(avx2, MATH_ISA_AVX2, __attribute__((target("avx2,fma"))))
+DEFINE_KERNELS(avx512, MATH_ISA_AVX512, __attribute__((target("avx512f"))))
+#endif
+
+const MathKernels *math_kernels_for(const MathIsa isa) {
+    switch(isa) {
+#if defined(__x86_64__)
+        case MATH_ISA_AVX512:
+            return __builtin_cpu_supports("avx512f") ? &kernels_avx512 : NULL;
+        case MATH_ISA_AVX2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ? &kernels_avx2 : NULL;
+#endif
+        case MATH_ISA_SSE2:
+            return &kernels_sse2;
+        default:
+            return NULL;
+    }
+}
+
+const MathKernels *math_kernels(void) {
+    static const MathKernels *_Atomic selected = NULL;
+
+    const MathKernels *kernels = atomic_load_explicit(&selected, memory_order_relaxed);
+    if(kernels == NULL) {
+        for(int isa = MATH_ISAS - 1; kernels == NULL; isa--) {
+            kernels = math_kernels_for((MathIsa) isa);
+        }
+        atomic_store_explicit(&selected, kernels, memory_order_relaxed);
+    }
+
+    return kernels;
+}
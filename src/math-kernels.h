@@ -0,0 +1,47 @@
+#pragma once
+
+/* Vector extensions the kernels are built for, from the narrowest to the
+ * widest.
+ */
+typedef enum {
+    /* SSE2 on x86-64, the baseline of the compiler elsewhere.
+     */
+    MATH_ISA_SSE2,
+    MATH_ISA_AVX2,
+    MATH_ISA_AVX512,
+    MATH_ISAS,
+} MathIsa;
+
+extern const char *const math_isa_names[MATH_ISAS];
+
+/* Vectorised math of the model and of its integration, over arrays of `n`
+ * values, every kernel branch free so that each lane takes the same path.
+ */
+typedef struct {
+    MathIsa isa;
+    /* `y[i] = eighthroot(x[i])`, within 5 ulp of the scalar version for
+     * `x[i]` in `(0, 256]`, by Newton iterations of the inverse root instead
+     * of its tables.
+     */
+    void (*eighthroot)(const double *const x, double *const y, const unsigned n);
+    /* `y[i] = sigmoid(x[i], sigma, delta)`.
+     */
+    void (*sigmoid)(const double *const x, double *const y, const unsigned n, const double sigma, const double delta);
+    /* `y[i] = model_dispersal(x[i], mu, sigma, delta)`, with the terms that
+     * do not depend on `x[i]` computed once, with a single division per
+     * value.
+     */
+    void (*dispersal)(const double *const x, double *const y, const unsigned n, const double mu, const double sigma, const double delta);
+    /* Largest of `initial` and `w[i] * (y[i] - x[i])^2`, the fitness of a
+     * prediction `x` of the observations `y` with weights `w`.
+     */
+    double (*weighted_max_error)(const double *const y, const double *const x, const double *const w, const unsigned n, const double initial);
+} MathKernels;
+
+/* Kernels for `isa`, or `NULL` if the machine does not support it.
+ */
+const MathKernels *math_kernels_for(const MathIsa isa);
+
+/* Kernels for the widest vector extension of the machine.
+ */
+const MathKernels *math_kernels(void);
@@ -0,0 +1,313 @@
+#define _POSIX_C_SOURCE 200809L
+#include "metrics.h"
+#include <fcntl.h>
+#include <sched.h>
+#include <omp.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define METRICS_MAGIC "GAMETRIC"
+#define METRICS_VERSION (1)
+
+/* Attempts of a reader to find the page between two updates before giving
+ * up, in case its writer died in the middle of one, yielding the processor
+ * after the first few to a writer preempted in the middle of one.
+ */
+#define METRICS_READ_ATTEMPTS (1 << 20)
+#define METRICS_READ_SPINS (64)
+
+/* First bytes of the file, identifying it and the layout of its page.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t page_size;
+    int64_t pid;
+    uint64_t reserved[2];
+} MetricsHeader;
+
+/* Page of the file, every field stored atomically since it is read by other
+ * processes while being written.
+ */
+typedef struct {
+    MetricsHeader header;
+    /* Number of updates started and finished, odd during an update.
+     */
+    _Atomic uint64_t sequence;
+    _Atomic uint32_t finished;
+    _Atomic uint32_t n_threads;
+    _Atomic double updated;
+    _Atomic double elapsed;
+    _Atomic uint32_t generation;
+    _Atomic double fitness;
+    _Atomic double phi;
+    _Atomic double lambda;
+    _Atomic double mu;
+    _Atomic double sigma;
+    _Atomic double delta;
+    _Atomic uint64_t evaluations;
+    _Atomic double evaluations_per_second;
+    _Atomic uint64_t lookups;
+    _Atomic uint64_t hits;
+    _Atomic double steps_per_evaluation;
+    _Atomic double utilization[METRICS_MAX_THREADS];
+} MetricsPage;
+
+/* Time the thread of a scheduler spent running tasks, alone in its cache
+ * line since every thread adds to its own.
+ */
+typedef struct {
+    _Alignas(64) atomic_ullong nanoseconds;
+} ThreadBusy;
+
+int metrics_enabled = 0;
+
+static ThreadBusy busy[METRICS_MAX_THREADS];
+
+/* State of the writer, private to the thread publishing the metrics.
+ */
+static struct {
+    MetricsPage *page;
+    Archive *archive;
+    unsigned n_threads;
+    IntegrationStats before;
+    double start;
+    double last;
+    unsigned long last_evaluations;
+    unsigned long long last_busy[METRICS_MAX_THREADS];
+} writer;
+
+int metrics_open(const char *const path, const unsigned n_threads, Archive *const archive) {
+    const int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        perror(path);
+        return 1;
+    }
+
+    /* Write the header before mapping the page, so that readers never see
+     * a partial one */
+    MetricsHeader header = {
+        .version = METRICS_VERSION,
+        .page_size = sizeof(MetricsPage),
+        .pid = getpid(),
+    };
+    memcpy(header.magic, METRICS_MAGIC, sizeof(header.magic));
+    if(write(fd, &header, sizeof(header)) != (ssize_t) sizeof(header) || ftruncate(fd, sizeof(MetricsPage)) != 0) {
+        perror(path);
+        close(fd);
+        return 1;
+    }
+
+    void *const map = mmap(NULL, sizeof(MetricsPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) {
+        perror(path);
+        return 1;
+    }
+
+    MetricsPage *const page = (MetricsPage *) map;
+    if(!atomic_is_lock_free(&(page->sequence)) || !atomic_is_lock_free(&(page->fitness))) {
+        fprintf(stderr, "%s: atomic operations of the machine cannot be shared between processes\n", path);
+        munmap(map, sizeof(MetricsPage));
+        return 1;
+    }
+
+    writer.page = page;
+    writer.archive = archive;
+    writer.n_threads = n_threads < METRICS_MAX_THREADS ? n_threads : METRICS_MAX_THREADS;
+    writer.before = get_total_integration_stats();
+    writer.start = omp_get_wtime();
+    writer.last = writer.start;
+    writer.last_evaluations = 0;
+    for(unsigned thread = 0; thread < METRICS_MAX_THREADS; thread++) {
+        writer.last_busy[thread] = atomic_load_explicit(&(busy[thread].nanoseconds), memory_order_relaxed);
+    }
+    atomic_store_explicit(&(page->n_threads), writer.n_threads, memory_order_relaxed);
+
+    metrics_enabled = 1;
+    return 0;
+}
+
+void metrics_close(void) {
+    if(!metrics_enabled) {
+        return;
+    }
+
+    metrics_enabled = 0;
+    atomic_store_explicit(&(writer.page->finished), 1, memory_order_release);
+    munmap(writer.page, sizeof(MetricsPage));
+    writer.page = NULL;
+}
+
+void metrics_publish(const unsigned generation, const double fitness, const Phenotype *const p) {
+    MetricsPage *const page = writer.page;
+    const double now = omp_get_wtime();
+    const double interval = now - writer.last;
+    struct timespec wall;
+    clock_gettime(CLOCK_REALTIME, &wall);
+
+    const IntegrationStats stats = get_total_integration_stats();
+    const unsigned long predictions = stats.predictions - writer.before.predictions;
+    const unsigned long steps = stats.accepted + stats.rejected - writer.before.accepted - writer.before.rejected;
+    unsigned long lookups = 0;
+    unsigned long hits = 0;
+    if(writer.archive != NULL) {
+        archive_counts(writer.archive, &lookups, &hits);
+    }
+    const unsigned long evaluations = predictions + hits;
+
+    /* Readers retry while the sequence is odd or changed under them */
+    const uint64_t sequence = atomic_load_explicit(&(page->sequence), memory_order_relaxed);
+    atomic_store_explicit(&(page->sequence), sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    atomic_store_explicit(&(page->updated), wall.tv_sec + 1.0e-9 * wall.tv_nsec, memory_order_relaxed);
+    atomic_store_explicit(&(page->elapsed), now - writer.start, memory_order_relaxed);
+    atomic_store_explicit(&(page->generation), generation, memory_order_relaxed);
+    atomic_store_explicit(&(page->fitness), fitness, memory_order_relaxed);
+    atomic_store_explicit(&(page->phi), p->phi, memory_order_relaxed);
+    atomic_store_explicit(&(page->lambda), p->lambda, memory_order_relaxed);
+    atomic_store_explicit(&(page->mu), p->mu, memory_order_relaxed);
+    atomic_store_explicit(&(page->sigma), p->sigma, memory_order_relaxed);
+    atomic_store_explicit(&(page->delta), p->delta, memory_order_relaxed);
+    atomic_store_explicit(&(page->evaluations), evaluations, memory_order_relaxed);
+    atomic_store_explicit(&(page->evaluations_per_second), interval > 0.0 ? (evaluations - writer.last_evaluations) / interval : 0.0, memory_order_relaxed);
+    atomic_store_explicit(&(page->lookups), lookups, memory_order_relaxed);
+    atomic_store_explicit(&(page->hits), hits, memory_order_relaxed);
+    atomic_store_explicit(&(page->steps_per_evaluation), predictions > 0 ? (double) steps / predictions : 0.0, memory_order_relaxed);
+    for(unsigned thread = 0; thread < writer.n_threads; thread++) {
+        const unsigned long long nanoseconds = atomic_load_explicit(&(busy[thread].nanoseconds), memory_order_relaxed);
+        const double utilization = interval > 0.0 ? 1.0e-9 * (nanoseconds - writer.last_busy[thread]) / interval : 0.0;
+        atomic_store_explicit(&(page->utilization[thread]), utilization, memory_order_relaxed);
+        writer.last_busy[thread] = nanoseconds;
+    }
+
+    atomic_store_explicit(&(page->sequence), sequence + 2, memory_order_release);
+
+    writer.last = now;
+    writer.last_evaluations = evaluations;
+}
+
+void metrics_thread_busy(const unsigned thread, const double seconds) {
+    if(thread < METRICS_MAX_THREADS) {
+        atomic_fetch_add_explicit(&(busy[thread].nanoseconds), (unsigned long long) (1.0e9 * seconds), memory_order_relaxed);
+    }
+}
+
+/* Copy the fields of `page` to `snapshot`, returning `0` if no update was
+ * in progress nor happened meanwhile.
+ */
+static int read_page(const MetricsPage *const page, MetricsSnapshot *const snapshot) {
+    const uint64_t before = atomic_load_explicit(&(page->sequence), memory_order_acquire);
+    if(before & 1) {
+        return 1;
+    }
+
+    snapshot->pid = page->header.pid;
+    snapshot->finished = atomic_load_explicit(&(page->finished), memory_order_relaxed);
+    snapshot->n_threads = atomic_load_explicit(&(page->n_threads), memory_order_relaxed);
+    snapshot->updated = atomic_load_explicit(&(page->updated), memory_order_relaxed);
+    snapshot->elapsed = atomic_load_explicit(&(page->elapsed), memory_order_relaxed);
+    snapshot->generation = atomic_load_explicit(&(page->generation), memory_order_relaxed);
+    snapshot->fitness = atomic_load_explicit(&(page->fitness), memory_order_relaxed);
+    snapshot->best = (Phenotype) {
+        .phi = atomic_load_explicit(&(page->phi), memory_order_relaxed),
+        .lambda = atomic_load_explicit(&(page->lambda), memory_order_relaxed),
+        .mu = atomic_load_explicit(&(page->mu), memory_order_relaxed),
+        .sigma = atomic_load_explicit(&(page->sigma), memory_order_relaxed),
+        .delta = atomic_load_explicit(&(page->delta), memory_order_relaxed),
+    };
+    snapshot->evaluations = atomic_load_explicit(&(page->evaluations), memory_order_relaxed);
+    snapshot->evaluations_per_second = atomic_load_explicit(&(page->evaluations_per_second), memory_order_relaxed);
+    snapshot->lookups = atomic_load_explicit(&(page->lookups), memory_order_relaxed);
+    snapshot->hits = atomic_load_explicit(&(page->hits), memory_order_relaxed);
+    snapshot->steps_per_evaluation = atomic_load_explicit(&(page->steps_per_evaluation), memory_order_relaxed);
+    snapshot->n_threads = snapshot->n_threads < METRICS_MAX_THREADS ? snapshot->n_threads : METRICS_MAX_THREADS;
+    for(unsigned thread = 0; thread < snapshot->n_threads; thread++) {
+        snapshot->utilization[thread] = atomic_load_explicit(&(page->utilization[thread]), memory_order_relaxed);
+    }
+
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&(page->sequence), memory_order_relaxed) != before;
+}
+
+int metrics_read(const char *const path, MetricsSnapshot *const snapshot) {
+    const int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        perror(path);
+        return 1;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(MetricsPage)) {
+        fprintf(stderr, "%s: not a page of metrics\n", path);
+        close(fd);
+        return 1;
+    }
+
+    void *const map = mmap(NULL, sizeof(MetricsPage), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) {
+        perror(path);
+        return 1;
+    }
+
+    const MetricsPage *const page = (const MetricsPage *) map;
+    if(memcmp(page->header.magic, METRICS_MAGIC, sizeof(page->header.magic)) != 0
+            || page->header.version != METRICS_VERSION || page->header.page_size != sizeof(MetricsPage)) {
+        fprintf(stderr, "%s: not a page of metrics of this version\n", path);
+        munmap(map, sizeof(MetricsPage));
+        return 1;
+    }
+
+    int err = 1;
+    for(unsigned attempt = 0; err != 0 && attempt < METRICS_READ_ATTEMPTS; attempt++) {
+        if(attempt >= METRICS_READ_SPINS) {
+            sched_yield();
+        }
+        err = read_page(page, snapshot);
+    }
+    munmap(map, sizeof(MetricsPage));
+
+    if(err != 0) {
+        fprintf(stderr, "%s: the page of metrics is stuck in an update\n", path);
+    }
+    return err;
+}
+
+int print_metrics(const char *const path, FILE *const output) {
+    MetricsSnapshot snapshot;
+    if(metrics_read(path, &snapshot) != 0) {
+        return 1;
+    }
+
+    struct timespec wall;
+    clock_gettime(CLOCK_REALTIME, &wall);
+
+    fprintf(output, "pid\t%ld\n", snapshot.pid);
+    fprintf(output, "state\t%s\n", snapshot.finished ? "finished" : "running");
+    fprintf(output, "age\t%.3f\n", wall.tv_sec + 1.0e-9 * wall.tv_nsec - snapshot.updated);
+    fprintf(output, "elapsed\t%.3f\n", snapshot.elapsed);
+    fprintf(output, "generation\t%u\n", snapshot.generation);
+    fprintf(output, "fitness\t%lf\n", snapshot.fitness);
+    fprintf(output, "phi\t%f\nlambda\t%f\nmu\t%f\nsigma\t%f\ndelta\t%f\n",
+            snapshot.best.phi, snapshot.best.lambda, snapshot.best.mu, snapshot.best.sigma, snapshot.best.delta);
+    fprintf(output, "evaluations\t%lu\n", snapshot.evaluations);
+    fprintf(output, "evaluations_per_second\t%.1f\n", snapshot.evaluations_per_second);
+    if(snapshot.lookups > 0) {
+        fprintf(output, "cache_hit_rate\t%.4f\n", (double) snapshot.hits / snapshot.lookups);
+    } else {
+        fprintf(output, "cache_hit_rate\t-\n");
+    }
+    fprintf(output, "steps_per_evaluation\t%.2f\n", snapshot.steps_per_evaluation);
+    for(unsigned thread = 0; thread < snapshot.n_threads; thread++) {
+        fprintf(output, "utilization_%u\t%.3f\n", thread, snapshot.utilization[thread]);
+    }
+
+    return 0;
+}
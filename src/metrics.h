@@ -0,0 +1,94 @@
+#pragma once
+#include "archive.h"
+#include "equations.h"
+#include <stdio.h>
+
+/* Threads whose utilisation is published.
+ */
+#define METRICS_MAX_THREADS (64)
+
+/* Live metrics of a run, published in a memory mapped file for external
+ * monitoring.
+ *
+ * The file holds a header and a single page of metrics, updated in place
+ * every generation behind a sequence counter, odd while the page is being
+ * written, so that readers in other processes take consistent snapshots
+ * without locks or system calls, and the run never waits for them.
+ */
+
+/* Whether metrics are published, set once by `metrics_open` before the run.
+ *
+ * Disabled metrics cost a single predictable branch.
+ */
+extern int metrics_enabled;
+
+/* Create the page of metrics at `path` for a run on `n_threads` threads,
+ * counting the fitness values reused from `archive` unless `NULL`, returning
+ * `0` on success, and otherwise non-zero after printing the reason.
+ */
+int metrics_open(const char *const path, const unsigned n_threads, Archive *const archive);
+
+/* Mark the run as finished in the page and release it.
+ */
+void metrics_close(void);
+
+/* Publish the best individual found so far and the counters of the run at
+ * the end of generation `generation`, from a single thread.
+ */
+void metrics_publish(const unsigned generation, const double fitness, const Phenotype *const p);
+
+/* Add `seconds` spent running tasks to the busy time of the thread `thread`
+ * of the scheduler.
+ */
+void metrics_thread_busy(const unsigned thread, const double seconds);
+
+static inline void metrics_update(const unsigned generation, const double fitness, const Phenotype *const p) {
+    if(metrics_enabled) {
+        metrics_publish(generation, fitness, p);
+    }
+}
+
+/* Snapshot of the page of metrics.
+ */
+typedef struct {
+    /* Process publishing the metrics, and whether it is still running.
+     */
+    long pid;
+    int finished;
+    /* Wall clock time of the last update, in seconds since the epoch, and
+     * time since the start of the run.
+     */
+    double updated;
+    double elapsed;
+    unsigned generation;
+    double fitness;
+    Phenotype best;
+    /* Fitness evaluations, integrated or reused from the archive, in total
+     * and per second since the previous update.
+     */
+    unsigned long evaluations;
+    double evaluations_per_second;
+    /* Archive lookups and how many of them found the fitness.
+     */
+    unsigned long lookups;
+    unsigned long hits;
+    /* Accepted and rejected steps of the integrations per prediction.
+     */
+    double steps_per_evaluation;
+    /* Fraction of the time since the previous update every thread of the
+     * scheduler spent running tasks.
+     */
+    unsigned n_threads;
+    double utilization[METRICS_MAX_THREADS];
+} MetricsSnapshot;
+
+/* Take a consistent snapshot of the page of metrics at `path` without
+ * blocking its writer, returning `0` on success, and otherwise non-zero after
+ * printing the reason.
+ */
+int metrics_read(const char *const path, MetricsSnapshot *const snapshot);
+
+/* Print the snapshot of the page of metrics at `path`, one `name value`
+ * line per metric, returning `0` on success.
+ */
+int print_metrics(const char *const path, FILE *const output);
@@ -0,0 +1,169 @@
+#include "multiplexer.h"
+#include "genetic-algorithm.h"
+#include "scheduler.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+
+typedef struct {
+    GeneticAlgorithm *const *gas;
+    const GeneticAlgorithmConfig *const *configs;
+    const long *seeds;
+    /* Scheduler evaluating the initial population of a run.
+     */
+    Scheduler scheduler;
+    /* Runs that could not be allocated.
+     */
+    atomic_uint failed;
+} RunsInit;
+
+/* Scheduler task initialising the `index`-th run.
+ */
+static void init_task(const unsigned index, void *const data) {
+    RunsInit *const init = (RunsInit *) data;
+
+    if(genetic_algorithm_init(init->gas[index], init->configs[index], init->seeds[index], &(init->scheduler)) != 0) {
+        atomic_fetch_add(&(init->failed), 1);
+        return;
+    }
+    genetic_algorithm_update_best(init->gas[index]);
+}
+
+/* Scheduler task breeding the `index`-th run.
+ */
+static void breed_task(const unsigned index, void *const data) {
+    genetic_algorithm_breed(((Multiplexer *) data)->gas[index]);
+}
+
+/* Scheduler task evaluating the `index`-th child of all the runs.
+ */
+static void evaluate_task(const unsigned index, void *const data) {
+    const Multiplexer *const multiplexer = (Multiplexer *) data;
+
+    genetic_algorithm_evaluate(multiplexer->owners[index], multiplexer->children[index]);
+}
+
+void multiplexer_init(Multiplexer *const multiplexer) {
+    multiplexer->gas = NULL;
+    multiplexer->children = NULL;
+    multiplexer->owners = NULL;
+    multiplexer->capacity = 0;
+}
+
+void multiplexer_free(Multiplexer *const multiplexer) {
+    free(multiplexer->children);
+    free(multiplexer->owners);
+    multiplexer_init(multiplexer);
+}
+
+int multiplexer_init_runs(const Scheduler *const scheduler, GeneticAlgorithm *const *const gas, const GeneticAlgorithmConfig *const *const configs, const long *const seeds, const unsigned n_runs) {
+    RunsInit init = { .gas = gas, .configs = configs, .seeds = seeds };
+    atomic_init(&(init.failed), 0);
+
+    /* Parallel across runs if they are enough to fill the threads, and across
+     * the individuals of each run otherwise */
+    if(n_runs >= scheduler->n_threads) {
+        scheduler_init(&(init.scheduler), 1);
+        scheduler_run(scheduler, n_runs, init_task, &init);
+    } else {
+        init.scheduler = *scheduler;
+        for(unsigned run = 0; run < n_runs; run++) {
+            init_task(run, &init);
+        }
+    }
+
+    if(atomic_load(&(init.failed)) == 0) {
+        return 0;
+    }
+
+    /* Failed runs released their population already */
+    for(unsigned run = 0; run < n_runs; run++) {
+        genetic_algorithm_free(gas[run]);
+    }
+    return 1;
+}
+
+/* Make room for the individuals of every run of `gas`, returning their number.
+ */
+static unsigned reserve_children(Multiplexer *const multiplexer, GeneticAlgorithm *const *const gas, const unsigned n_runs) {
+    unsigned n_children = 0;
+    for(unsigned run = 0; run < n_runs; run++) {
+        n_children += gas[run]->n_individuals;
+    }
+
+    if(n_children > multiplexer->capacity) {
+        multiplexer->capacity = n_children;
+        multiplexer->children = (Individual **) realloc(multiplexer->children, sizeof(Individual *) * n_children);
+        multiplexer->owners = (GeneticAlgorithm **) realloc(multiplexer->owners, sizeof(GeneticAlgorithm *) * n_children);
+    }
+    multiplexer->gas = gas;
+
+    return n_children;
+}
+
+void multiplexer_evaluate_runs(Multiplexer *const multiplexer, const Scheduler *const scheduler, GeneticAlgorithm *const *const gas, const unsigned n_runs) {
+    const unsigned n_individuals = reserve_children(multiplexer, gas, n_runs);
+
+    unsigned index = 0;
+    for(unsigned run = 0; run < n_runs; run++) {
+        for(unsigned iter = 0; iter < gas[run]->n_individuals; iter++) {
+            multiplexer->children[index] = gas[run]->individuals + iter;
+            multiplexer->owners[index] = gas[run];
+            index++;
+        }
+    }
+    scheduler_run(scheduler, n_individuals, evaluate_task, multiplexer);
+
+    for(unsigned run = 0; run < n_runs; run++) {
+        genetic_algorithm_update_best(gas[run]);
+    }
+}
+
+void multiplexer_step(Multiplexer *const multiplexer, const Scheduler *const scheduler, GeneticAlgorithm *const *const gas, const unsigned n_runs) {
+    unsigned n_children = reserve_children(multiplexer, gas, n_runs);
+
+    /* React to the loss of diversity of the runs watching it, evaluating the
+     * individuals of the restarted ones as one batch */
+    unsigned n_restarted = 0;
+    for(unsigned run = 0; run < n_runs; run++) {
+        if(gas[run]->config.diversity_threshold > 0.0 && genetic_algorithm_update_diversity(gas[run])) {
+            for(unsigned iter = 1; iter < gas[run]->n_individuals; iter++) {
+                multiplexer->children[n_restarted] = gas[run]->individuals + iter;
+                multiplexer->owners[n_restarted] = gas[run];
+                n_restarted++;
+            }
+        }
+    }
+    if(n_restarted > 0) {
+        scheduler_run(scheduler, n_restarted, evaluate_task, multiplexer);
+    }
+
+    scheduler_run(scheduler, n_runs, breed_task, multiplexer);
+
+    unsigned child = 0;
+    for(unsigned run = 0; run < n_runs; run++) {
+        for(unsigned iter = 0; iter < gas[run]->n_individuals; iter++) {
+            multiplexer->children[child] = gas[run]->new_individuals + iter;
+            multiplexer->owners[child] = gas[run];
+            child++;
+        }
+    }
+    scheduler_run(scheduler, n_children, evaluate_task, multiplexer);
+
+    /* Confirm the promising children at full accuracy if screening */
+    n_children = 0;
+    for(unsigned run = 0; run < n_runs; run++) {
+        const unsigned n_confirmed = genetic_algorithm_screen(gas[run], multiplexer->children + n_children);
+        for(unsigned iter = 0; iter < n_confirmed; iter++) {
+            multiplexer->owners[n_children + iter] = gas[run];
+        }
+        n_children += n_confirmed;
+    }
+    if(n_children > 0) {
+        scheduler_run(scheduler, n_children, evaluate_task, multiplexer);
+    }
+
+    for(unsigned run = 0; run < n_runs; run++) {
+        genetic_algorithm_replace(gas[run], scheduler);
+        genetic_algorithm_update_best(gas[run]);
+    }
+}
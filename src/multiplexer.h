@@ -0,0 +1,42 @@
+#pragma once
+#include "genetic-algorithm.h"
+#include "scheduler.h"
+
+/* Driver advancing several independent runs of the genetic algorithm in
+ * lockstep on one scheduler, with two levels of parallelism: the runs breed in
+ * parallel, one per thread, and then the children of every run are evaluated
+ * as a single dynamically balanced batch, so that a few large runs and many
+ * small ones keep every core busy alike.
+ */
+typedef struct {
+    GeneticAlgorithm *const *gas;
+    Individual **children;
+    GeneticAlgorithm **owners;
+    unsigned capacity;
+} Multiplexer;
+
+void multiplexer_init(Multiplexer *const multiplexer);
+
+void multiplexer_free(Multiplexer *const multiplexer);
+
+/* Initialise the runs `gas[i]` with `configs[i]` and `seeds[i]`, drawing
+ * their initial populations in parallel, across runs if there are as many as
+ * threads and across individuals otherwise.
+ *
+ * Returns `0` on success, and otherwise non-zero after releasing every run,
+ * if any of them could not be allocated.
+ */
+int multiplexer_init_runs(const Scheduler *const scheduler, GeneticAlgorithm *const *const gas, const GeneticAlgorithmConfig *const *const configs, const long *const seeds, const unsigned n_runs);
+
+/* Evaluate the current populations of the allocated runs `gas` as one batch,
+ * and find their best individual, to start runs from given genotypes.
+ */
+void multiplexer_evaluate_runs(Multiplexer *const multiplexer, const Scheduler *const scheduler, GeneticAlgorithm *const *const gas, const unsigned n_runs);
+
+/* Advance the runs `gas` one generation, leaving their best individual up to
+ * date with the new population, after reacting to the loss of diversity of
+ * the runs with a `diversity_threshold`.
+ *
+ * Runs screening their children confirm them in a second batch.
+ */
+void multiplexer_step(Multiplexer *const multiplexer, const Scheduler *const scheduler, GeneticAlgorithm *const *const gas, const unsigned n_runs);
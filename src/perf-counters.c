@@ -0,0 +1,292 @@
+#define _GNU_SOURCE
+#include "perf-counters.h"
+#include "equations.h"
+#include <linux/perf_event.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define PERF_MAX_THREADS 256
+
+/* Hardware events collected in every region.
+ */
+typedef enum {
+    EVENT_CYCLES,
+    EVENT_INSTRUCTIONS,
+    EVENT_BRANCH_MISSES,
+    EVENT_L1D_MISSES,
+    EVENT_LLC_MISSES,
+    EVENT_FP_OPS,
+    N_EVENTS,
+} PerfEvent;
+
+static const char *const event_names[N_EVENTS] = {
+    "cycles", "instructions", "branch-misses", "L1d-misses", "LLC-misses", "fp-ops",
+};
+
+static const char *const region_names[N_REGIONS] = {
+    "fitness", "breeding", "selection",
+};
+
+/* Type and configuration of every event.
+ */
+static const uint32_t event_types[N_EVENTS] = {
+    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE, PERF_TYPE_RAW,
+};
+
+static const uint64_t event_configs[N_EVENTS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_BRANCH_MISSES,
+    PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+    PERF_COUNT_HW_CACHE_MISSES,
+    /* FP_ARITH_INST_RETIRED.SCALAR_DOUBLE */
+    0x01C7,
+};
+
+/* Values of a group of counters, read at once from its leader, with the times
+ * it was enabled and actually counting, which differ when the kernel
+ * multiplexes more events than the core has counters.
+ */
+typedef struct {
+    uint64_t nr;
+    uint64_t time_enabled;
+    uint64_t time_running;
+    uint64_t values[N_EVENTS];
+} PerfGroup;
+
+/* Counters of a thread, opened as a group the first time it enters a region.
+ *
+ * `slot` is the position of every event in the values of the group, or -1 if
+ * the machine does not support it.
+ */
+typedef struct {
+    int fd[N_EVENTS];
+    int leader;
+    int slot[N_EVENTS];
+    PerfGroup start[N_REGIONS];
+    uint64_t total[N_REGIONS][N_EVENTS];
+    unsigned long ode_start[N_REGIONS];
+    unsigned long ode_total[N_REGIONS];
+    unsigned long calls[N_REGIONS];
+} PerfThread;
+
+int perf_counters_enabled = 0;
+
+static PerfThread *threads[PERF_MAX_THREADS];
+static atomic_uint n_threads = 0;
+static _Thread_local PerfThread *self = NULL;
+/* Whether the calling thread could not open its counters, and is left out.
+ */
+static _Thread_local int uncounted = 0;
+
+/* Whether the floating point event, raw and specific to Intel cores, is
+ * opened, set by `perf_counters_enable`.
+ */
+static int intel_events = 0;
+
+/* Whether the vendor of the processor is Intel, as `/proc/cpuinfo` tells.
+ */
+static int intel_cpu(void) {
+    FILE *const cpuinfo = fopen("/proc/cpuinfo", "r");
+    char line[256];
+    int intel = 0;
+
+    if(cpuinfo == NULL) {
+        return 0;
+    }
+    while(fgets(line, sizeof(line), cpuinfo) != NULL) {
+        if(strncmp(line, "vendor_id", 9) == 0) {
+            intel = strstr(line, "GenuineIntel") != NULL;
+            break;
+        }
+    }
+    fclose(cpuinfo);
+
+    return intel;
+}
+
+static int open_event(const uint32_t type, const uint64_t config, const int group) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+/* Open the counters of the calling thread and register it for the report,
+ * returning `NULL` if memory runs out or `PERF_MAX_THREADS` threads already
+ * were.
+ *
+ * The first event the machine supports leads the group of the others, so that
+ * a single read snapshots all of them. Events not supported by the machine,
+ * and the floating point one on other processors than Intel ones, where the
+ * raw code means another event, are left closed and reported as unavailable.
+ */
+static PerfThread *open_thread(void) {
+    PerfThread *thread = (PerfThread *) calloc(1, sizeof(PerfThread));
+    int n_slots = 0;
+
+    if(thread == NULL) {
+        return NULL;
+    }
+    const unsigned index = atomic_fetch_add(&n_threads, 1);
+    if(index >= PERF_MAX_THREADS) {
+        free(thread);
+        return NULL;
+    }
+
+    thread->leader = -1;
+    for(unsigned event = 0; event < N_EVENTS; event++) {
+        const int supported = event_types[event] != PERF_TYPE_RAW || intel_events;
+        thread->fd[event] = supported ? open_event(event_types[event], event_configs[event], thread->leader) : -1;
+        thread->slot[event] = thread->fd[event] >= 0 ? n_slots++ : -1;
+        if(thread->leader < 0) {
+            thread->leader = thread->fd[event];
+        }
+    }
+    threads[index] = thread;
+
+    return thread;
+}
+
+static inline void read_group(const PerfThread *const thread, PerfGroup *const group) {
+    if(thread->leader < 0 || read(thread->leader, group, sizeof(PerfGroup)) < (ssize_t) (3 * sizeof(uint64_t))) {
+        memset(group, 0, sizeof(PerfGroup));
+    }
+}
+
+void perf_counters_enable(void) {
+    intel_events = intel_cpu();
+    perf_counters_enabled = 1;
+    ode_counting_enabled = 1;
+}
+
+void perf_region_enter(const PerfRegion region) {
+    if(self == NULL) {
+        if(uncounted || (self = open_thread()) == NULL) {
+            uncounted = 1;
+            return;
+        }
+    }
+
+    self->ode_start[region] = get_ode_evaluations();
+    read_group(self, &(self->start[region]));
+}
+
+/* The counts are scaled by the fraction of the region the group was actually
+ * counting, estimating them for the whole region when it was multiplexed.
+ */
+void perf_region_leave(const PerfRegion region) {
+    PerfGroup end;
+    if(self == NULL) {
+        return;
+    }
+    read_group(self, &end);
+
+    const PerfGroup *const start = &(self->start[region]);
+    const uint64_t running = end.time_running - start->time_running;
+    const double scale = running > 0 ? (double) (end.time_enabled - start->time_enabled) / running : 0.0;
+    for(unsigned event = 0; event < N_EVENTS; event++) {
+        const int slot = self->slot[event];
+        if(slot >= 0) {
+            self->total[region][event] += (uint64_t) ((end.values[slot] - start->values[slot]) * scale + 0.5);
+        }
+    }
+    self->ode_total[region] += get_ode_evaluations() - self->ode_start[region];
+    self->calls[region]++;
+}
+
+/* Print a line with the counters of a region.
+ */
+static void report_region(FILE *const stream, const char *const label, const PerfRegion region, const uint64_t *const total, const unsigned long ode, const unsigned long calls, const int *const available) {
+    fprintf(stream, "%-10s %-9s %10lu", label, region_names[region], calls);
+    for(unsigned event = 0; event < N_EVENTS; event++) {
+        if(available[event]) {
+            fprintf(stream, " %14lu", (unsigned long) total[event]);
+        } else {
+            fprintf(stream, " %14s", "-");
+        }
+    }
+
+    const double cycles = total[EVENT_CYCLES];
+    if(cycles > 0 && available[EVENT_INSTRUCTIONS]) {
+        fprintf(stream, " %6.3f", total[EVENT_INSTRUCTIONS] / cycles);
+    } else {
+        fprintf(stream, " %6s", "-");
+    }
+    fprintf(stream, " %12lu", ode);
+    if(ode > 0 && cycles > 0) {
+        fprintf(stream, " %10.1f", cycles / ode);
+    } else {
+        fprintf(stream, " %10s", "-");
+    }
+    fprintf(stream, "\n");
+}
+
+void perf_counters_report(FILE *const stream) {
+    const unsigned count = atomic_load(&n_threads) < PERF_MAX_THREADS ? atomic_load(&n_threads) : PERF_MAX_THREADS;
+    int available[N_EVENTS] = { 0 };
+
+    for(unsigned thread = 0; thread < count; thread++) {
+        for(unsigned event = 0; event < N_EVENTS; event++) {
+            available[event] |= threads[thread]->fd[event] >= 0;
+        }
+    }
+
+    fprintf(stream, "%-10s %-9s %10s", "thread", "region", "calls");
+    for(unsigned event = 0; event < N_EVENTS; event++) {
+        fprintf(stream, " %14s", event_names[event]);
+    }
+    fprintf(stream, " %6s %12s %10s\n", "IPC", "ODE", "cycles/ODE");
+
+    for(unsigned region = 0; region < N_REGIONS; region++) {
+        uint64_t total[N_EVENTS] = { 0 };
+        unsigned long ode = 0;
+        unsigned long calls = 0;
+
+        for(unsigned thread = 0; thread < count; thread++) {
+            char label[16];
+            snprintf(label, sizeof(label), "%u", thread);
+
+            if(threads[thread]->calls[region] == 0) {
+                continue;
+            }
+            report_region(stream, label, region, threads[thread]->total[region], threads[thread]->ode_total[region], threads[thread]->calls[region], available);
+
+            for(unsigned event = 0; event < N_EVENTS; event++) {
+                total[event] += threads[thread]->total[region][event];
+            }
+            ode += threads[thread]->ode_total[region];
+            calls += threads[thread]->calls[region];
+        }
+        report_region(stream, "all", region, total, ode, calls, available);
+    }
+}
+
+void perf_counters_close(void) {
+    const unsigned count = atomic_load(&n_threads) < PERF_MAX_THREADS ? atomic_load(&n_threads) : PERF_MAX_THREADS;
+
+    perf_counters_enabled = 0;
+    for(unsigned thread = 0; thread < count; thread++) {
+        for(unsigned event = 0; event < N_EVENTS; event++) {
+            if(threads[thread]->fd[event] >= 0) {
+                close(threads[thread]->fd[event]);
+            }
+        }
+        free(threads[thread]);
+        threads[thread] = NULL;
+    }
+    atomic_store(&n_threads, 0);
+    self = NULL;
+    uncounted = 0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <stdio.h>
+
+/* Regions of the algorithm whose hardware counters are collected.
+ */
+typedef enum {
+    REGION_FITNESS,
+    REGION_BREEDING,
+    REGION_SELECTION,
+    N_REGIONS,
+} PerfRegion;
+
+/* Whether counters are collected, set once by `perf_counters_enable` before
+ * any region is entered.
+ *
+ * Disabled regions cost a single predictable branch.
+ */
+extern int perf_counters_enabled;
+
+/* Start collecting hardware counters through `perf_event_open`.
+ */
+void perf_counters_enable(void);
+
+/* Snapshot the counters of the calling thread when entering or leaving a
+ * region, accumulating the difference into the totals of the thread.
+ */
+void perf_region_enter(const PerfRegion region);
+void perf_region_leave(const PerfRegion region);
+
+static inline void perf_begin(const PerfRegion region) {
+    if(perf_counters_enabled) {
+        perf_region_enter(region);
+    }
+}
+
+static inline void perf_end(const PerfRegion region) {
+    if(perf_counters_enabled) {
+        perf_region_leave(region);
+    }
+}
+
+/* Print the counters of every region, per thread and aggregated, with the
+ * instructions per cycle and the cycles per evaluation of the ODE.
+ */
+void perf_counters_report(FILE *const stream);
+
+/* Stop collecting counters, closing those of every thread, once the run and
+ * its report are over.
+ */
+void perf_counters_close(void);
@@ -13,18 +13,27 @@
 #define AM (1.0/IM)
 #define IQ (127773L)
 #define IR (2836)
-#define NTAB (32)
+#define NTAB (RANDOM_TABLE_SIZE)
 #define NDIV (1+(IM-1)/NTAB)
 #define EPS (1.2e-7)
 #define RNMX (1.0-EPS)
 
-float ran1(long *idum) {
-    static long iy = 0;
-    static long iv[NTAB];
+/* Bits of the integers `ran1` draws, between 1 and `IM - 1`.
+ */
+#define RAN1_BITS (31)
+
+/* The original `iy` and `iv` statics live in the `Random` stream, so that
+ * independent streams can be drawn from concurrently.
+ *
+ * Returns the integer `ran1` scales to its `float`.
+ */
+static long ran1_integer(Random *const rng) {
+    long *const idum = &(rng->idum);
+    long *const iv = rng->iv;
+    long iy = rng->iy;
 
     int j;
     long k;
-    float temp;
 
     if(*idum <= 0 || !iy) {
         if(-(*idum) < 1) {
@@ -57,8 +66,15 @@ float ran1(long *idum) {
     j = (int) (iy / (long) NDIV);
     iy = iv[j];
     iv[j] = *idum;
+    rng->iy = iy;
+
+    return iy;
+}
 
-    if((temp = AM*iy) > RNMX) {
+static float ran1(Random *const rng) {
+    float temp;
+
+    if((temp = AM*ran1_integer(rng)) > RNMX) {
         return RNMX;
     } else {
         return temp;
@@ -77,39 +93,40 @@ float ran1(long *idum) {
 
 /* Utility functions to simplify the use of ran1 and idum */
 #include <time.h>
-long idum;
 
-void randomize(void) {
-    idum = time(NULL);
-    if(idum > 0) {
-        idum = -idum;
-    }
+void random_seed(Random *const rng, const long seed) {
+    rng->idum = seed > 0 ? -seed : seed;
+    rng->iy = 0;
+}
+
+void randomize(Random *const rng) {
+    random_seed(rng, time(NULL));
 }
 
-float uniform(void) { // between 0.0 and 1.0
-    return ran1(&idum);
+float uniform(Random *const rng) { // between 0.0 and 1.0
+    return ran1(rng);
 }
 
 /* Based on von-neuman observation ; rather inefficient; */
-unsigned char random_bit(void) {
+static unsigned char random_bit(Random *const rng) {
     unsigned char f;
     unsigned char s;
 
     do {
-        f = 2*ran1(&idum);
-        s = 2*ran1(&idum);
+        f = 2*ran1(rng);
+        s = 2*ran1(rng);
     } while(f == s);
 
     return f;
 }
 
-unsigned UINTran(void) {
+unsigned UINTran(Random *const rng) {
     register unsigned char i;
     unsigned oneUL = 1U;
     unsigned base = 0U;
 
     for(i = 0; i < UINT_WIDTH; i++) {
-        if(random_bit()) {
+        if(random_bit(rng)) {
             base = oneUL;
             break;
         }
@@ -117,7 +134,7 @@ unsigned UINTran(void) {
 
     for(i++; i < UINT_WIDTH; i++) {
         base <<= 1;
-        if(random_bit()) {
+        if(random_bit(rng)) {
             base |= oneUL;
         }
     }
@@ -125,13 +142,13 @@ unsigned UINTran(void) {
     return base;
 }
 
-unsigned short USHRTran(void) {
+unsigned short USHRTran(Random *const rng) {
     register unsigned char i;
     unsigned short oneU = 1U;
     unsigned short base = 0U;
 
     for(i = 0; i < USHRT_WIDTH; i++) {
-        if(random_bit()) {
+        if(random_bit(rng)) {
             base = oneU;
             break;
         }
@@ -139,7 +156,7 @@ unsigned short USHRTran(void) {
 
     for(i++; i < USHRT_WIDTH; i++) {
         base <<= 1;
-        if(random_bit()) {
+        if(random_bit(rng)) {
             base |= oneU;
         }
     }
@@ -147,13 +164,13 @@ unsigned short USHRTran(void) {
     return base;
 }
 
-unsigned char UCHARran(void) {
+unsigned char UCHARran(Random *const rng) {
     register unsigned char i;
     unsigned char oneU = 1U;
     unsigned char base = 0U;
 
     for(i = 0; i < 8; i++) {
-        if(random_bit()) {
+        if(random_bit(rng)) {
             base = oneU;
             break;
         }
@@ -161,7 +178,7 @@ unsigned char UCHARran(void) {
 
     for(i++; i < 8; i++) {
         base <<= 1;
-        if(random_bit()) {
+        if(random_bit(rng)) {
             base |= oneU;
         }
     }
@@ -169,13 +186,23 @@ unsigned char UCHARran(void) {
     return base;
 }
 
-uint64_t random_U64_length(unsigned char width) {
+uint64_t random_U64(Random *const rng) {
+    uint64_t base = 0UL;
+
+    for(unsigned char i = 0; i < 64; i += RAN1_BITS) {
+        base = (base << RAN1_BITS) ^ (uint64_t) ran1_integer(rng);
+    }
+
+    return base;
+}
+
+uint64_t random_U64_length(Random *const rng, unsigned char width) {
     register unsigned char i;
     const unsigned long oneUL = 1UL;
     uint64_t base = 0UL;
 
     for(i = 0; i < width; i++) {
-        if(random_bit()) {
+        if(random_bit(rng)) {
             base = oneUL;
             break;
         }
@@ -183,7 +210,7 @@ uint64_t random_U64_length(unsigned char width) {
 
     for(i++; i < width; i++) {
         base <<= 1;
-        if(random_bit()) {
+        if(random_bit(rng)) {
             base |= oneUL;
         }
     }
@@ -191,13 +218,13 @@ uint64_t random_U64_length(unsigned char width) {
     return base;
 }
 
-uint32_t random_U32_length(unsigned char width) {
+uint32_t random_U32_length(Random *const rng, unsigned char width) {
     register unsigned char i;
     const unsigned oneUL = 1UL;
     uint32_t base = 0UL;
 
     for(i = 0; i < width; i++) {
-        if(random_bit()) {
+        if(random_bit(rng)) {
             base = oneUL;
             break;
         }
@@ -205,7 +232,7 @@ uint32_t random_U32_length(unsigned char width) {
 
     for(i++; i < width; i++) {
         base <<= 1;
-        if(random_bit()) {
+        if(random_bit(rng)) {
             base |= oneUL;
         }
     }
@@ -213,13 +240,13 @@ uint32_t random_U32_length(unsigned char width) {
     return base;
 }
 
-uint16_t random_U16_length(unsigned char width) {
+uint16_t random_U16_length(Random *const rng, unsigned char width) {
     register unsigned char i;
     const unsigned short oneUL = 1UL;
     uint16_t base = 0UL;
 
     for(i = 0; i < width; i++) {
-        if(random_bit()) {
+        if(random_bit(rng)) {
             base = oneUL;
             break;
         }
@@ -227,7 +254,7 @@ uint16_t random_U16_length(unsigned char width) {
 
     for(i++; i < width; i++) {
         base <<= 1;
-        if(random_bit()) {
+        if(random_bit(rng)) {
             base |= oneUL;
         }
     }
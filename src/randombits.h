@@ -1,21 +1,44 @@
+#pragma once
 #include <stdint.h>
 
+#define RANDOM_TABLE_SIZE (32)
+
+/* State of an independent `ran1` stream.
+ *
+ * Every genetic algorithm run owns its stream, so that concurrent runs neither
+ * share nor race on the generator state.
+ */
+typedef struct {
+    long idum;
+    long iy;
+    long iv[RANDOM_TABLE_SIZE];
+} Random;
+
 /* Generate random `flaot` between `0.0` and `1.0`.
  */
-float uniform(void);
+float uniform(Random *const rng);
+
+/* Seed the stream `rng` with `seed`.
+ */
+void random_seed(Random *const rng, const long seed);
 
 /* Utility functions to simplify the use of `ran1` and `idum`.
  */
-void randomize(void);
+void randomize(Random *const rng);
+
+/* Generate random unsigned long integer of 64 bits, from the whole integers
+ * of three `ran1` draws rather than one bit out of every two draws.
+ */
+uint64_t random_U64(Random *const rng);
 
 /* Generate random unsigned long integer of at most `width` bits
  */
-uint64_t random_U64_length(unsigned char width);
+uint64_t random_U64_length(Random *const rng, unsigned char width);
 
 /* Generate random unsigned integer of at most `width` bits
  */
-uint32_t random_U32_length(unsigned char width);
+uint32_t random_U32_length(Random *const rng, unsigned char width);
 
 /* Generate random unsigned short integer of at most `width` bits
  */
-uint16_t random_U16_length(unsigned char width);
+uint16_t random_U16_length(Random *const rng, unsigned char width);
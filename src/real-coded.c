@@ -0,0 +1,223 @@
+#include "real-coded.h"
+#include "equations.h"
+#include "genotype.h"
+#include "metrics.h"
+#include "perf-counters.h"
+#include "randombits.h"
+#include "report.h"
+#include "scheduler.h"
+#include "selection.h"
+#include <float.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+/* Distribution indices of the crossover and the mutation.
+ *
+ * The larger the index, the closer the children are to their parents.
+ */
+static const double eta_crossover = 15.0;
+static const double eta_mutation = 20.0;
+
+/* Probability of crossing over each of the parameters of two parents.
+ */
+static const double crossover_probability = 0.5;
+
+/* Probability of mutating each of the parameters of a child.
+ */
+static const double mutation_probability = 1.0 / N_PARAMETERS;
+
+const size_t parameter_offsets[N_PARAMETERS] = {
+    offsetof(Phenotype, phi),
+    offsetof(Phenotype, lambda),
+    offsetof(Phenotype, mu),
+    offsetof(Phenotype, sigma),
+    offsetof(Phenotype, delta),
+};
+
+static inline double clamp(const double x, const double lo, const double hi) {
+    return x < lo ? lo : (x > hi ? hi : x);
+}
+
+/* Spread factor of the bounded simulated binary crossover, given the distance
+ * `beta` of the parents to the nearest bound relative to their separation.
+ */
+static double sbx_spread(const double beta, const double u) {
+    const double alpha = 2.0 - pow(beta, -(eta_crossover + 1.0));
+
+    if(u <= 1.0 / alpha) {
+        return pow(u * alpha, 1.0 / (eta_crossover + 1.0));
+    }
+    return pow(1.0 / (2.0 - u * alpha), 1.0 / (eta_crossover + 1.0));
+}
+
+/* Generate two children from applying bounded simulated binary crossover (SBX)
+ * on the parameters of two parents.
+ */
+static void sbx_crossover(const Phenotype *const p1, const Phenotype *const p2, Phenotype *const c1, Phenotype *const c2, Random *const rng) {
+    *c1 = *p1;
+    *c2 = *p2;
+
+    for(unsigned iter = 0; iter < N_PARAMETERS; iter++) {
+        const double x1 = phenotype_parameter_value(p1, iter);
+        const double x2 = phenotype_parameter_value(p2, iter);
+
+        if(uniform(rng) > crossover_probability || fabs(x1 - x2) < 1e-14) {
+            continue;
+        }
+
+        const double y1 = fmin(x1, x2);
+        const double y2 = fmax(x1, x2);
+        const double u = uniform(rng);
+
+        const double b1 = sbx_spread(1.0 + 2.0 * (y1 - genotype_layout[iter].lower) / (y2 - y1), u);
+        const double b2 = sbx_spread(1.0 + 2.0 * (genotype_layout[iter].upper - y2) / (y2 - y1), u);
+        double v1 = clamp(0.5 * ((y1 + y2) - b1 * (y2 - y1)), genotype_layout[iter].lower, genotype_layout[iter].upper);
+        double v2 = clamp(0.5 * ((y1 + y2) + b2 * (y2 - y1)), genotype_layout[iter].lower, genotype_layout[iter].upper);
+
+        if(uniform(rng) < 0.5) {
+            const double tmp = v1;
+            v1 = v2;
+            v2 = tmp;
+        }
+        *phenotype_parameter(c1, iter) = v1;
+        *phenotype_parameter(c2, iter) = v2;
+    }
+}
+
+/* Mutate parameters of a phenotype with bounded polynomial mutation.
+ */
+static void polynomial_mutation(Phenotype *const p, Random *const rng) {
+    const double power = 1.0 / (eta_mutation + 1.0);
+
+    for(unsigned iter = 0; iter < N_PARAMETERS; iter++) {
+        if(uniform(rng) >= mutation_probability) {
+            continue;
+        }
+
+        double *const x = phenotype_parameter(p, iter);
+        const double range = genotype_layout[iter].upper - genotype_layout[iter].lower;
+        const double u = uniform(rng);
+        double delta;
+
+        if(u < 0.5) {
+            const double xy = 1.0 - (*x - genotype_layout[iter].lower) / range;
+            const double value = 2.0 * u + (1.0 - 2.0 * u) * pow(xy, eta_mutation + 1.0);
+            delta = pow(value, power) - 1.0;
+        } else {
+            const double xy = 1.0 - (genotype_layout[iter].upper - *x) / range;
+            const double value = 2.0 * (1.0 - u) + 2.0 * (u - 0.5) * pow(xy, eta_mutation + 1.0);
+            delta = 1.0 - pow(value, power);
+        }
+
+        *x = clamp(*x + delta * range, genotype_layout[iter].lower, genotype_layout[iter].upper);
+    }
+}
+
+/* Generate random individual with valid fitness.
+ */
+static RealIndividual get_random_real_individual(Random *const rng, const GeneticAlgorithmConfig *const config) {
+    RealIndividual individual;
+
+    do {
+        for(unsigned iter = 0; iter < N_PARAMETERS; iter++) {
+            *phenotype_parameter(&(individual.phenotype), iter) = genotype_layout[iter].lower + uniform(rng) * (genotype_layout[iter].upper - genotype_layout[iter].lower);
+        }
+        individual.fitness = get_phenotype_fitness(individual.phenotype, config->dataset, config->integrator, config->controller, config->event_location, FIDELITY_HIGH);
+    } while(individual.fitness == DBL_MAX);
+
+    return individual;
+}
+
+void real_coded_init(RealCodedAlgorithm *const ga, const GeneticAlgorithmConfig *const config, const long seed) {
+    const unsigned n_individuals = config->n_individuals;
+    ga->individuals = (RealIndividual *) malloc(sizeof(RealIndividual) * n_individuals);
+    ga->new_individuals = (RealIndividual *) malloc(sizeof(RealIndividual) * n_individuals);
+    ga->config = *config;
+    ga->n_individuals = n_individuals;
+    ga->generation = 0;
+    random_seed(&(ga->rng), seed);
+
+    for(unsigned iter = 0; iter < n_individuals; iter++) {
+        ga->individuals[iter] = get_random_real_individual(&(ga->rng), config);
+    }
+    ga->best = ga->individuals[0];
+    ga->best.fitness = DBL_MAX;
+}
+
+void real_coded_free(RealCodedAlgorithm *const ga) {
+    free(ga->individuals);
+    free(ga->new_individuals);
+    ga->individuals = NULL;
+    ga->new_individuals = NULL;
+}
+
+void real_coded_update_best(RealCodedAlgorithm *const ga) {
+    for(unsigned iter = 0; iter < ga->n_individuals; iter++) {
+        if(ga->individuals[iter].fitness < ga->best.fitness) {
+            ga->best = ga->individuals[iter];
+        }
+    }
+}
+
+void real_coded_breed(RealCodedAlgorithm *const ga) {
+    const unsigned n_individuals = ga->n_individuals;
+    const double *const fitness = &(ga->individuals[0].fitness);
+
+    perf_begin(REGION_BREEDING);
+    for(unsigned iter = 0; iter < (n_individuals - 1) / 2; iter++) {
+        const RealIndividual *const p1 = ga->individuals + tournament_selection(fitness, sizeof(RealIndividual), n_individuals, (unsigned char) ga->config.tournament_size, &(ga->rng));
+        const RealIndividual *const p2 = ga->individuals + tournament_selection(fitness, sizeof(RealIndividual), n_individuals, (unsigned char) ga->config.tournament_size, &(ga->rng));
+        RealIndividual *const c1 = ga->new_individuals + 2 * iter;
+        RealIndividual *const c2 = ga->new_individuals + 2 * iter + 1;
+
+        sbx_crossover(&(p1->phenotype), &(p2->phenotype), &(c1->phenotype), &(c2->phenotype), &(ga->rng));
+        polynomial_mutation(&(c1->phenotype), &(ga->rng));
+        polynomial_mutation(&(c2->phenotype), &(ga->rng));
+    }
+    perf_end(REGION_BREEDING);
+
+    ga->new_individuals[n_individuals - 2] = ga->best;
+    ga->new_individuals[n_individuals - 1] = ga->best;
+}
+
+void real_coded_replace(RealCodedAlgorithm *const ga) {
+    RealIndividual *tmp = ga->individuals;
+    ga->individuals = ga->new_individuals;
+    ga->new_individuals = tmp;
+    ga->generation++;
+}
+
+/* Scheduler task evaluating the `index`-th child of a run.
+ */
+static void evaluate_task(const unsigned index, void *const data) {
+    RealCodedAlgorithm *const ga = (RealCodedAlgorithm *) data;
+    RealIndividual *const individual = ga->new_individuals + index;
+
+    perf_begin(REGION_FITNESS);
+    individual->fitness = get_phenotype_fitness(individual->phenotype, ga->config.dataset, ga->config.integrator, ga->config.controller, ga->config.event_location, FIDELITY_HIGH);
+    perf_end(REGION_FITNESS);
+}
+
+RealIndividual run_real_coded_algorithm(const GeneticAlgorithmConfig *const config, const long seed, const Scheduler *const scheduler) {
+    RealCodedAlgorithm ga;
+    real_coded_init(&ga, config, seed);
+
+    for(unsigned generation = 0; generation < config->n_generations; generation++) {
+        real_coded_update_best(&ga);
+
+        if(generation % 100 == 0) {
+            report_progress(generation, ga.best.fitness, &(ga.best.phenotype));
+        }
+        metrics_update(generation, ga.best.fitness, &(ga.best.phenotype));
+
+        real_coded_breed(&ga);
+        scheduler_run(scheduler, ga.n_individuals, evaluate_task, &ga);
+        real_coded_replace(&ga);
+    }
+    real_coded_update_best(&ga);
+
+    const RealIndividual best = ga.best;
+    real_coded_free(&ga);
+    return best;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "equations.h"
+#include "genetic-algorithm.h"
+#include "randombits.h"
+#include "scheduler.h"
+#include <stddef.h>
+
+#define N_PARAMETERS 5
+
+/* Offsets of the parameters within a phenotype, in the order of the fields of
+ * the genotype, whose layout holds their search ranges.
+ */
+extern const size_t parameter_offsets[N_PARAMETERS];
+
+/* Address of the `index`-th parameter of a phenotype.
+ */
+static inline double *phenotype_parameter(Phenotype *const p, const unsigned index) {
+    return (double *) ((char *) p + parameter_offsets[index]);
+}
+
+/* Value of the `index`-th parameter of a phenotype.
+ */
+static inline double phenotype_parameter_value(const Phenotype *const p, const unsigned index) {
+    return *(const double *) ((const char *) p + parameter_offsets[index]);
+}
+
+typedef struct {
+    Phenotype phenotype;
+    double fitness;
+} RealIndividual;
+
+/* State of a single run of the real-coded genetic algorithm.
+ *
+ * Works directly on the parameters of the model, within the effective search
+ * ranges of `genotype.h`, so that precision is not limited by the
+ * discretisation of the genotype and no decoding is needed to evaluate an
+ * individual. Selection, evaluation and reporting are shared with the binary
+ * engine.
+ */
+typedef struct {
+    RealIndividual *individuals;
+    RealIndividual *new_individuals;
+    GeneticAlgorithmConfig config;
+    unsigned n_individuals;
+    unsigned generation;
+    RealIndividual best;
+    Random rng;
+} RealCodedAlgorithm;
+
+/* Allocate the population of `config->n_individuals` random individuals,
+ * drawing them from a stream seeded with `seed`.
+ */
+void real_coded_init(RealCodedAlgorithm *const ga, const GeneticAlgorithmConfig *const config, const long seed);
+
+/* Release the population of the run.
+ */
+void real_coded_free(RealCodedAlgorithm *const ga);
+
+/* Keep track of the best individual in the current population.
+ */
+void real_coded_update_best(RealCodedAlgorithm *const ga);
+
+/* Fill `new_individuals` with the (yet unevaluated) children of the current
+ * population, through simulated binary crossover and polynomial mutation.
+ */
+void real_coded_breed(RealCodedAlgorithm *const ga);
+
+/* Replace the current population with the evaluated children.
+ */
+void real_coded_replace(RealCodedAlgorithm *const ga);
+
+/* Main function to run the real-coded genetic algorithm.
+ */
+RealIndividual run_real_coded_algorithm(const GeneticAlgorithmConfig *const config, const long seed, const Scheduler *const scheduler);
@@ -0,0 +1,45 @@
+#include "report.h"
+#include "diversity.h"
+#include "equations.h"
+#include "genetic-algorithm.h"
+#include "genotype.h"
+#include <math.h>
+#include <stdio.h>
+
+void report_progress(const unsigned generation, const double fitness, const Phenotype *const p) {
+    printf("Generation %u\n", generation);
+    printf("Best fitness so far: %lf (%lf)\n", fitness, sqrt(fitness));
+    printf("\tphi: %f\n\tlambda: %f\n\tmu: %f\n\tsigma: %f\n\tdelta: %f\n",
+            p->phi, p->lambda, p->mu, p->sigma, p->delta);
+}
+
+void report_diversity_header(FILE *const stream) {
+    fprintf(stream, "generation\tfitness\thamming\tunique\tfixed\tphi\tlambda\tmu\tsigma\tdelta");
+    for(unsigned bit = 0; bit < genotype_bits; bit++) {
+        fprintf(stream, "\tbit%u", bit);
+    }
+    fprintf(stream, "\n");
+}
+
+void report_diversity(FILE *const stream, const unsigned generation, const double fitness, const Diversity *const diversity) {
+    const Phenotype *const spread = &(diversity->spread);
+
+    fprintf(stream, "%u\t%lf\t%f\t%u\t%u\t%g\t%g\t%g\t%g\t%g", generation, fitness,
+            diversity->mean_hamming, diversity->unique, diversity->fixed_bits,
+            spread->phi, spread->lambda, spread->mu, spread->sigma, spread->delta);
+    for(unsigned bit = 0; bit < genotype_bits; bit++) {
+        fprintf(stream, "\t%.3f", diversity->allele_frequency[bit]);
+    }
+    fprintf(stream, "\n");
+}
+
+void report_screening(FILE *const stream, const ScreeningStats *const screening) {
+    const unsigned long screened = screening->evaluations[FIDELITY_LOW];
+    const unsigned long confirmed = screening->evaluations[FIDELITY_HIGH];
+
+    fprintf(stream, "Children screened at low fidelity: %lu\n", screened);
+    fprintf(stream, "Children confirmed at full accuracy: %lu (%.1f%%)\n", confirmed, screened > 0 ? 100.0 * confirmed / screened : 0.0);
+    fprintf(stream, "Full accuracy evaluations saved: %lu\n", screened - confirmed);
+    fprintf(stream, "Misranked audited children: %lu of %lu (%.2f%%)\n", screening->misranked, screening->audited,
+            screening->audited > 0 ? 100.0 * screening->misranked / screening->audited : 0.0);
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "diversity.h"
+#include "equations.h"
+#include "genetic-algorithm.h"
+#include <stdio.h>
+
+/* Print the progress of a run: its generation, and the fitness and parameters
+ * of the best individual found so far.
+ */
+void report_progress(const unsigned generation, const double fitness, const Phenotype *const p);
+
+/* Write the header of the diversity statistics of `report_diversity`.
+ */
+void report_diversity_header(FILE *const stream);
+
+/* Write a tab separated line with the diversity of a generation: the best
+ * fitness, mean Hamming distance, unique genotypes, fixed bits, the spread of
+ * every parameter and the allele frequency of every bit.
+ */
+void report_diversity(FILE *const stream, const unsigned generation, const double fitness, const Diversity *const diversity);
+
+/* Print the evaluations performed at each fidelity when screening, the full
+ * accuracy evaluations saved, and the rate of misranked audited children.
+ */
+void report_screening(FILE *const stream, const ScreeningStats *const screening);
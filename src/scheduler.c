@@ -0,0 +1,26 @@
+#include "scheduler.h"
+#include "metrics.h"
+#include <omp.h>
+
+void scheduler_init(Scheduler *const scheduler, const unsigned n_threads) {
+    scheduler->n_threads = n_threads != 0 ? n_threads : (unsigned) omp_get_max_threads();
+}
+
+void scheduler_run(const Scheduler *const scheduler, const unsigned n_tasks, const Task task, void *const data) {
+    const int timed = metrics_enabled;
+
+#pragma omp parallel default (none) shared (task, data) firstprivate (n_tasks, timed) num_threads (scheduler->n_threads)
+    {
+        const double start = timed ? omp_get_wtime() : 0.0;
+
+        /* Threads running out of tasks stop counting as busy */
+#pragma omp for schedule (dynamic, 4) nowait
+        for(unsigned iter = 0; iter < n_tasks; iter++) {
+            task(iter, data);
+        }
+
+        if(timed) {
+            metrics_thread_busy(omp_get_thread_num(), omp_get_wtime() - start);
+        }
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+/* Work item of a batch, called once per index in `[0, n_tasks)`.
+ */
+typedef void (*Task)(const unsigned index, void *const data);
+
+/* Evaluation scheduler shared by every genetic algorithm run of the process.
+ *
+ * All batches are dispatched to the same OpenMP team, so that running several
+ * algorithms at once does not spawn (and oversubscribe) one team each.
+ */
+typedef struct {
+    unsigned n_threads;
+} Scheduler;
+
+/* Initialise a scheduler with `n_threads` threads, or as many as OpenMP
+ * allows if `n_threads` is `0`.
+ */
+void scheduler_init(Scheduler *const scheduler, const unsigned n_threads);
+
+/* Run `task` over `n_tasks` indices, balancing them dynamically among the
+ * threads of the scheduler since fitness evaluations vary wildly in cost.
+ */
+void scheduler_run(const Scheduler *const scheduler, const unsigned n_tasks, const Task task, void *const data);
@@ -0,0 +1,277 @@
+#include "selection.h"
+#include "randombits.h"
+#include "scheduler.h"
+#include <stddef.h>
+#include <stdlib.h>
+
+/* Individuals per chunk of the parallel passes of `select_best`, below twice
+ * which the population is selected from sequentially.
+ */
+#define SELECTION_CHUNK (1U << 16)
+
+/* Individuals sampled to bracket the `k`-th best one, and the margin in
+ * positions of the sample on either side of it, four standard deviations of
+ * the position of the `k`-th best in the sample.
+ */
+#define SELECTION_SAMPLE (1U << 14)
+#define SELECTION_MARGIN (256U)
+
+/* Fitness of the `index`-th individual of a strided population.
+ */
+static inline double fitness_at(const double *const fitness, const size_t stride, const unsigned index) {
+    return *(const double *) ((const char *) fitness + stride * index);
+}
+
+/* Grade of the `index`-th individual of a strided population.
+ */
+static inline unsigned char grade_at(const unsigned char *const grade, const size_t stride, const unsigned index) {
+    return grade[stride * index];
+}
+
+unsigned select_random_index(const unsigned n_individuals, Random *const rng) {
+    return uniform(rng) * n_individuals;
+}
+
+unsigned tournament_selection(const double *const fitness, const size_t stride, const unsigned n_individuals, const unsigned char size, Random *const rng) {
+    unsigned best = select_random_index(n_individuals, rng);
+
+    for(unsigned char iter = 1; iter < size; iter++) {
+        const unsigned tmp = select_random_index(n_individuals, rng);
+
+        if(fitness_at(fitness, stride, tmp) < fitness_at(fitness, stride, best)) {
+            best = tmp;
+        }
+    }
+
+    return best;
+}
+
+unsigned graded_tournament_selection(const double *const fitness, const unsigned char *const grade, const size_t stride, const unsigned n_individuals, const unsigned char size, Random *const rng) {
+    unsigned best = select_random_index(n_individuals, rng);
+
+    for(unsigned char iter = 1; iter < size; iter++) {
+        const unsigned tmp = select_random_index(n_individuals, rng);
+        const unsigned char tmp_grade = grade_at(grade, stride, tmp);
+        const unsigned char best_grade = grade_at(grade, stride, best);
+
+        if(tmp_grade > best_grade || (tmp_grade == best_grade && fitness_at(fitness, stride, tmp) < fitness_at(fitness, stride, best))) {
+            best = tmp;
+        }
+    }
+
+    return best;
+}
+
+/* Strided population ranked by `select_best`.
+ */
+typedef struct {
+    const double *fitness;
+    const unsigned char *grade;
+    size_t stride;
+} Ranking;
+
+/* Whether the `i`-th individual is better than the `j`-th one.
+ */
+static inline int is_better(const Ranking *const ranking, const unsigned i, const unsigned j) {
+    const unsigned char grade_i = grade_at(ranking->grade, ranking->stride, i);
+    const unsigned char grade_j = grade_at(ranking->grade, ranking->stride, j);
+
+    if(grade_i != grade_j) {
+        return grade_i > grade_j;
+    }
+
+    const double fitness_i = fitness_at(ranking->fitness, ranking->stride, i);
+    const double fitness_j = fitness_at(ranking->fitness, ranking->stride, j);
+
+    return fitness_i < fitness_j || (fitness_i == fitness_j && i < j);
+}
+
+/* Rearrange the `n` indices of `items` so that the first `k` are the best,
+ * by quickselect with random pivots.
+ */
+static void partial_select(const Ranking *const ranking, unsigned *const items, const unsigned n, const unsigned k, Random *const rng) {
+    unsigned first = 0;
+    unsigned last = n;
+
+    while(first < k && k < last) {
+        const unsigned pick = first + select_random_index(last - first, rng);
+        const unsigned pivot = items[pick];
+        items[pick] = items[last - 1];
+        items[last - 1] = pivot;
+
+        unsigned store = first;
+        for(unsigned iter = first; iter < last - 1; iter++) {
+            if(is_better(ranking, items[iter], pivot)) {
+                const unsigned tmp = items[iter];
+                items[iter] = items[store];
+                items[store++] = tmp;
+            }
+        }
+        items[last - 1] = items[store];
+        items[store] = pivot;
+
+        if(store < k) {
+            first = store + 1;
+        } else {
+            last = store;
+        }
+    }
+}
+
+/* Index of the best of the `n` indices of `items`.
+ */
+static unsigned best_of(const Ranking *const ranking, const unsigned *const items, const unsigned n) {
+    unsigned best = items[0];
+
+    for(unsigned iter = 1; iter < n; iter++) {
+        if(is_better(ranking, items[iter], best)) {
+            best = items[iter];
+        }
+    }
+
+    return best;
+}
+
+/* Chunked pass of `select_best` around the individuals `lower` and `upper`
+ * bracketing the `k`-th best, either of them unbounded if `has_lower` or
+ * `has_upper` is not set.
+ */
+typedef struct {
+    Ranking ranking;
+    unsigned n_individuals;
+    unsigned lower;
+    unsigned upper;
+    int has_lower;
+    int has_upper;
+    /* Individuals of every chunk above the bracket and within it, and where
+     * the chunk writes them.
+     */
+    unsigned *n_above;
+    unsigned *n_within;
+    unsigned *above_offset;
+    unsigned *within_offset;
+    unsigned *indices;
+} SelectionPass;
+
+/* Position of the `index`-th individual with respect to the bracket: `1`
+ * above, `0` within and `-1` below it.
+ */
+static inline int bracket_side(const SelectionPass *const pass, const unsigned index) {
+    if(pass->has_lower && is_better(&(pass->ranking), index, pass->lower)) {
+        return 1;
+    }
+
+    return !pass->has_upper || !is_better(&(pass->ranking), pass->upper, index) ? 0 : -1;
+}
+
+static void count_task(const unsigned chunk, void *const data) {
+    SelectionPass *const pass = (SelectionPass *) data;
+    const unsigned first = chunk * SELECTION_CHUNK;
+    const unsigned last = first + SELECTION_CHUNK < pass->n_individuals ? first + SELECTION_CHUNK : pass->n_individuals;
+    unsigned above = 0;
+    unsigned within = 0;
+
+    for(unsigned iter = first; iter < last; iter++) {
+        const int side = bracket_side(pass, iter);
+        above += side > 0;
+        within += side == 0;
+    }
+
+    pass->n_above[chunk] = above;
+    pass->n_within[chunk] = within;
+}
+
+static void scatter_task(const unsigned chunk, void *const data) {
+    SelectionPass *const pass = (SelectionPass *) data;
+    const unsigned first = chunk * SELECTION_CHUNK;
+    const unsigned last = first + SELECTION_CHUNK < pass->n_individuals ? first + SELECTION_CHUNK : pass->n_individuals;
+    unsigned above = pass->above_offset[chunk];
+    unsigned within = pass->within_offset[chunk];
+
+    for(unsigned iter = first; iter < last; iter++) {
+        const int side = bracket_side(pass, iter);
+        if(side > 0) {
+            pass->indices[above++] = iter;
+        } else if(side == 0) {
+            pass->indices[within++] = iter;
+        }
+    }
+}
+
+/* Order statistic `position` of the `n` indices of `items`, rearranging them.
+ */
+static unsigned order_statistic(const Ranking *const ranking, unsigned *const items, const unsigned n, const unsigned position, Random *const rng) {
+    partial_select(ranking, items, n, position, rng);
+
+    return best_of(ranking, items + position, n - position);
+}
+
+void select_best(const double *const fitness, const unsigned char *const grade, const size_t stride, const unsigned n_individuals, const unsigned k,
+        unsigned *const indices, const Scheduler *const scheduler, Random *const rng) {
+    const Ranking ranking = { .fitness = fitness, .grade = grade, .stride = stride };
+
+    if(k >= n_individuals || n_individuals < 2 * SELECTION_CHUNK) {
+        for(unsigned iter = 0; iter < n_individuals; iter++) {
+            indices[iter] = iter;
+        }
+        partial_select(&ranking, indices, n_individuals, k, rng);
+        return;
+    }
+
+    /* Bracket the k-th best between two order statistics of a sample */
+    unsigned *sample = (unsigned *) malloc(sizeof(unsigned) * SELECTION_SAMPLE);
+    for(unsigned iter = 0; iter < SELECTION_SAMPLE; iter++) {
+        sample[iter] = select_random_index(n_individuals, rng);
+    }
+    const unsigned position = (unsigned) ((double) k / n_individuals * SELECTION_SAMPLE);
+    const unsigned n_chunks = (n_individuals + SELECTION_CHUNK - 1) / SELECTION_CHUNK;
+    SelectionPass pass = {
+        .ranking = ranking,
+        .n_individuals = n_individuals,
+        .has_lower = position > SELECTION_MARGIN,
+        .has_upper = position + SELECTION_MARGIN < SELECTION_SAMPLE,
+        .n_above = (unsigned *) malloc(sizeof(unsigned) * 4 * n_chunks),
+        .indices = indices,
+    };
+    pass.n_within = pass.n_above + n_chunks;
+    pass.above_offset = pass.n_within + n_chunks;
+    pass.within_offset = pass.above_offset + n_chunks;
+
+    if(pass.has_lower) {
+        pass.lower = order_statistic(&ranking, sample, SELECTION_SAMPLE, position - SELECTION_MARGIN, rng);
+    }
+    if(pass.has_upper) {
+        const unsigned skip = pass.has_lower ? position - SELECTION_MARGIN : 0;
+        pass.upper = order_statistic(&ranking, sample + skip, SELECTION_SAMPLE - skip, position + SELECTION_MARGIN - skip, rng);
+    }
+    free(sample);
+
+    scheduler_run(scheduler, n_chunks, count_task, &pass);
+    unsigned n_above = 0;
+    unsigned n_within = 0;
+    for(unsigned chunk = 0; chunk < n_chunks; chunk++) {
+        n_above += pass.n_above[chunk];
+        n_within += pass.n_within[chunk];
+    }
+
+    if(n_above <= k && k <= n_above + n_within) {
+        unsigned above = 0;
+        unsigned within = n_above;
+        for(unsigned chunk = 0; chunk < n_chunks; chunk++) {
+            pass.above_offset[chunk] = above;
+            pass.within_offset[chunk] = within;
+            above += pass.n_above[chunk];
+            within += pass.n_within[chunk];
+        }
+        scheduler_run(scheduler, n_chunks, scatter_task, &pass);
+        partial_select(&ranking, indices + n_above, n_within, k - n_above, rng);
+    } else {
+        /* The sample missed the k-th best, which is most unlikely */
+        for(unsigned iter = 0; iter < n_individuals; iter++) {
+            indices[iter] = iter;
+        }
+        partial_select(&ranking, indices, n_individuals, k, rng);
+    }
+
+    free(pass.n_above);
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "randombits.h"
+#include "scheduler.h"
+#include <stddef.h>
+
+/* Tournament selection shared by every engine working on a population.
+ *
+ * The population is given as the address `fitness` of the fitness of its
+ * first individual, with the fitness of the following ones found every
+ * `stride` bytes, so that any array of structures holding a `double fitness`
+ * member can be used.
+ */
+
+/* Index of a random individual from the population (with replacement).
+ *
+ * Disregards their fitness or genotype.
+ */
+unsigned select_random_index(const unsigned n_individuals, Random *const rng);
+
+/* Index of the best individual from a tournament of `size` random
+ * individuals from the population.
+ */
+unsigned tournament_selection(const double *const fitness, const size_t stride, const unsigned n_individuals, const unsigned char size, Random *const rng);
+
+/* Index of the best individual from a tournament of `size` random
+ * individuals from the population, where fitness values are only compared
+ * between individuals of the same grade, and a higher grade always wins.
+ *
+ * The grade of each individual is found at the same `stride` from `grade`.
+ */
+unsigned graded_tournament_selection(const double *const fitness, const unsigned char *const grade, const size_t stride, const unsigned n_individuals, const unsigned char size, Random *const rng);
+
+/* Store in the first `k` entries of `indices` those of the `k` best
+ * individuals of the population, in no particular order, where a higher grade
+ * is always better and ties of fitness go to the lower index.
+ *
+ * `indices` must have room for `n_individuals` entries. Large populations
+ * are split in chunks on `scheduler`: the `k`-th best is bracketed between
+ * two individuals of a random sample, every chunk moves in parallel those
+ * above the bracket to the front and those within it next, and only the
+ * latter, a small fraction of the population, are then partially sorted, in
+ * linear expected time.
+ */
+void select_best(const double *const fitness, const unsigned char *const grade, const size_t stride, const unsigned n_individuals, const unsigned k,
+        unsigned *const indices, const Scheduler *const scheduler, Random *const rng);
@@ -0,0 +1,657 @@
+#define _GNU_SOURCE
+#include "server.h"
+#include "equations.h"
+#include "genetics.h"
+#include "integrator.h"
+#include "metrics.h"
+#include <errno.h>
+#include <omp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define SERVER_ID_LENGTH 64
+
+/* Connection jobs are received from and their responses sent to.
+ *
+ * It is shared by the reader of the connection and the jobs it queued, and
+ * released once all of them are done with it.
+ */
+typedef struct {
+    FILE *input;
+    int output;
+    pthread_mutex_t lock;
+    unsigned references;
+    int closed;
+} Client;
+
+typedef struct {
+    char id[SERVER_ID_LENGTH];
+    int priority;
+    unsigned long sequence;
+    double budget;
+    unsigned progress;
+    double start;
+    atomic_int cancelled;
+    GAConfig config;
+    Dataset dataset;
+    Client *client;
+} Job;
+
+typedef struct Connection Connection;
+
+/* Queue of pending jobs, a binary heap ordered by priority and then by
+ * arrival.
+ */
+typedef struct {
+    Job **jobs;
+    unsigned length;
+    unsigned capacity;
+    unsigned long sequence;
+    Job *running;
+    int listener;
+    int quit;
+    int draining;
+    /* Connections read by threads of their own, which the server waits for
+     * before it returns, signalled on `closed` as they end.
+     */
+    Connection *connections;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    pthread_cond_t closed;
+} Server;
+
+static void client_release(Client *const client) {
+    pthread_mutex_lock(&(client->lock));
+    const unsigned references = --client->references;
+    pthread_mutex_unlock(&(client->lock));
+
+    if(references == 0) {
+        if(client->input != NULL) {
+            fclose(client->input);
+        }
+        if(client->output != STDOUT_FILENO) {
+            close(client->output);
+        }
+        pthread_mutex_destroy(&(client->lock));
+        free(client);
+    }
+}
+
+/* Send a line to a client, unless it has disconnected.
+ */
+static void client_send(Client *const client, const char *const format, ...) __attribute__((format (printf, 2, 3)));
+static void client_send(Client *const client, const char *const format, ...) {
+    va_list args;
+    va_start(args, format);
+
+    /* A client that disconnected is dropped, its responses discarded */
+    pthread_mutex_lock(&(client->lock));
+    if(!client->closed && vdprintf(client->output, format, args) < 0 && errno == EPIPE) {
+        client->closed = 1;
+    }
+    pthread_mutex_unlock(&(client->lock));
+
+    va_end(args);
+}
+
+static int job_before(const Job *const a, const Job *const b) {
+    return a->priority > b->priority || (a->priority == b->priority && a->sequence < b->sequence);
+}
+
+static void heap_swap(Server *const server, const unsigned i, const unsigned j) {
+    Job *const tmp = server->jobs[i];
+    server->jobs[i] = server->jobs[j];
+    server->jobs[j] = tmp;
+}
+
+/* Queue `job`, returning `0` on success and `1` if memory runs out.
+ */
+static int heap_push(Server *const server, Job *const job) {
+    if(server->length == server->capacity) {
+        const unsigned capacity = server->capacity ? 2 * server->capacity : 16;
+        Job **const jobs = (Job **) realloc(server->jobs, sizeof(Job *) * capacity);
+        if(jobs == NULL) {
+            return 1;
+        }
+        server->jobs = jobs;
+        server->capacity = capacity;
+    }
+
+    unsigned index = server->length++;
+    server->jobs[index] = job;
+    while(index > 0 && job_before(server->jobs[index], server->jobs[(index - 1) / 2])) {
+        heap_swap(server, index, (index - 1) / 2);
+        index = (index - 1) / 2;
+    }
+
+    return 0;
+}
+
+static Job *heap_remove(Server *const server, unsigned index) {
+    Job *const job = server->jobs[index];
+    server->jobs[index] = server->jobs[--server->length];
+
+    while(index > 0 && job_before(server->jobs[index], server->jobs[(index - 1) / 2])) {
+        heap_swap(server, index, (index - 1) / 2);
+        index = (index - 1) / 2;
+    }
+    for(;;) {
+        const unsigned left = 2 * index + 1;
+        const unsigned right = left + 1;
+        unsigned first = index;
+
+        if(left < server->length && job_before(server->jobs[left], server->jobs[first])) {
+            first = left;
+        }
+        if(right < server->length && job_before(server->jobs[right], server->jobs[first])) {
+            first = right;
+        }
+        if(first == index) {
+            break;
+        }
+        heap_swap(server, index, first);
+        index = first;
+    }
+
+    return job;
+}
+
+/* Parse the arguments of a FIT request into `job`, returning an error message
+ * or `NULL` on success.
+ */
+static const char *parse_job(char *save, Job *const job) {
+    unsigned n_weights = 0;
+    job->dataset.length = 0;
+
+    for(char *token = strtok_r(NULL, " \t\r\n", &save); token != NULL; token = strtok_r(NULL, " \t\r\n", &save)) {
+        char *const value = strchr(token, '=');
+        if(value == NULL) {
+            return "expected key=value";
+        }
+        *value = '\0';
+
+        GeneticAlgorithmConfig *const algorithm = &(job->config.algorithm);
+        if(strcmp(token, "priority") == 0) {
+            job->priority = atoi(value + 1);
+        } else if(strcmp(token, "budget") == 0) {
+            job->budget = strtod(value + 1, NULL);
+        } else if(strcmp(token, "progress") == 0) {
+            job->progress = strtoul(value + 1, NULL, 10);
+        } else if(strcmp(token, "individuals") == 0) {
+            algorithm->n_individuals = strtoul(value + 1, NULL, 10);
+        } else if(strcmp(token, "generations") == 0) {
+            algorithm->n_generations = strtoul(value + 1, NULL, 10);
+        } else if(strcmp(token, "seed") == 0) {
+            job->config.seed = strtol(value + 1, NULL, 10);
+        } else if(strcmp(token, "integrator") == 0) {
+            unsigned method = 0;
+            while(method < INTEGRATORS && strcmp(value + 1, integrator_names[method]) != 0) {
+                method++;
+            }
+            if(method == INTEGRATORS) {
+                return "unknown integrator";
+            }
+            algorithm->integrator = (IntegratorMethod) method;
+        } else if(strcmp(token, "controller") == 0) {
+            unsigned controller = 0;
+            while(controller < CONTROLLERS && strcmp(value + 1, controller_names[controller]) != 0) {
+                controller++;
+            }
+            if(controller == CONTROLLERS) {
+                return "unknown controller";
+            }
+            algorithm->controller = (StepController) controller;
+        } else if(strcmp(token, "events") == 0) {
+            if(strcmp(value + 1, "on") != 0 && strcmp(value + 1, "off") != 0) {
+                return "events must be on or off";
+            }
+            algorithm->event_location = strcmp(value + 1, "on") == 0;
+        } else if(strcmp(token, "screening") == 0) {
+            algorithm->screening = strtod(value + 1, NULL);
+        } else if(strcmp(token, "mutation") == 0) {
+            algorithm->mutation = strtod(value + 1, NULL);
+        } else if(strcmp(token, "encoding") == 0) {
+            algorithm->encoding = strcmp(value + 1, "gray") == 0 ? ENCODING_GRAY : ENCODING_BINARY;
+        } else if(strcmp(token, "crossover") == 0) {
+            algorithm->crossover = strcmp(value + 1, "two-point") == 0 ? CROSSOVER_TWO_POINT
+                : (strcmp(value + 1, "uniform") == 0 ? CROSSOVER_UNIFORM : CROSSOVER_ONE_POINT);
+        } else if(strcmp(token, "y") == 0) {
+            job->dataset.length = dataset_parse_list(value + 1, job->dataset.y);
+        } else if(strcmp(token, "w") == 0) {
+            n_weights = dataset_parse_list(value + 1, job->dataset.w);
+        } else {
+            return "unknown key";
+        }
+    }
+
+    if(job->dataset.length < 2 || job->dataset.length > DATASET_MAX_LENGTH) {
+        return "y needs between 2 and 64 observations";
+    }
+    if(n_weights != 0 && n_weights != job->dataset.length) {
+        return "w and y differ in length";
+    }
+    for(unsigned iter = n_weights; iter < job->dataset.length; iter++) {
+        job->dataset.w[iter] = 1.0;
+    }
+    if(job->config.algorithm.n_individuals < 3) {
+        return "individuals must be at least 3";
+    }
+    if(job->config.algorithm.screening < 0.0 || job->config.algorithm.screening > 1.0) {
+        return "screening must be between 0 and 1";
+    }
+
+    job->config.algorithm.dataset = &(job->dataset);
+    return NULL;
+}
+
+/* Cancel the queued or running job `id` of `client`.
+ */
+static void cancel_job(Server *const server, Client *const client, const char *const id) {
+    Job *cancelled = NULL;
+
+    pthread_mutex_lock(&(server->lock));
+    if(server->running != NULL && server->running->client == client && strcmp(server->running->id, id) == 0) {
+        atomic_store(&(server->running->cancelled), 1);
+    } else {
+        for(unsigned iter = 0; iter < server->length; iter++) {
+            if(server->jobs[iter]->client == client && strcmp(server->jobs[iter]->id, id) == 0) {
+                cancelled = heap_remove(server, iter);
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&(server->lock));
+
+    if(cancelled != NULL) {
+        client_send(client, "RESULT %s cancelled - - - - - - 0 0 0\n", id);
+        client_release(client);
+        free(cancelled);
+    }
+}
+
+/* Cancel every job of a client that disconnected.
+ */
+static void cancel_client(Server *const server, Client *const client) {
+    pthread_mutex_lock(&(server->lock));
+    if(server->running != NULL && server->running->client == client) {
+        atomic_store(&(server->running->cancelled), 1);
+    }
+    for(unsigned iter = 0; iter < server->length;) {
+        if(server->jobs[iter]->client == client) {
+            free(heap_remove(server, iter));
+            client_release(client);
+        } else {
+            iter++;
+        }
+    }
+    pthread_mutex_unlock(&(server->lock));
+}
+
+struct Connection {
+    Server *server;
+    Client *client;
+    const GAConfig *defaults;
+    /* Whether the queued jobs of the connection still run after it is
+     * closed, as when piping jobs through the standard input, read by the
+     * server itself rather than by a thread in `connections`.
+     */
+    int drain;
+    /* Socket of the connection, shut down to stop its reader.
+     */
+    int socket;
+    Connection *next;
+};
+
+/* Read the requests of a connection until it is closed.
+ */
+static void *serve_connection(void *const data) {
+    Connection *const connection = (Connection *) data;
+    Server *const server = connection->server;
+    Client *const client = connection->client;
+    char *line = NULL;
+    size_t size = 0;
+
+    while(getline(&line, &size, client->input) > 0) {
+        char *save;
+        const char *const command = strtok_r(line, " \t\r\n", &save);
+        const char *const id = command != NULL ? strtok_r(NULL, " \t\r\n", &save) : NULL;
+
+        if(command == NULL) {
+            continue;
+        }
+        if(strcmp(command, "QUIT") == 0) {
+            pthread_mutex_lock(&(server->lock));
+            server->quit = 1;
+            if(server->running != NULL) {
+                atomic_store(&(server->running->cancelled), 1);
+            }
+            if(server->listener >= 0) {
+                shutdown(server->listener, SHUT_RDWR);
+            }
+            pthread_cond_broadcast(&(server->ready));
+            pthread_mutex_unlock(&(server->lock));
+            break;
+        }
+        if(id == NULL || strlen(id) >= SERVER_ID_LENGTH) {
+            client_send(client, "ERROR - missing or too long id\n");
+            continue;
+        }
+        if(strcmp(command, "CANCEL") == 0) {
+            cancel_job(server, client, id);
+            continue;
+        }
+        if(strcmp(command, "FIT") != 0) {
+            client_send(client, "ERROR %s unknown command\n", id);
+            continue;
+        }
+
+        Job *job = (Job *) calloc(1, sizeof(Job));
+        if(job == NULL) {
+            client_send(client, "ERROR %s out of memory\n", id);
+            continue;
+        }
+        strcpy(job->id, id);
+        job->config = *(connection->defaults);
+        job->config.progress_data = job;
+        job->progress = 100;
+        job->client = client;
+        atomic_init(&(job->cancelled), 0);
+
+        const char *const error = parse_job(save, job);
+        if(error != NULL) {
+            client_send(client, "ERROR %s %s\n", id, error);
+            free(job);
+            continue;
+        }
+
+        pthread_mutex_lock(&(client->lock));
+        client->references++;
+        pthread_mutex_unlock(&(client->lock));
+
+        /* Jobs arriving once the server quits are refused rather than left
+         * in the queue it cancelled */
+        pthread_mutex_lock(&(server->lock));
+        job->sequence = server->sequence;
+        const char *const refused = server->quit ? "server quitting" : (heap_push(server, job) != 0 ? "out of memory" : NULL);
+        if(refused == NULL) {
+            server->sequence++;
+            pthread_cond_signal(&(server->ready));
+        }
+        pthread_mutex_unlock(&(server->lock));
+
+        if(refused != NULL) {
+            client_send(client, "ERROR %s %s\n", id, refused);
+            client_release(client);
+            free(job);
+            continue;
+        }
+        client_send(client, "QUEUED %s\n", id);
+    }
+    free(line);
+
+    if(!connection->drain) {
+        cancel_client(server, client);
+        pthread_mutex_lock(&(client->lock));
+        client->closed = 1;
+        pthread_mutex_unlock(&(client->lock));
+    }
+    client_release(client);
+
+    if(!connection->drain) {
+        pthread_mutex_lock(&(server->lock));
+        Connection **link = &(server->connections);
+        while(*link != connection) {
+            link = &((*link)->next);
+        }
+        *link = connection->next;
+        pthread_cond_broadcast(&(server->closed));
+        pthread_mutex_unlock(&(server->lock));
+    }
+    free(connection);
+
+    return NULL;
+}
+
+/* Progress callback of the jobs, reporting and enforcing cancellation and
+ * time budgets.
+ */
+static int job_progress(const GAProgress *const progress, void *const data) {
+    Job *const job = (Job *) data;
+
+    if(job->progress != 0 && progress->generation % job->progress == 0) {
+        client_send(job->client, "PROGRESS %s %u %lu %lf\n", job->id, progress->generation, progress->evaluations, progress->fitness);
+    }
+    metrics_update(progress->generation, progress->fitness, &(progress->best));
+
+    return atomic_load(&(job->cancelled)) || (job->budget > 0.0 && omp_get_wtime() - job->start > job->budget);
+}
+
+static void run_job(Job *const job) {
+    job->start = omp_get_wtime();
+    job->config.progress = job_progress;
+
+    GAContext *const context = ga_create(&(job->config));
+    if(context == NULL) {
+        client_send(job->client, "ERROR %s could not create the fit\n", job->id);
+        return;
+    }
+    const int stopped = ga_run(context);
+    const Individual best = ga_best(context);
+    const Phenotype p = ga_best_phenotype(context);
+    const double seconds = omp_get_wtime() - job->start;
+
+    const char *status = "done";
+    if(stopped) {
+        status = atomic_load(&(job->cancelled)) ? "cancelled" : "timeout";
+    }
+    client_send(job->client, "RESULT %s %s %lf %f %f %f %f %f %u %lu %f\n", job->id, status, best.fitness,
+            p.phi, p.lambda, p.mu, p.sigma, p.delta, ga_generation(context), ga_evaluations(context), seconds);
+
+    ga_destroy(context);
+}
+
+/* Run the queued jobs one after the other until told to quit.
+ */
+static void *work(void *const data) {
+    Server *const server = (Server *) data;
+
+    for(;;) {
+        pthread_mutex_lock(&(server->lock));
+        while(server->length == 0 && !server->quit && !server->draining) {
+            pthread_cond_wait(&(server->ready), &(server->lock));
+        }
+        if(server->quit || server->length == 0) {
+            pthread_mutex_unlock(&(server->lock));
+            break;
+        }
+        Job *const job = heap_remove(server, 0);
+        server->running = job;
+        pthread_mutex_unlock(&(server->lock));
+
+        run_job(job);
+
+        pthread_mutex_lock(&(server->lock));
+        server->running = NULL;
+        pthread_mutex_unlock(&(server->lock));
+        client_release(job->client);
+        free(job);
+    }
+
+    return NULL;
+}
+
+/* Client reading from `input` and writing to `output`, or `NULL` if memory
+ * runs out.
+ */
+static Client *client_create(FILE *const input, const int output) {
+    Client *client = (Client *) calloc(1, sizeof(Client));
+    if(client == NULL) {
+        return NULL;
+    }
+    client->input = input;
+    client->output = output;
+    client->references = 1;
+    pthread_mutex_init(&(client->lock), NULL);
+
+    return client;
+}
+
+static int listen_socket(const char *const path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "%s: socket path too long\n", path);
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path);
+    if(fd < 0 || bind(fd, (struct sockaddr *) &address, sizeof(address)) != 0 || listen(fd, 16) != 0) {
+        perror(path);
+        return -1;
+    }
+
+    return fd;
+}
+
+int run_server(const char *const path, const GAConfig *const defaults) {
+    /* Writing to a disconnected client fails with EPIPE instead */
+    signal(SIGPIPE, SIG_IGN);
+
+    Server server = { .jobs = NULL, .length = 0, .capacity = 0, .sequence = 0, .running = NULL, .listener = -1, .quit = 0, .draining = 0, .connections = NULL };
+    pthread_mutex_init(&(server.lock), NULL);
+    pthread_cond_init(&(server.ready), NULL);
+    pthread_cond_init(&(server.closed), NULL);
+
+    pthread_t worker;
+    pthread_create(&worker, NULL, work, &server);
+
+    int status = 0;
+    if(strcmp(path, "-") == 0) {
+        Connection *connection = (Connection *) malloc(sizeof(Connection));
+        Client *const client = connection != NULL ? client_create(stdin, STDOUT_FILENO) : NULL;
+        if(client == NULL) {
+            fprintf(stderr, "Could not allocate the connection\n");
+            free(connection);
+            status = 1;
+        } else {
+            *connection = (Connection) { .server = &server, .client = client, .defaults = defaults, .drain = 1, .socket = -1, .next = NULL };
+            serve_connection(connection);
+        }
+
+        pthread_mutex_lock(&(server.lock));
+        server.draining = 1;
+        pthread_cond_broadcast(&(server.ready));
+        pthread_mutex_unlock(&(server.lock));
+    } else {
+        const int listener = listen_socket(path);
+        status = listener < 0;
+        pthread_mutex_lock(&(server.lock));
+        server.listener = listener;
+        pthread_mutex_unlock(&(server.lock));
+
+        while(listener >= 0) {
+            const int fd = accept(listener, NULL, NULL);
+
+            pthread_mutex_lock(&(server.lock));
+            const int quit = server.quit;
+            pthread_mutex_unlock(&(server.lock));
+            if(quit) {
+                if(fd >= 0) {
+                    close(fd);
+                }
+                break;
+            }
+            if(fd < 0) {
+                if(errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                perror("accept");
+                status = 1;
+                break;
+            }
+
+            Connection *connection = (Connection *) malloc(sizeof(Connection));
+            FILE *const input = fdopen(fd, "r");
+            const int output = input != NULL ? dup(fd) : -1;
+            Client *const client = connection != NULL && output >= 0 ? client_create(input, output) : NULL;
+            if(client == NULL) {
+                fprintf(stderr, "Could not allocate the connection\n");
+                free(connection);
+                if(output >= 0) {
+                    close(output);
+                }
+                if(input != NULL) {
+                    fclose(input);
+                } else {
+                    close(fd);
+                }
+                continue;
+            }
+            *connection = (Connection) { .server = &server, .client = client, .defaults = defaults, .drain = 0, .socket = fd };
+
+            pthread_mutex_lock(&(server.lock));
+            connection->next = server.connections;
+            server.connections = connection;
+            pthread_mutex_unlock(&(server.lock));
+
+            pthread_t reader;
+            if(pthread_create(&reader, NULL, serve_connection, connection) != 0) {
+                pthread_mutex_lock(&(server.lock));
+                server.connections = connection->next;
+                pthread_mutex_unlock(&(server.lock));
+                client_release(client);
+                free(connection);
+                continue;
+            }
+            pthread_detach(reader);
+        }
+
+        pthread_mutex_lock(&(server.lock));
+        server.quit = 1;
+        pthread_cond_broadcast(&(server.ready));
+        pthread_mutex_unlock(&(server.lock));
+        if(listener >= 0) {
+            close(listener);
+            unlink(path);
+        }
+    }
+
+    pthread_join(worker, NULL);
+
+    /* Cancel the jobs still queued when told to quit, with `quit` set so that
+     * the readers queue no more, and then stop the readers and wait for them,
+     * as they use the server */
+    pthread_mutex_lock(&(server.lock));
+    server.quit = 1;
+    for(unsigned iter = 0; iter < server.length; iter++) {
+        Job *const job = server.jobs[iter];
+        client_send(job->client, "RESULT %s cancelled - - - - - - 0 0 0\n", job->id);
+        client_release(job->client);
+        free(job);
+    }
+    server.length = 0;
+    for(const Connection *connection = server.connections; connection != NULL; connection = connection->next) {
+        shutdown(connection->socket, SHUT_RD);
+    }
+    while(server.connections != NULL) {
+        pthread_cond_wait(&(server.closed), &(server.lock));
+    }
+    pthread_mutex_unlock(&(server.lock));
+
+    free(server.jobs);
+    pthread_cond_destroy(&(server.closed));
+    pthread_cond_destroy(&(server.ready));
+    pthread_mutex_destroy(&(server.lock));
+    return status;
+}
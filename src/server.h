@@ -0,0 +1,32 @@
+#pragma once
+#include "genetics.h"
+
+/* Serve fit jobs on the Unix domain socket at `path`, or on the standard
+ * input and output if `path` is "-", until told to quit (or, on the standard
+ * input, until it is closed and every job has finished).
+ *
+ * The jobs run one after the other on a persistent worker thread, whose
+ * OpenMP team stays warm between jobs, taking the highest priority queued job
+ * first. Jobs use `defaults` for every parameter they do not set. Jobs still
+ * queued when told to quit are answered as cancelled, and clients that
+ * disconnect are dropped, as the server ignores `SIGPIPE`.
+ *
+ * Every request and response is a line of space separated words:
+ *
+ *     FIT <id> [key=value ...] y=<y0>,<y1>,... [w=<w0>,<w1>,...]
+ *     CANCEL <id>
+ *     QUIT
+ *
+ * where the keys of a fit are `priority` (default 0, higher first),
+ * `budget` (seconds, default unlimited), `individuals`, `generations`,
+ * `seed`, `encoding`, `crossover`, `mutation`, `integrator`, `controller`,
+ * `events` (`off`, the default, or `on` to end the steps on the crossings of
+ * `x = delta`), `screening` and `progress` (generations between progress
+ * reports, default 100). The server answers with
+ *
+ *     QUEUED <id>
+ *     PROGRESS <id> <generation> <evaluations> <fitness>
+ *     RESULT <id> <done|cancelled|timeout> <fitness> <phi> <lambda> <mu> <sigma> <delta> <generations> <evaluations> <seconds>
+ *     ERROR <id> <message>
+ */
+int run_server(const char *const path, const GAConfig *const defaults);
@@ -0,0 +1,254 @@
+#include "stochastic.h"
+#include "equations.h"
+#include "scheduler.h"
+#include <math.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Paths integrated together by every task, a multiple of the lanes of the
+ * widest vector registers.
+ */
+#define SDE_BLOCK (64)
+
+/* Versions of the integration of a block for the vector extensions of the
+ * machine, the widest of them chosen when the program is loaded, each one
+ * calling the SIMD variants of `model_equation` and of the math library of
+ * its width.
+ */
+#if defined(__x86_64__)
+#define SDE_TARGETS __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define SDE_TARGETS
+#endif
+
+/* Relative accuracy of the quantiles, which sets the growth of the buckets of
+ * the histograms, and the buckets of every histogram: one for the extinct
+ * paths and the rest up to about 3e9 birds.
+ */
+#define SKETCH_ACCURACY (0.01)
+#define SKETCH_BUCKETS (1100)
+
+const char *const sde_scheme_names[SDE_SCHEMES] = {
+    [SDE_EULER_MARUYAMA] = "euler",
+    [SDE_MILSTEIN] = "milstein",
+};
+
+const double sde_quantiles[SDE_QUANTILES] = { 0.05, 0.25, 0.5, 0.75, 0.95 };
+
+static const double two_pi = 6.283185307179586477;
+
+/* Independent xoshiro256+ streams of the lanes of a block, stored by
+ * component so that every lane draws at once.
+ */
+typedef struct {
+    uint64_t s[4][SDE_BLOCK];
+} LaneRandom;
+
+/* Simulation shared by the tasks, one per block of paths.
+ */
+typedef struct {
+    const SdeConfig *config;
+    const Phenotype *p;
+    double x0;
+    uint64_t seed;
+    double log_gamma;
+    /* Histograms of every thread, one per year.
+     */
+    uint64_t *counts;
+} SdeJob;
+
+static uint64_t splitmix64(uint64_t *const state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15UL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9UL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBUL;
+
+    return z ^ (z >> 31);
+}
+
+static inline double bits_to_double(const uint64_t bits) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+
+    return value;
+}
+
+static void lanes_seed(LaneRandom *const rng, const uint64_t seed, const unsigned block) {
+    uint64_t state = seed ^ (0xD1B54A32D192ED03UL * (block + 1UL));
+
+    for(unsigned lane = 0; lane < SDE_BLOCK; lane++) {
+        for(unsigned word = 0; word < 4; word++) {
+            rng->s[word][lane] = splitmix64(&state);
+        }
+    }
+}
+
+/* Standard normal deviate in every lane, by the Box-Muller transform of the
+ * uniform deviates of lanes `i` and `i + SDE_BLOCK / 2`.
+ */
+static inline void lanes_normal(LaneRandom *const rng, double *const z) {
+    double u[SDE_BLOCK];
+
+#pragma omp simd
+    for(unsigned lane = 0; lane < SDE_BLOCK; lane++) {
+        const uint64_t s0 = rng->s[0][lane];
+        const uint64_t s1 = rng->s[1][lane];
+        const uint64_t s2 = rng->s[2][lane] ^ s0;
+        const uint64_t s3 = rng->s[3][lane] ^ s1;
+
+        /* Upper 52 bits as the mantissa of a double in [1, 2) */
+        u[lane] = bits_to_double(((s0 + rng->s[3][lane]) >> 12) | 0x3FF0000000000000UL);
+
+        rng->s[0][lane] = s0 ^ s3;
+        rng->s[1][lane] = s1 ^ s2;
+        rng->s[2][lane] = s2 ^ (s1 << 17);
+        rng->s[3][lane] = (s3 << 45) | (s3 >> 19);
+    }
+
+#pragma omp simd
+    for(unsigned lane = 0; lane < SDE_BLOCK / 2; lane++) {
+        const double radius = sqrt(-2.0 * log(2.0 - u[lane]));
+        const double angle = two_pi * (u[lane + SDE_BLOCK / 2] - 1.0);
+
+        /* The sine from the cosine, cheaper than another call, which GCC
+         * would merge with the first into `sincos`, without vector variant */
+        const double cosine = cos(angle);
+        const double sine = sqrt(fmax(1.0 - cosine * cosine, 0.0));
+
+        z[lane] = radius * cosine;
+        z[lane + SDE_BLOCK / 2] = angle < 0.5 * two_pi ? radius * sine : -radius * sine;
+    }
+}
+
+/* Count the first `n_lanes` paths of `x` in the histogram `counts`, bucket
+ * `k + 1` holding the populations in `[γ^k, γ^(k + 1))`.
+ */
+static inline void count_paths(uint64_t *const counts, const double *const x, const unsigned n_lanes, const double log_gamma) {
+    int bucket[SDE_BLOCK];
+
+#pragma omp simd
+    for(unsigned lane = 0; lane < SDE_BLOCK; lane++) {
+        const double index = fmin(log(fmax(x[lane], 1.0)) / log_gamma + 1.0, SKETCH_BUCKETS - 1);
+        bucket[lane] = x[lane] < 1.0 ? 0 : (int) index;
+    }
+    for(unsigned lane = 0; lane < n_lanes; lane++) {
+        counts[bucket[lane]]++;
+    }
+}
+
+SDE_TARGETS static void simulate_block(const unsigned index, void *const data) {
+    const SdeJob *const job = (const SdeJob *) data;
+    const SdeConfig *const config = job->config;
+    const Phenotype *const p = job->p;
+    const unsigned n_lanes = config->n_paths - index * SDE_BLOCK < SDE_BLOCK ? config->n_paths - index * SDE_BLOCK : SDE_BLOCK;
+    uint64_t *counts = job->counts + (size_t) omp_get_thread_num() * (config->n_years + 1) * SKETCH_BUCKETS;
+
+    const double dt = 1.0 / config->steps_per_year;
+    const double sqrt_dt = sqrt(dt);
+    const double noise = config->noise;
+    /* Itô correction of the diffusion sqrt(νx), whose product with its
+     * derivative is ν/2 */
+    const double correction = config->scheme == SDE_MILSTEIN ? 0.25 * noise : 0.0;
+
+    LaneRandom rng;
+    double x[SDE_BLOCK];
+    double z[SDE_BLOCK];
+    double drift[SDE_BLOCK];
+    lanes_seed(&rng, job->seed, index);
+    for(unsigned lane = 0; lane < SDE_BLOCK; lane++) {
+        x[lane] = job->x0;
+    }
+    count_paths(counts, x, n_lanes, job->log_gamma);
+
+    for(unsigned year = 1; year <= config->n_years; year++) {
+        for(unsigned step = 0; step < config->steps_per_year; step++) {
+            lanes_normal(&rng, z);
+
+            /* The drift in a loop of its own, since GCC does not if-convert
+             * the update next to a call */
+#pragma omp simd
+            for(unsigned lane = 0; lane < SDE_BLOCK; lane++) {
+                drift[lane] = model_equation(x[lane], p);
+            }
+
+#pragma omp simd
+            for(unsigned lane = 0; lane < SDE_BLOCK; lane++) {
+                const double dw = sqrt_dt * z[lane];
+                const double next = x[lane] + drift[lane] * dt + sqrt(noise * x[lane]) * dw + correction * (dw * dw - dt);
+
+                /* Extinction is absorbing */
+                x[lane] = (x[lane] >= 1.0) & (next >= 1.0) ? next : 0.0;
+            }
+        }
+
+        counts += SKETCH_BUCKETS;
+        count_paths(counts, x, n_lanes, job->log_gamma);
+    }
+}
+
+void simulate_sde(const SdeConfig *const config, const Phenotype *const p, const double x0, const long seed, const Scheduler *const scheduler, SdeYear *const forecast) {
+    const double start = omp_get_wtime();
+    const double gamma = (1.0 + SKETCH_ACCURACY) / (1.0 - SKETCH_ACCURACY);
+    const size_t n_counts = (size_t) (config->n_years + 1) * SKETCH_BUCKETS;
+    const unsigned n_blocks = (config->n_paths + SDE_BLOCK - 1) / SDE_BLOCK;
+
+    SdeJob job = {
+        .config = config,
+        .p = p,
+        .x0 = x0,
+        .seed = (uint64_t) seed,
+        .log_gamma = log(gamma),
+        .counts = (uint64_t *) calloc(scheduler->n_threads * n_counts, sizeof(uint64_t)),
+    };
+    scheduler_run(scheduler, n_blocks, simulate_block, &job);
+
+    for(unsigned thread = 1; thread < scheduler->n_threads; thread++) {
+        for(size_t iter = 0; iter < n_counts; iter++) {
+            job.counts[iter] += job.counts[thread * n_counts + iter];
+        }
+    }
+
+    /* Every quantile is estimated by the midpoint, relative to its bounds, of
+     * the bucket holding it */
+    for(unsigned year = 0; year <= config->n_years; year++) {
+        const uint64_t *const counts = job.counts + (size_t) year * SKETCH_BUCKETS;
+
+        forecast[year].extinction = (double) counts[0] / config->n_paths;
+        for(unsigned quantile = 0; quantile < SDE_QUANTILES; quantile++) {
+            const uint64_t rank = (uint64_t) (sde_quantiles[quantile] * (config->n_paths - 1));
+            uint64_t seen = counts[0];
+            unsigned bucket = 0;
+            while(seen <= rank) {
+                seen += counts[++bucket];
+            }
+            forecast[year].quantiles[quantile] = bucket == 0 ? 0.0 : 2.0 * pow(gamma, bucket) / (gamma + 1.0);
+        }
+    }
+    free(job.counts);
+
+    const double elapsed = omp_get_wtime() - start;
+    fprintf(stderr, "%u paths of %u years in %.3lf s, %.1f million steps per second\n", config->n_paths, config->n_years, elapsed,
+            (double) config->n_paths * config->n_years * config->steps_per_year / elapsed * 1.0e-6);
+}
+
+void print_sde(const SdeConfig *const config, const SdeYear *const forecast, const Dataset *const data, FILE *const output) {
+    fprintf(output, "year\tobserved\textinction");
+    for(unsigned quantile = 0; quantile < SDE_QUANTILES; quantile++) {
+        fprintf(output, "\tq%02.0f", 100.0 * sde_quantiles[quantile]);
+    }
+    fprintf(output, "\n");
+
+    for(unsigned year = 0; year <= config->n_years; year++) {
+        if(year < data->length) {
+            fprintf(output, "%u\t%lf\t%lf", year, data->y[year], forecast[year].extinction);
+        } else {
+            fprintf(output, "%u\t-\t%lf", year, forecast[year].extinction);
+        }
+        for(unsigned quantile = 0; quantile < SDE_QUANTILES; quantile++) {
+            fprintf(output, "\t%lf", forecast[year].quantiles[quantile]);
+        }
+        fprintf(output, "\n");
+    }
+}
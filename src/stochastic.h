@@ -0,0 +1,72 @@
+#pragma once
+#include "equations.h"
+#include "scheduler.h"
+#include <stdio.h>
+
+/* Scheme integrating the paths of the stochastic model.
+ */
+typedef enum {
+    /* Strong order 1/2.
+     */
+    SDE_EULER_MARUYAMA,
+    /* Strong order 1, adding the Itô correction of the diffusion.
+     */
+    SDE_MILSTEIN,
+    SDE_SCHEMES,
+} SdeScheme;
+
+/* Command line names of the schemes.
+ */
+extern const char *const sde_scheme_names[SDE_SCHEMES];
+
+/* Quantiles of the population reported every year.
+ */
+#define SDE_QUANTILES (5)
+extern const double sde_quantiles[SDE_QUANTILES];
+
+/* Demographic noise added to the model,
+ *
+ *     dx = (γx - βx^2 - λΨ(x, μ, σ, δ)) dt + sqrt(νx) dW
+ *
+ * with extinction absorbing every path that falls below one bird.
+ */
+typedef struct {
+    unsigned n_paths;
+    /* Years simulated after the initial condition.
+     */
+    unsigned n_years;
+    unsigned steps_per_year;
+    /* Variance of the yearly change of the population per bird, `ν`.
+     */
+    double noise;
+    SdeScheme scheme;
+} SdeConfig;
+
+/* Distribution of the paths at the end of a year.
+ */
+typedef struct {
+    /* Fraction of the paths extinct.
+     */
+    double extinction;
+    /* Population at every one of `sde_quantiles`, within 1% of the exact
+     * quantile of the paths.
+     */
+    double quantiles[SDE_QUANTILES];
+} SdeYear;
+
+/* Simulate `config->n_paths` paths of the model with parameters `p` from
+ * `x0`, storing in `forecast` the distribution of the paths at the end of
+ * every year, `config->n_years + 1` of them counting the initial condition.
+ *
+ * Paths advance in blocks of lanes integrated together with the SIMD
+ * variants of `model_equation`, each block with random streams seeded from
+ * `seed` and its index, so that the forecast does not depend on the threads
+ * of `scheduler` running them. No path is stored: every thread counts the
+ * paths in a histogram of logarithmic buckets per year, and the histograms
+ * are added up at the end.
+ */
+void simulate_sde(const SdeConfig *const config, const Phenotype *const p, const double x0, const long seed, const Scheduler *const scheduler, SdeYear *const forecast);
+
+/* Print the forecast of `config` next to the observations of `data`.
+ */
+void print_sde(const SdeConfig *const config, const SdeYear *const forecast, const Dataset *const data, FILE *const output);
@@ -0,0 +1,249 @@
+#include "survivors.h"
+#include "genetic-algorithm.h"
+#include "genotype.h"
+#include "scheduler.h"
+#include "selection.h"
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Candidates per chunk of the parallel passes.
+ */
+#define SURVIVOR_CHUNK (1U << 16)
+
+/* Candidates ahead whose slot is prefetched, hiding the latency of the random
+ * accesses to a table much larger than the cache.
+ */
+#define PREFETCH_DISTANCE (16U)
+
+/* Empty slot of the table of distinct genotypes.
+ */
+#define SLOT_EMPTY (UINT64_MAX)
+
+/* Individual competing to survive, and its grade for `select_best`: `0` for
+ * the copies of a genotype but one, and its fidelity plus one otherwise.
+ */
+typedef struct {
+    Genotype genotype;
+    double fitness;
+    unsigned char fidelity;
+    unsigned char grade;
+    /* Parents of the candidate, when tracing.
+     */
+    Lineage lineage;
+} Candidate;
+
+struct SurvivorScratch {
+    unsigned n_individuals;
+    /* Parents followed by the children.
+     */
+    Candidate *candidates;
+    unsigned *indices;
+    /* Open addressing table of the distinct genotypes among the candidates,
+     * each slot holding the copy kept: its fidelity, complemented so that
+     * the lowest value is the one to keep, above its index.
+     */
+    _Atomic uint64_t *slots;
+    unsigned long capacity;
+    /* Slot of the genotype of every candidate.
+     */
+    unsigned long *homes;
+};
+
+SurvivorScratch *survivor_scratch_alloc(const unsigned n_individuals) {
+    SurvivorScratch *const scratch = (SurvivorScratch *) malloc(sizeof(SurvivorScratch));
+
+    scratch->n_individuals = n_individuals;
+    scratch->candidates = (Candidate *) malloc(sizeof(Candidate) * 2 * n_individuals);
+    scratch->indices = (unsigned *) malloc(sizeof(unsigned) * 2 * n_individuals);
+    scratch->capacity = 1;
+    while(scratch->capacity < 4UL * n_individuals) {
+        scratch->capacity <<= 1;
+    }
+    scratch->slots = (_Atomic uint64_t *) malloc(sizeof(_Atomic uint64_t) * scratch->capacity);
+    scratch->homes = (unsigned long *) malloc(sizeof(unsigned long) * 2 * n_individuals);
+
+    return scratch;
+}
+
+void survivor_scratch_free(SurvivorScratch *const scratch) {
+    if(scratch != NULL) {
+        free(scratch->candidates);
+        free(scratch->indices);
+        free((void *) scratch->slots);
+        free(scratch->homes);
+        free(scratch);
+    }
+}
+
+/* Pass of the survivor selection over the candidates of `scratch`, or over
+ * the slots of its table, in chunks.
+ */
+typedef struct {
+    SurvivorScratch *scratch;
+    const Individual *parents;
+    Individual *children;
+    /* Parents of the children, replaced by those of the survivors, or
+     * `NULL`.
+     */
+    Lineage *lineage;
+} SurvivorPass;
+
+/* Run `task` over the chunks of `n` items, on `scheduler` unless there is a
+ * single one.
+ */
+static void run_chunks(const Scheduler *const scheduler, const unsigned long n, const Task task, void *const data) {
+    const unsigned n_chunks = (unsigned) ((n + SURVIVOR_CHUNK - 1) / SURVIVOR_CHUNK);
+
+    if(n_chunks > 1) {
+        scheduler_run(scheduler, n_chunks, task, data);
+    } else if(n_chunks == 1) {
+        task(0, data);
+    }
+}
+
+static inline uint64_t genotype_hash(const Genotype *const g) {
+    uint64_t hash = g->word[0] ^ (g->word[1] * 0x9E3779B97F4A7C15UL);
+    hash = (hash ^ (hash >> 31)) * 0xBF58476D1CE4E5B9UL;
+
+    return hash ^ (hash >> 29);
+}
+
+static inline int same_genotype(const Genotype *const a, const Genotype *const b) {
+    return a->word[0] == b->word[0] && a->word[1] == b->word[1];
+}
+
+static void clear_task(const unsigned chunk, void *const data) {
+    SurvivorScratch *const scratch = ((SurvivorPass *) data)->scratch;
+    const unsigned long first = (unsigned long) chunk * SURVIVOR_CHUNK;
+    const unsigned long last = first + SURVIVOR_CHUNK < scratch->capacity ? first + SURVIVOR_CHUNK : scratch->capacity;
+
+    for(unsigned long iter = first; iter < last; iter++) {
+        atomic_store_explicit(scratch->slots + iter, SLOT_EMPTY, memory_order_relaxed);
+    }
+}
+
+/* Copy the parents and children of a chunk to the candidates, and record
+ * their genotypes in the table, keeping the copy of highest fidelity and
+ * lowest index of each one.
+ */
+static void insert_task(const unsigned chunk, void *const data) {
+    const SurvivorPass *const pass = (SurvivorPass *) data;
+    SurvivorScratch *const scratch = pass->scratch;
+    const unsigned n = scratch->n_individuals;
+    const unsigned first = chunk * SURVIVOR_CHUNK;
+    const unsigned last = first + SURVIVOR_CHUNK < 2 * n ? first + SURVIVOR_CHUNK : 2 * n;
+    const unsigned long mask = scratch->capacity - 1;
+
+    for(unsigned iter = first; iter < last; iter++) {
+        if(iter + PREFETCH_DISTANCE < last) {
+            const unsigned ahead = iter + PREFETCH_DISTANCE;
+            const Individual *const next = ahead < n ? pass->parents + ahead : pass->children + (ahead - n);
+            __builtin_prefetch((const void *) (scratch->slots + (genotype_hash(&(next->genotype)) & mask)), 1);
+        }
+
+        const Individual *const individual = iter < n ? pass->parents + iter : pass->children + (iter - n);
+        Candidate *const candidate = scratch->candidates + iter;
+        *candidate = (Candidate) {
+            .genotype = individual->genotype,
+            .fitness = individual->fitness,
+            .fidelity = individual->fidelity,
+            .grade = individual->fidelity + 1,
+        };
+        if(pass->lineage != NULL) {
+            candidate->lineage = iter < n ? (Lineage) { .parent = { iter, LINEAGE_NONE } } : pass->lineage[iter - n];
+        }
+
+        const uint64_t mine = ((uint64_t) (UCHAR_MAX - individual->fidelity) << 32) | iter;
+        unsigned long slot = genotype_hash(&(individual->genotype)) & mask;
+        for(;; slot = (slot + 1) & mask) {
+            uint64_t current = atomic_load_explicit(scratch->slots + slot, memory_order_acquire);
+
+            if(current == SLOT_EMPTY) {
+                if(atomic_compare_exchange_strong_explicit(scratch->slots + slot, &current, mine, memory_order_acq_rel, memory_order_acquire)) {
+                    break;
+                }
+            }
+
+            /* Every candidate of the slot has the same genotype */
+            const unsigned other = (unsigned) (current & UINT32_MAX);
+            const Individual *const kept = other < n ? pass->parents + other : pass->children + (other - n);
+            if(same_genotype(&(kept->genotype), &(individual->genotype))) {
+                while(mine < current && !atomic_compare_exchange_weak_explicit(scratch->slots + slot, &current, mine, memory_order_acq_rel, memory_order_acquire));
+                break;
+            }
+        }
+        scratch->homes[iter] = slot;
+    }
+}
+
+/* Grade the copies of a genotype but the one kept below every other
+ * candidate.
+ */
+static void mark_task(const unsigned chunk, void *const data) {
+    SurvivorScratch *const scratch = ((SurvivorPass *) data)->scratch;
+    const unsigned n = 2 * scratch->n_individuals;
+    const unsigned first = chunk * SURVIVOR_CHUNK;
+    const unsigned last = first + SURVIVOR_CHUNK < n ? first + SURVIVOR_CHUNK : n;
+
+    for(unsigned iter = first; iter < last; iter++) {
+        if(iter + PREFETCH_DISTANCE < last) {
+            __builtin_prefetch((const void *) (scratch->slots + scratch->homes[iter + PREFETCH_DISTANCE]), 0);
+        }
+
+        const uint64_t kept = atomic_load_explicit(scratch->slots + scratch->homes[iter], memory_order_relaxed);
+
+        if((kept & UINT32_MAX) != iter) {
+            scratch->candidates[iter].grade = 0;
+        }
+    }
+}
+
+/* Move the survivors of a chunk to the children.
+ */
+static void gather_task(const unsigned chunk, void *const data) {
+    const SurvivorPass *const pass = (SurvivorPass *) data;
+    const SurvivorScratch *const scratch = pass->scratch;
+    const unsigned first = chunk * SURVIVOR_CHUNK;
+    const unsigned last = first + SURVIVOR_CHUNK < scratch->n_individuals ? first + SURVIVOR_CHUNK : scratch->n_individuals;
+
+    for(unsigned iter = first; iter < last; iter++) {
+        const Candidate *const candidate = scratch->candidates + scratch->indices[iter];
+
+        pass->children[iter] = (Individual) {
+            .genotype = candidate->genotype,
+            .fitness = candidate->fitness,
+            .fidelity = candidate->fidelity,
+        };
+        if(pass->lineage != NULL) {
+            pass->lineage[iter] = candidate->lineage;
+        }
+    }
+}
+
+void select_survivors(GeneticAlgorithm *const ga, const Scheduler *const scheduler) {
+    SurvivorScratch *const scratch = ga->survivors;
+    const unsigned n = ga->n_individuals;
+    SurvivorPass pass = { .scratch = scratch, .parents = ga->individuals, .children = ga->new_individuals, .lineage = ga->new_lineage };
+
+    run_chunks(scheduler, scratch->capacity, clear_task, &pass);
+    run_chunks(scheduler, 2UL * n, insert_task, &pass);
+    run_chunks(scheduler, 2UL * n, mark_task, &pass);
+
+    const Candidate *const candidates = scratch->candidates;
+    if(ga->config.survivors == SURVIVORS_ELITISM) {
+        const unsigned n_elite = ga->config.n_elite < n ? ga->config.n_elite : n - 1;
+
+        select_best(&(candidates[0].fitness), &(candidates[0].grade), sizeof(Candidate), n, n_elite, scratch->indices, scheduler, &(ga->rng));
+        select_best(&(candidates[n].fitness), &(candidates[n].grade), sizeof(Candidate), n, n - n_elite, scratch->indices + n, scheduler, &(ga->rng));
+        for(unsigned iter = n_elite; iter < n; iter++) {
+            scratch->indices[iter] = n + scratch->indices[n + iter - n_elite];
+        }
+    } else {
+        select_best(&(candidates[0].fitness), &(candidates[0].grade), sizeof(Candidate), 2 * n, n, scratch->indices, scheduler, &(ga->rng));
+    }
+
+    run_chunks(scheduler, n, gather_task, &pass);
+}
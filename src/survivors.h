@@ -0,0 +1,23 @@
+#pragma once
+#include "genetic-algorithm.h"
+#include "scheduler.h"
+
+/* Allocate the scratch space to choose the survivors of a population of
+ * `n_individuals` among parents and children.
+ */
+SurvivorScratch *survivor_scratch_alloc(const unsigned n_individuals);
+
+void survivor_scratch_free(SurvivorScratch *const scratch);
+
+/* Store in `ga->new_individuals` the survivors among the parents in
+ * `ga->individuals` and the evaluated children in `ga->new_individuals`, as
+ * `ga->config.survivors` says, either `SURVIVORS_PLUS` or
+ * `SURVIVORS_ELITISM`.
+ *
+ * Copies of a genotype rank below every distinct individual, so that they
+ * only survive when there are not enough of them. The copy kept is the one
+ * of highest fidelity, and the parent among copies of the same fidelity.
+ * Large populations are processed in chunks on `scheduler`, in time linear
+ * in their size.
+ */
+void select_survivors(GeneticAlgorithm *const ga, const Scheduler *const scheduler);
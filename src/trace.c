@@ -0,0 +1,629 @@
+#define _DEFAULT_SOURCE
+#include "trace.h"
+#include "genotype.h"
+#include <fcntl.h>
+#include <float.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TRACE_MAGIC "GATRACE1"
+#define TRACE_VERSION (1)
+#define TRACE_CHUNK_MAGIC (0x4E454754U)
+
+/* Longest literal and repeated runs of the run-length encoding.
+ */
+#define RLE_LITERAL (128U)
+#define RLE_REPEAT (130U)
+
+/* Columns of a chunk.
+ */
+typedef enum {
+    COLUMN_GENOTYPE,
+    COLUMN_FITNESS,
+    COLUMN_FIDELITY,
+    COLUMN_LINEAGE,
+    COLUMNS,
+} Column;
+
+/* Bytes of the values of each column, transposed together when compressing.
+ */
+static const size_t column_width[COLUMNS] = { sizeof(uint64_t), sizeof(double), sizeof(unsigned char), sizeof(uint32_t) };
+
+/* First bytes of the file, identifying it and its populations.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t n_individuals;
+    uint32_t encoding;
+    uint32_t genotype_words;
+    /* `genotype_schema_hash` of the schema decoding the genotypes.
+     */
+    uint64_t schema;
+    uint64_t reserved;
+} TraceHeader;
+
+/* Header of the chunk of a generation, followed by its columns, each one
+ * compressed if its stored size is below its raw size, and padded to a
+ * multiple of 8 bytes.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t generation;
+    uint64_t raw_size[COLUMNS];
+    uint64_t stored_size[COLUMNS];
+} ChunkHeader;
+
+/* Generation copied from the run, laid out as its columns.
+ */
+typedef struct {
+    unsigned generation;
+    unsigned char *columns[COLUMNS];
+} Snapshot;
+
+struct Trace {
+    FILE *file;
+    const char *path;
+    unsigned n_individuals;
+    int compress;
+    /* Snapshot filled by `trace_record`, the other one being written or
+     * free.
+     */
+    Snapshot snapshots[2];
+    unsigned filling;
+    /* Whether the other snapshot is waiting to be written or being written.
+     */
+    int pending;
+    int closing;
+    int failed;
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    /* Scratch space of the writer to compress a column.
+     */
+    unsigned char *shuffled;
+    unsigned char *packed;
+    unsigned long generations;
+    unsigned long raw_bytes;
+    unsigned long stored_bytes;
+};
+
+struct TraceReader {
+    const unsigned char *map;
+    size_t size;
+    TraceHeader header;
+    /* Offsets of the chunks in the file.
+     */
+    size_t *chunks;
+    unsigned length;
+    /* Columns of the last compressed chunk read.
+     */
+    unsigned char *columns[COLUMNS];
+    unsigned char *shuffled;
+};
+
+static size_t padded(const size_t size) {
+    return (size + 7) & ~(size_t) 7;
+}
+
+static size_t raw_column_size(const Column column, const unsigned n_individuals) {
+    switch(column) {
+        case COLUMN_GENOTYPE:
+            return sizeof(Genotype) * n_individuals;
+        case COLUMN_FITNESS:
+            return sizeof(double) * n_individuals;
+        case COLUMN_FIDELITY:
+            return sizeof(unsigned char) * n_individuals;
+        default:
+            return sizeof(Lineage) * n_individuals;
+    }
+}
+
+/* Store the `b`-th byte of every value of `width` bytes of `input` one after
+ * the other, for every `b`, so that the bytes of similar significance, most
+ * of them equal, form long runs.
+ */
+static void shuffle_bytes(const unsigned char *const input, const size_t size, const size_t width, unsigned char *const output) {
+    const size_t n = size / width;
+
+    for(size_t byte = 0; byte < width; byte++) {
+        for(size_t iter = 0; iter < n; iter++) {
+            output[(byte * n) + iter] = input[(iter * width) + byte];
+        }
+    }
+}
+
+static void unshuffle_bytes(const unsigned char *const input, const size_t size, const size_t width, unsigned char *const output) {
+    const size_t n = size / width;
+
+    for(size_t byte = 0; byte < width; byte++) {
+        for(size_t iter = 0; iter < n; iter++) {
+            output[(iter * width) + byte] = input[(byte * n) + iter];
+        }
+    }
+}
+
+/* Run-length encode `size` bytes of `input` into `output`, with room for
+ * `size + size / RLE_LITERAL + 1` bytes, returning the encoded size.
+ *
+ * A control byte below `RLE_LITERAL` is followed by that many plus one
+ * literal bytes, and any other by a byte repeated that many minus
+ * `RLE_LITERAL - 3` times.
+ */
+static size_t rle_encode(const unsigned char *const input, const size_t size, unsigned char *const output) {
+    size_t length = 0;
+    size_t iter = 0;
+
+    while(iter < size) {
+        size_t run = 1;
+        while(iter + run < size && run < RLE_REPEAT && input[iter + run] == input[iter]) {
+            run++;
+        }
+        if(run >= 3) {
+            output[length++] = (unsigned char) (run + RLE_LITERAL - 3);
+            output[length++] = input[iter];
+            iter += run;
+            continue;
+        }
+
+        const size_t first = iter;
+        while(iter < size && iter - first < RLE_LITERAL
+                && !(iter + 2 < size && input[iter] == input[iter + 1] && input[iter] == input[iter + 2])) {
+            iter++;
+        }
+        output[length++] = (unsigned char) (iter - first - 1);
+        memcpy(output + length, input + first, iter - first);
+        length += iter - first;
+    }
+
+    return length;
+}
+
+/* Decode `size` bytes of `input` into exactly `expected` bytes of `output`,
+ * returning `0` on success.
+ */
+static int rle_decode(const unsigned char *const input, const size_t size, unsigned char *const output, const size_t expected) {
+    size_t length = 0;
+    size_t iter = 0;
+
+    while(iter < size) {
+        const unsigned control = input[iter++];
+        if(control < RLE_LITERAL) {
+            if(iter + control + 1 > size || length + control + 1 > expected) {
+                return -1;
+            }
+            memcpy(output + length, input + iter, control + 1);
+            iter += control + 1;
+            length += control + 1;
+        } else {
+            const size_t run = control - (RLE_LITERAL - 3);
+            if(iter >= size || length + run > expected) {
+                return -1;
+            }
+            memset(output + length, input[iter++], run);
+            length += run;
+        }
+    }
+
+    return length == expected ? 0 : -1;
+}
+
+/* Append the chunk of `snapshot` to the file, returning `0` on success.
+ */
+static int write_chunk(Trace *const trace, const Snapshot *const snapshot) {
+    static const unsigned char zeros[8] = { 0 };
+    ChunkHeader header = { .magic = TRACE_CHUNK_MAGIC, .generation = snapshot->generation };
+    const unsigned char *stored[COLUMNS];
+
+    unsigned char *packed = trace->packed;
+    for(unsigned column = 0; column < COLUMNS; column++) {
+        const size_t size = raw_column_size((Column) column, trace->n_individuals);
+        header.raw_size[column] = size;
+        header.stored_size[column] = size;
+        stored[column] = snapshot->columns[column];
+
+        if(trace->compress) {
+            shuffle_bytes(snapshot->columns[column], size, column_width[column], trace->shuffled);
+            const size_t length = rle_encode(trace->shuffled, size, packed);
+            if(length < size) {
+                header.stored_size[column] = length;
+                stored[column] = packed;
+                packed += padded(length);
+            }
+        }
+    }
+
+    if(fwrite(&header, sizeof(header), 1, trace->file) != 1) {
+        return -1;
+    }
+    size_t total = sizeof(header);
+    for(unsigned column = 0; column < COLUMNS; column++) {
+        const size_t size = header.stored_size[column];
+        if(fwrite(stored[column], 1, size, trace->file) != size
+                || fwrite(zeros, 1, padded(size) - size, trace->file) != padded(size) - size) {
+            return -1;
+        }
+        trace->raw_bytes += header.raw_size[column];
+        total += padded(size);
+    }
+    trace->stored_bytes += total;
+    trace->generations++;
+
+    return 0;
+}
+
+/* Write every snapshot handed over by `trace_record` until closed.
+ */
+static void *writer_thread(void *const data) {
+    Trace *const trace = (Trace *) data;
+
+    pthread_mutex_lock(&(trace->lock));
+    for(;;) {
+        while(!trace->pending && !trace->closing) {
+            pthread_cond_wait(&(trace->changed), &(trace->lock));
+        }
+        if(!trace->pending) {
+            break;
+        }
+
+        const Snapshot *const snapshot = trace->snapshots + !trace->filling;
+        pthread_mutex_unlock(&(trace->lock));
+
+        const int failed = !trace->failed && write_chunk(trace, snapshot) != 0;
+        if(failed) {
+            perror(trace->path);
+        }
+
+        pthread_mutex_lock(&(trace->lock));
+        trace->failed |= failed;
+        trace->pending = 0;
+        pthread_cond_broadcast(&(trace->changed));
+    }
+    pthread_mutex_unlock(&(trace->lock));
+
+    return NULL;
+}
+
+Trace *trace_open(const char *const path, const unsigned n_individuals, const Encoding encoding, const int compress) {
+    FILE *const file = fopen(path, "wb");
+    if(file == NULL) {
+        perror(path);
+        return NULL;
+    }
+
+    TraceHeader header = {
+        .version = TRACE_VERSION,
+        .n_individuals = n_individuals,
+        .encoding = encoding,
+        .genotype_words = GENOTYPE_WORDS,
+        .schema = genotype_schema_hash(),
+        .reserved = 0,
+    };
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    if(fwrite(&header, sizeof(header), 1, file) != 1) {
+        perror(path);
+        fclose(file);
+        return NULL;
+    }
+
+    Trace *const trace = (Trace *) malloc(sizeof(Trace));
+    *trace = (Trace) {
+        .file = file,
+        .path = path,
+        .n_individuals = n_individuals,
+        .compress = compress,
+        .filling = 0,
+        .pending = 0,
+        .closing = 0,
+        .failed = 0,
+        .shuffled = NULL,
+        .packed = NULL,
+        .generations = 0,
+        .raw_bytes = 0,
+        .stored_bytes = 0,
+    };
+
+    size_t total = 0;
+    for(unsigned column = 0; column < COLUMNS; column++) {
+        const size_t size = raw_column_size((Column) column, n_individuals);
+        trace->snapshots[0].columns[column] = (unsigned char *) malloc(size);
+        trace->snapshots[1].columns[column] = (unsigned char *) malloc(size);
+        total += padded(size + (size / RLE_LITERAL) + 1);
+    }
+    if(compress) {
+        trace->shuffled = (unsigned char *) malloc(raw_column_size(COLUMN_GENOTYPE, n_individuals));
+        trace->packed = (unsigned char *) malloc(total);
+    }
+
+    pthread_mutex_init(&(trace->lock), NULL);
+    pthread_cond_init(&(trace->changed), NULL);
+    pthread_create(&(trace->writer), NULL, writer_thread, trace);
+
+    return trace;
+}
+
+void trace_record(Trace *const trace, const unsigned generation, const Genotype *const genotypes, const double *const fitness, const unsigned char *const fidelity, const size_t stride, const Lineage *const lineage) {
+    Snapshot *const snapshot = trace->snapshots + trace->filling;
+    Genotype *const g = (Genotype *) snapshot->columns[COLUMN_GENOTYPE];
+    double *const f = (double *) snapshot->columns[COLUMN_FITNESS];
+    unsigned char *const level = snapshot->columns[COLUMN_FIDELITY];
+    Lineage *const parents = (Lineage *) snapshot->columns[COLUMN_LINEAGE];
+
+    snapshot->generation = generation;
+    for(unsigned iter = 0; iter < trace->n_individuals; iter++) {
+        g[iter] = *(const Genotype *) ((const char *) genotypes + iter * stride);
+        f[iter] = *(const double *) ((const char *) fitness + iter * stride);
+        level[iter] = *(fidelity + iter * stride);
+    }
+    if(lineage != NULL) {
+        memcpy(parents, lineage, sizeof(Lineage) * trace->n_individuals);
+    } else {
+        memset(parents, 0xFF, sizeof(Lineage) * trace->n_individuals);
+    }
+
+    /* Hand the snapshot over once the other one is written */
+    pthread_mutex_lock(&(trace->lock));
+    while(trace->pending) {
+        pthread_cond_wait(&(trace->changed), &(trace->lock));
+    }
+    trace->pending = 1;
+    trace->filling = !trace->filling;
+    pthread_cond_broadcast(&(trace->changed));
+    pthread_mutex_unlock(&(trace->lock));
+}
+
+int trace_close(Trace *const trace, FILE *const output) {
+    pthread_mutex_lock(&(trace->lock));
+    trace->closing = 1;
+    pthread_cond_broadcast(&(trace->changed));
+    pthread_mutex_unlock(&(trace->lock));
+    pthread_join(trace->writer, NULL);
+
+    int failed = trace->failed;
+    if(fclose(trace->file) != 0 && !failed) {
+        perror(trace->path);
+        failed = 1;
+    }
+    if(output != NULL) {
+        fprintf(output, "Trace: %lu generations of %u individuals, %.1f MB written of %.1f MB\n", trace->generations,
+                trace->n_individuals, trace->stored_bytes / 1e6, trace->raw_bytes / 1e6);
+    }
+
+    pthread_mutex_destroy(&(trace->lock));
+    pthread_cond_destroy(&(trace->changed));
+    for(unsigned column = 0; column < COLUMNS; column++) {
+        free(trace->snapshots[0].columns[column]);
+        free(trace->snapshots[1].columns[column]);
+    }
+    free(trace->shuffled);
+    free(trace->packed);
+    free(trace);
+
+    return failed ? -1 : 0;
+}
+
+/* Size of the chunk at `offset`, or `0` if it is not complete.
+ */
+static size_t chunk_size(const TraceReader *const reader, const size_t offset) {
+    if(reader->size - offset < sizeof(ChunkHeader)) {
+        return 0;
+    }
+
+    ChunkHeader header;
+    memcpy(&header, reader->map + offset, sizeof(header));
+    if(header.magic != TRACE_CHUNK_MAGIC) {
+        return 0;
+    }
+
+    size_t size = sizeof(ChunkHeader);
+    for(unsigned column = 0; column < COLUMNS; column++) {
+        if(header.raw_size[column] != raw_column_size((Column) column, reader->header.n_individuals)
+                || header.stored_size[column] > header.raw_size[column]) {
+            return 0;
+        }
+        size += padded(header.stored_size[column]);
+    }
+
+    return size <= reader->size - offset ? size : 0;
+}
+
+TraceReader *trace_reader_open(const char *const path) {
+    const int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        perror(path);
+        return NULL;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+        perror(path);
+        close(fd);
+        return NULL;
+    }
+    if((size_t) st.st_size < sizeof(TraceHeader)) {
+        fprintf(stderr, "%s: not a trace\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    void *const map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) {
+        perror(path);
+        return NULL;
+    }
+
+    TraceReader *const reader = (TraceReader *) malloc(sizeof(TraceReader));
+    *reader = (TraceReader) {
+        .map = (const unsigned char *) map,
+        .size = st.st_size,
+        .chunks = NULL,
+        .length = 0,
+        .columns = { NULL },
+        .shuffled = NULL,
+    };
+    memcpy(&(reader->header), map, sizeof(TraceHeader));
+    if(memcmp(reader->header.magic, TRACE_MAGIC, sizeof(reader->header.magic)) != 0 || reader->header.version != TRACE_VERSION
+            || reader->header.genotype_words != GENOTYPE_WORDS || reader->header.encoding > ENCODING_GRAY) {
+        fprintf(stderr, "%s: not a trace of this version\n", path);
+        trace_reader_close(reader);
+        return NULL;
+    }
+
+    /* Index the chunks, stopping at the first incomplete one */
+    size_t capacity = 64;
+    reader->chunks = (size_t *) malloc(sizeof(size_t) * capacity);
+    for(size_t offset = sizeof(TraceHeader), size; (size = chunk_size(reader, offset)) > 0; offset += size) {
+        if(reader->length == capacity) {
+            capacity *= 2;
+            reader->chunks = (size_t *) realloc(reader->chunks, sizeof(size_t) * capacity);
+        }
+        reader->chunks[reader->length++] = offset;
+    }
+
+    return reader;
+}
+
+void trace_reader_close(TraceReader *const reader) {
+    munmap((void *) reader->map, reader->size);
+    for(unsigned column = 0; column < COLUMNS; column++) {
+        free(reader->columns[column]);
+    }
+    free(reader->shuffled);
+    free(reader->chunks);
+    free(reader);
+}
+
+unsigned trace_reader_length(const TraceReader *const reader) {
+    return reader->length;
+}
+
+Encoding trace_reader_encoding(const TraceReader *const reader) {
+    return (Encoding) reader->header.encoding;
+}
+
+int trace_reader_get(TraceReader *const reader, const unsigned index, TraceGeneration *const generation) {
+    if(index >= reader->length) {
+        return -1;
+    }
+
+    ChunkHeader header;
+    memcpy(&header, reader->map + reader->chunks[index], sizeof(header));
+
+    const unsigned char *columns[COLUMNS];
+    const unsigned char *data = reader->map + reader->chunks[index] + sizeof(ChunkHeader);
+    for(unsigned column = 0; column < COLUMNS; column++) {
+        const size_t size = header.raw_size[column];
+        columns[column] = data;
+
+        if(header.stored_size[column] < size) {
+            if(reader->columns[column] == NULL) {
+                reader->columns[column] = (unsigned char *) malloc(size);
+            }
+            if(reader->shuffled == NULL) {
+                reader->shuffled = (unsigned char *) malloc(raw_column_size(COLUMN_GENOTYPE, reader->header.n_individuals));
+            }
+            if(rle_decode(data, header.stored_size[column], reader->shuffled, size) != 0) {
+                return -1;
+            }
+            unshuffle_bytes(reader->shuffled, size, column_width[column], reader->columns[column]);
+            columns[column] = reader->columns[column];
+        }
+        data += padded(header.stored_size[column]);
+    }
+
+    *generation = (TraceGeneration) {
+        .generation = header.generation,
+        .n_individuals = reader->header.n_individuals,
+        .genotypes = (const Genotype *) columns[COLUMN_GENOTYPE],
+        .fitness = (const double *) columns[COLUMN_FITNESS],
+        .fidelity = columns[COLUMN_FIDELITY],
+        .lineage = (const Lineage *) columns[COLUMN_LINEAGE],
+    };
+    return 0;
+}
+
+static void print_parent(const uint32_t parent, FILE *const output) {
+    if(parent == LINEAGE_NONE) {
+        fprintf(output, "\t-");
+    } else {
+        fprintf(output, "\t%u", parent);
+    }
+}
+
+/* Print individual `iter` of `generation`.
+ */
+static void print_individual(const TraceGeneration *const generation, const unsigned iter, const Encoding encoding, FILE *const output) {
+    const Phenotype p = genoype_to_phenotype(generation->genotypes[iter], encoding);
+
+    fprintf(output, "%u\t%u\t%lf\t%u", generation->generation, iter, generation->fitness[iter], generation->fidelity[iter]);
+    print_parent(generation->lineage[iter].parent[0], output);
+    print_parent(generation->lineage[iter].parent[1], output);
+    fprintf(output, "\t%lf\t%lf\t%lf\t%lf\t%lf\n", p.phi, p.lambda, p.mu, p.sigma, p.delta);
+}
+
+int print_trace(const char *const path, const long generation, const long individual, FILE *const output) {
+    TraceReader *const reader = trace_reader_open(path);
+    if(reader == NULL) {
+        return 1;
+    }
+
+    if(reader->header.schema != genotype_schema_hash()) {
+        fprintf(stderr, "%s: written with another --schema, the parameters are decoded with the current one\n", path);
+    }
+
+    const Encoding encoding = trace_reader_encoding(reader);
+    const unsigned n_individuals = reader->header.n_individuals;
+    if(individual >= (long) n_individuals) {
+        fprintf(stderr, "%s: %u individuals per generation\n", path, n_individuals);
+        trace_reader_close(reader);
+        return 1;
+    }
+
+    if(generation >= 0 || individual >= 0) {
+        fprintf(output, "generation\tindividual\tfitness\tfidelity\tfirst_parent\tsecond_parent\tphi\tlambda\tmu\tsigma\tdelta\n");
+    } else {
+        fprintf(output, "generation\tbest\tmean\tvalid\tconfirmed\n");
+    }
+
+    int err = 0;
+    for(unsigned index = 0; index < trace_reader_length(reader) && !err; index++) {
+        TraceGeneration g;
+        if(trace_reader_get(reader, index, &g) != 0) {
+            fprintf(stderr, "%s: corrupt chunk %u\n", path, index);
+            err = 1;
+        } else if(generation >= 0 && g.generation != (unsigned long) generation) {
+            continue;
+        } else if(individual >= 0) {
+            print_individual(&g, (unsigned) individual, encoding, output);
+        } else if(generation >= 0) {
+            for(unsigned iter = 0; iter < g.n_individuals; iter++) {
+                print_individual(&g, iter, encoding, output);
+            }
+        } else {
+            double best = DBL_MAX;
+            double sum = 0.0;
+            unsigned n_valid = 0;
+            unsigned n_confirmed = 0;
+            for(unsigned iter = 0; iter < g.n_individuals; iter++) {
+                if(g.fitness[iter] != DBL_MAX) {
+                    sum += g.fitness[iter];
+                    n_valid++;
+                }
+                if(g.fidelity[iter] == FIDELITY_HIGH) {
+                    best = g.fitness[iter] < best ? g.fitness[iter] : best;
+                    n_confirmed++;
+                }
+            }
+            fprintf(output, "%u\t%lf\t%lf\t%u\t%u\n", g.generation, best, n_valid > 0 ? sum / n_valid : NAN, n_valid, n_confirmed);
+        }
+    }
+
+    trace_reader_close(reader);
+    return err;
+}
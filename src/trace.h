@@ -0,0 +1,87 @@
+#pragma once
+#include "genotype.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Parent index of an individual without a parent in the previous generation.
+ */
+#define LINEAGE_NONE (UINT32_MAX)
+
+/* Indices in the previous generation of the parents of an individual, or the
+ * index of the parent itself and `LINEAGE_NONE` if it survived, both
+ * `LINEAGE_NONE` for random individuals and copies of the best one.
+ */
+typedef struct {
+    uint32_t parent[2];
+} Lineage;
+
+/* History of the populations of a run, for offline analysis.
+ *
+ * The file is a header followed by one chunk per generation, holding the
+ * columns of the genotypes, fitness values, fidelities and lineages of its
+ * individuals, each one stored as it is or, when compressed, with its bytes
+ * transposed by significance and run-length encoded. Every column starts at a
+ * multiple of 8 bytes, so that uncompressed chunks are read in place from a
+ * memory mapping of the file.
+ *
+ * Generations are copied to one of two snapshots and written to the file by
+ * a thread of the trace while the run goes on, waiting for it only when the
+ * other snapshot is still being written.
+ */
+typedef struct Trace Trace;
+
+/* Create the trace of populations of `n_individuals` genotypes decoded with
+ * `encoding` at `path`, returning `NULL` after printing the reason if it
+ * cannot be written.
+ */
+Trace *trace_open(const char *const path, const unsigned n_individuals, const Encoding encoding, const int compress);
+
+/* Append generation `generation` to the trace: the genotypes, fitness values
+ * and fidelities of its individuals, `stride` bytes apart, and their
+ * lineages, unknown if `NULL`.
+ */
+void trace_record(Trace *const trace, const unsigned generation, const Genotype *const genotypes, const double *const fitness, const unsigned char *const fidelity, const size_t stride, const Lineage *const lineage);
+
+/* Write the pending generation and release the trace, printing the
+ * generations written and their size to `output`, returning `0` if every
+ * generation was written.
+ */
+int trace_close(Trace *const trace, FILE *const output);
+
+/* Generation read from a trace, valid until the next read.
+ */
+typedef struct {
+    unsigned generation;
+    unsigned n_individuals;
+    const Genotype *genotypes;
+    const double *fitness;
+    const unsigned char *fidelity;
+    const Lineage *lineage;
+} TraceGeneration;
+
+/* Trace opened for reading, memory mapped.
+ */
+typedef struct TraceReader TraceReader;
+
+/* Map the trace at `path` and index its chunks, ignoring a last one torn by
+ * a crash, returning `NULL` after printing the reason if it cannot be read.
+ */
+TraceReader *trace_reader_open(const char *const path);
+
+void trace_reader_close(TraceReader *const reader);
+
+unsigned trace_reader_length(const TraceReader *const reader);
+
+Encoding trace_reader_encoding(const TraceReader *const reader);
+
+/* Read the chunk `index` of the trace, pointing into the mapping when stored
+ * uncompressed and decoding it otherwise, returning `0` on success.
+ */
+int trace_reader_get(TraceReader *const reader, const unsigned index, TraceGeneration *const generation);
+
+/* Print the trace at `path` to `output`: a summary of every generation, or
+ * every individual of generation `generation`, or individual `individual`
+ * along every generation, unless negative.
+ */
+int print_trace(const char *const path, const long generation, const long individual, FILE *const output);
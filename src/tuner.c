@@ -0,0 +1,263 @@
+#include "tuner.h"
+#include "genetic-algorithm.h"
+#include "genotype.h"
+#include "multiplexer.h"
+#include "randombits.h"
+#include "scheduler.h"
+#include "selection.h"
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static const unsigned population_sizes[] = { 50, 100, 200, 500, 1000, 2000 };
+static const unsigned tournament_sizes[] = { 2, 3, 4, 6, 8, 10, 16 };
+
+static const char *const encoding_names[] = {
+    [ENCODING_BINARY] = "binary",
+    [ENCODING_GRAY] = "gray",
+};
+
+static const char *const crossover_names[] = {
+    [CROSSOVER_ONE_POINT] = "one-point",
+    [CROSSOVER_TWO_POINT] = "two-point",
+    [CROSSOVER_UNIFORM] = "uniform",
+};
+
+static const char *const survivor_names[] = {
+    [SURVIVORS_GENERATIONAL] = "generational",
+    [SURVIVORS_PLUS] = "plus",
+    [SURVIVORS_ELITISM] = "elitism",
+};
+
+/* Integrations of a run that has not reached the target.
+ */
+#define TARGET_MISSED ULONG_MAX
+
+/* Configuration raced, and the state of its runs.
+ */
+typedef struct {
+    unsigned id;
+    GeneticAlgorithmConfig config;
+    GeneticAlgorithm *gas;
+    /* Integrations each run took to reach the target, `TARGET_MISSED` while
+     * it has not.
+     */
+    unsigned long *evaluations;
+    /* Mean time to target and median best fitness of the runs.
+     */
+    double score;
+    double fitness;
+} Contender;
+
+static int compare_doubles(const void *a, const void *b) {
+    const double x = *(const double *) a;
+    const double y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+static int compare_contenders(const void *a, const void *b) {
+    const Contender *const x = *(const Contender *const *) a;
+    const Contender *const y = *(const Contender *const *) b;
+
+    if(x->score != y->score) {
+        return (x->score > y->score) - (x->score < y->score);
+    }
+    return (x->fitness > y->fitness) - (x->fitness < y->fitness);
+}
+
+/* Random configuration around `base`, drawn from `rng`.
+ */
+static GeneticAlgorithmConfig sample_configuration(const GeneticAlgorithmConfig *const base, Random *const rng) {
+    GeneticAlgorithmConfig config = *base;
+
+    config.n_individuals = population_sizes[select_random_index(sizeof(population_sizes) / sizeof(unsigned), rng)];
+    config.tournament_size = tournament_sizes[select_random_index(sizeof(tournament_sizes) / sizeof(unsigned), rng)];
+    config.crossover = (Crossover) select_random_index(sizeof(crossover_names) / sizeof(char *), rng);
+    config.mutation = 0.05 + 0.9 * uniform(rng);
+    config.encoding = (Encoding) select_random_index(sizeof(encoding_names) / sizeof(char *), rng);
+    config.survivors = (Survivors) select_random_index(sizeof(survivor_names) / sizeof(char *), rng);
+    if(config.n_elite >= config.n_individuals) {
+        config.n_elite = config.n_individuals / 2;
+    }
+
+    return config;
+}
+
+/* Record the evaluations of the runs of `contenders` that reached the target
+ * since the last check.
+ */
+static void check_targets(Contender *const *const contenders, const unsigned n_contenders, const unsigned n_seeds, const double target) {
+    for(unsigned iter = 0; iter < n_contenders; iter++) {
+        for(unsigned run = 0; run < n_seeds; run++) {
+            const GeneticAlgorithm *const ga = contenders[iter]->gas + run;
+            if(contenders[iter]->evaluations[run] == TARGET_MISSED && ga->best.fitness <= target) {
+                contenders[iter]->evaluations[run] = genetic_algorithm_evaluations(ga);
+            }
+        }
+    }
+}
+
+/* Score the runs of `contender`, counting `penalty` evaluations for those
+ * that did not reach the target.
+ */
+static void score_contender(Contender *const contender, const unsigned n_seeds, const double penalty, double *const values) {
+    contender->score = 0.0;
+    for(unsigned run = 0; run < n_seeds; run++) {
+        contender->score += (contender->evaluations[run] != TARGET_MISSED ? (double) contender->evaluations[run] : penalty) / n_seeds;
+        values[run] = contender->gas[run].best.fitness;
+    }
+    qsort(values, n_seeds, sizeof(double), compare_doubles);
+    contender->fitness = n_seeds % 2 == 1 ? values[n_seeds / 2] : 0.5 * (values[n_seeds / 2 - 1] + values[n_seeds / 2]);
+}
+
+static void print_configuration(FILE *const output, const GeneticAlgorithmConfig *const config) {
+    fprintf(output, "--individuals %u --tournament %u --crossover %s --mutation %.3f --encoding %s --survivors %s",
+            config->n_individuals, config->tournament_size, crossover_names[config->crossover], config->mutation,
+            encoding_names[config->encoding], survivor_names[config->survivors]);
+}
+
+int run_tuner(const TunerConfig *const tuner, const GeneticAlgorithmConfig *const config, const long seed, const Scheduler *const scheduler, FILE *const output) {
+    const unsigned n_configurations = tuner->n_configurations;
+    const unsigned n_seeds = tuner->n_seeds;
+    const double start = omp_get_wtime();
+
+    /* Rungs needed to halve the configurations down to one */
+    unsigned n_rungs = 0;
+    for(unsigned alive = n_configurations; alive > 1; alive = (alive + tuner->eta - 1) / tuner->eta) {
+        n_rungs++;
+    }
+    n_rungs = n_rungs > 0 ? n_rungs : 1;
+
+    Contender *contenders = (Contender *) malloc(sizeof(Contender) * n_configurations);
+    Contender **alive = (Contender **) malloc(sizeof(Contender *) * n_configurations);
+    Random rng;
+    random_seed(&rng, seed + 15485863L);
+
+    for(unsigned iter = 0; iter < n_configurations; iter++) {
+        contenders[iter] = (Contender) {
+            .id = iter,
+            .config = iter == 0 ? *config : sample_configuration(config, &rng),
+            .gas = (GeneticAlgorithm *) malloc(sizeof(GeneticAlgorithm) * n_seeds),
+            .evaluations = (unsigned long *) malloc(sizeof(unsigned long) * n_seeds),
+        };
+        for(unsigned run = 0; run < n_seeds; run++) {
+            contenders[iter].evaluations[run] = TARGET_MISSED;
+        }
+        contenders[iter].config.trace = NULL;
+        alive[iter] = contenders + iter;
+    }
+
+    /* Start every run, with common seeds across configurations */
+    const unsigned n_runs = n_configurations * n_seeds;
+    GeneticAlgorithm **pointers = (GeneticAlgorithm **) malloc(sizeof(GeneticAlgorithm *) * n_runs);
+    const GeneticAlgorithmConfig **configs = (const GeneticAlgorithmConfig **) malloc(sizeof(GeneticAlgorithmConfig *) * n_runs);
+    long *seeds = (long *) malloc(sizeof(long) * n_runs);
+    double *values = (double *) malloc(sizeof(double) * n_seeds);
+    for(unsigned iter = 0; iter < n_configurations; iter++) {
+        for(unsigned run = 0; run < n_seeds; run++) {
+            pointers[iter * n_seeds + run] = contenders[iter].gas + run;
+            configs[iter * n_seeds + run] = &(contenders[iter].config);
+            seeds[iter * n_seeds + run] = seed + 7919L * run;
+        }
+    }
+    if(multiplexer_init_runs(scheduler, pointers, configs, seeds, n_runs) != 0) {
+        fprintf(stderr, "Could not allocate the runs\n");
+        for(unsigned iter = 0; iter < n_configurations; iter++) {
+            free(contenders[iter].gas);
+            free(contenders[iter].evaluations);
+        }
+        free(values);
+        free(seeds);
+        free(configs);
+        free(pointers);
+        free(alive);
+        free(contenders);
+        return 1;
+    }
+    check_targets(alive, n_configurations, n_seeds, tuner->target);
+
+    fprintf(output, "rung\tbudget\tconfiguration\truns_reached\tmean_evaluations\tmedian_fitness\tkept\tindividuals\ttournament\tcrossover\tmutation\tencoding\tsurvivors\n");
+
+    Multiplexer multiplexer;
+    multiplexer_init(&multiplexer);
+    unsigned n_alive = n_configurations;
+    const double full = (double) config->n_individuals * config->n_generations;
+    for(unsigned rung = 0; rung < n_rungs; rung++) {
+        const double budget = full / pow(tuner->eta, n_rungs - 1 - rung);
+
+        /* Advance the runs that have neither reached the target nor spent
+         * the budget of the rung in integrations, nor the generations it
+         * would take without reusing archived fitness values */
+        for(;;) {
+            unsigned n_active = 0;
+            for(unsigned iter = 0; iter < n_alive; iter++) {
+                const unsigned limit = (unsigned) ceil(budget / alive[iter]->config.n_individuals);
+                for(unsigned run = 0; run < n_seeds; run++) {
+                    const GeneticAlgorithm *const ga = alive[iter]->gas + run;
+                    if(alive[iter]->evaluations[run] == TARGET_MISSED && genetic_algorithm_evaluations(ga) < budget && ga->generation < limit) {
+                        pointers[n_active++] = alive[iter]->gas + run;
+                    }
+                }
+            }
+            if(n_active == 0) {
+                break;
+            }
+
+            multiplexer_step(&multiplexer, scheduler, pointers, n_active);
+            check_targets(alive, n_alive, n_seeds, tuner->target);
+        }
+
+        for(unsigned iter = 0; iter < n_alive; iter++) {
+            score_contender(alive[iter], n_seeds, tuner->target > 0.0 ? 2.0 * budget : 0.0, values);
+        }
+        qsort(alive, n_alive, sizeof(Contender *), compare_contenders);
+
+        const unsigned n_kept = rung + 1 < n_rungs ? (n_alive + tuner->eta - 1) / tuner->eta : 1;
+        for(unsigned iter = 0; iter < n_alive; iter++) {
+            const Contender *const contender = alive[iter];
+            unsigned n_reached = 0;
+            for(unsigned run = 0; run < n_seeds; run++) {
+                n_reached += contender->evaluations[run] != TARGET_MISSED;
+            }
+
+            fprintf(output, "%u\t%.0f\t%u\t%u\t%.0f\t%lf\t%s\t%u\t%u\t%s\t%.3f\t%s\t%s\n", rung, budget, contender->id, n_reached,
+                    contender->score, contender->fitness, iter < n_kept ? "yes" : "no", contender->config.n_individuals,
+                    contender->config.tournament_size, crossover_names[contender->config.crossover], contender->config.mutation,
+                    encoding_names[contender->config.encoding], survivor_names[contender->config.survivors]);
+        }
+
+        /* Release the runs of the configurations dropped */
+        for(unsigned iter = n_kept; iter < n_alive; iter++) {
+            for(unsigned run = 0; run < n_seeds; run++) {
+                genetic_algorithm_free(alive[iter]->gas + run);
+            }
+        }
+        n_alive = n_kept;
+    }
+    multiplexer_free(&multiplexer);
+
+    const Contender *const best = alive[0];
+    fprintf(output, "Best configuration: ");
+    print_configuration(output, &(best->config));
+    fprintf(output, "\n");
+    fprintf(stderr, "%u configurations raced in %u rungs of %u runs each in %.3lf s\n", n_configurations, n_rungs, n_seeds, omp_get_wtime() - start);
+
+    for(unsigned run = 0; run < n_seeds; run++) {
+        genetic_algorithm_free(best->gas + run);
+    }
+    for(unsigned iter = 0; iter < n_configurations; iter++) {
+        free(contenders[iter].gas);
+        free(contenders[iter].evaluations);
+    }
+    free(values);
+    free(seeds);
+    free(configs);
+    free(pointers);
+    free(alive);
+    free(contenders);
+    return 0;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "genetic-algorithm.h"
+#include "scheduler.h"
+#include <stdio.h>
+
+/* Racing of configurations of the genetic algorithm.
+ */
+typedef struct {
+    /* Configurations raced, the first one the configuration given and the
+     * rest sampled at random.
+     */
+    unsigned n_configurations;
+    /* Runs of every configuration, with the same seeds for all of them.
+     */
+    unsigned n_seeds;
+    /* Inverse of the fraction of the configurations kept by every rung, and
+     * factor by which their budget grows.
+     */
+    unsigned eta;
+    /* Fitness defining the time to target, or `0` to rank the
+     * configurations by their best fitness alone.
+     */
+    double target;
+} TunerConfig;
+
+/* Race `tuner->n_configurations` configurations of the population size,
+ * tournament size, crossover, mutation, encoding and survivor selection of
+ * `config` by successive halving, writing every rung and the best
+ * configuration found to `output`.
+ *
+ * Every rung runs the configurations left on `tuner->n_seeds` seeds until
+ * they reach the target or spend the budget of the rung in integrations of
+ * the model, at either fidelity, and keeps the best `1 / tuner->eta` of them
+ * by their mean integrations to target, counting twice the budget for runs
+ * that did not reach it, and then by the median of their best fitness. The
+ * runs of the kept configurations resume with a budget `tuner->eta` times
+ * larger, the last one that of `config`, `n_individuals` times `n_generations`
+ * evaluations. All the runs of a rung advance in lockstep on `scheduler`,
+ * evaluating their children as one batch.
+ *
+ * Returns `0` on success, and `1` if the runs cannot be allocated.
+ */
+int run_tuner(const TunerConfig *const tuner, const GeneticAlgorithmConfig *const config, const long seed, const Scheduler *const scheduler, FILE *const output);